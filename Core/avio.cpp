@@ -0,0 +1,93 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+// Kept apart from writer.cpp so the write-behind file builds without FFmpeg
+#include "writer.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/////////////////////////////////////////////////////
+// AVIO
+/////////////////////////////////////////////////////
+
+static const int AVIO_BUFFER_SIZE = 256 * 1024;
+
+// FFmpeg 7 made the write callback's buffer const
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+static int avioWrite(void* opaque, const uint8_t* buf, int size) {
+#else
+static int avioWrite(void* opaque, uint8_t* buf, int size) {
+#endif
+	WriteBehindFile* file = (WriteBehindFile*)opaque;
+	return file->write(buf, (size_t)size) ? size : AVERROR(EIO);
+}
+
+static int64_t avioSeek(void* opaque, int64_t offset, int whence) {
+	WriteBehindFile* file = (WriteBehindFile*)opaque;
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return (int64_t)file->size();
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += (int64_t)file->position();
+		break;
+	case SEEK_END:
+		offset += (int64_t)file->size();
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+	if (offset < 0) return AVERROR(EINVAL);
+	file->seek((uint64_t)offset);
+	return offset;
+}
+
+AVIOContext* WriteBehindFile::openAvio(const std::string& path, uint64_t expectedSize) {
+	WriteBehindFile* file = new WriteBehindFile();
+	if (!file->open(path, expectedSize)) {
+		delete file;
+		return nullptr;
+	}
+
+	uint8_t* buffer = (uint8_t*)av_malloc(AVIO_BUFFER_SIZE);
+	AVIOContext* pb = buffer ? avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 1, file, nullptr, avioWrite, avioSeek) : nullptr;
+	if (!pb) {
+		av_free(buffer);
+		delete file;
+		return nullptr;
+	}
+	return pb;
+}
+
+bool WriteBehindFile::closeAvio(AVIOContext** pb) {
+	if (!pb || !*pb) return false;
+
+	avio_flush(*pb);
+	bool ok = (*pb)->error == 0;
+	WriteBehindFile* file = (WriteBehindFile*)(*pb)->opaque;
+	ok = file->close() && ok;
+	delete file;
+
+	av_freep(&(*pb)->buffer);
+	avio_context_free(pb);
+	return ok;
+}
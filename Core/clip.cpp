@@ -0,0 +1,331 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "clip.h"
+#include "timeline.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+static AVFormatContext* openInput(const std::string& path) {
+	AVFormatContext* in = nullptr;
+	if (avformat_open_input(&in, path.c_str(), nullptr, nullptr) < 0) {
+		printf("CK::CLIP Unable to open %s\n", path.c_str());
+		return nullptr;
+	}
+	if (avformat_find_stream_info(in, nullptr) < 0) {
+		printf("CK::CLIP No stream info in %s\n", path.c_str());
+		avformat_close_input(&in);
+		return nullptr;
+	}
+	return in;
+}
+
+// Sum of the files' sizes, what an output copied from them is preallocated to
+static uint64_t sizeOnDisk(const std::vector<std::string>& paths) {
+	uint64_t total = 0;
+	for (const std::string& p : paths) {
+		std::error_code ec;
+		uint64_t size = std::filesystem::file_size(p, ec);
+		if (!ec) total += size;
+	}
+	return total;
+}
+
+// Mirrors the audio/video streams of `in`, map[i] is the output index of input stream i or -1
+static AVFormatContext* openOutput(const std::string& path, AVFormatContext* in, std::vector<int>& map, uint64_t expectedSize) {
+	AVFormatContext* out = nullptr;
+	if (avformat_alloc_output_context2(&out, nullptr, "mp4", path.c_str()) < 0 || !out) {
+		printf("CK::CLIP Failed to allocate muxer!\n");
+		return nullptr;
+	}
+
+	map.assign(in->nb_streams, -1);
+	for (unsigned i = 0; i < in->nb_streams; i++) {
+		AVCodecParameters* par = in->streams[i]->codecpar;
+		if (par->codec_type != AVMEDIA_TYPE_VIDEO && par->codec_type != AVMEDIA_TYPE_AUDIO) continue;
+
+		AVStream* st = avformat_new_stream(out, nullptr);
+		avcodec_parameters_copy(st->codecpar, par);
+		st->codecpar->codec_tag = 0;
+		st->time_base = in->streams[i]->time_base;
+		map[i] = st->index;
+	}
+
+	out->pb = WriteBehindFile::openAvio(path, expectedSize);
+	if (!out->pb) {
+		printf("CK::CLIP Failed to open %s\n", path.c_str());
+		avformat_free_context(out);
+		return nullptr;
+	}
+	if (avformat_write_header(out, nullptr) < 0) {
+		printf("CK::CLIP Failed to write header for %s\n", path.c_str());
+		WriteBehindFile::closeAvio(&out->pb);
+		avformat_free_context(out);
+		return nullptr;
+	}
+	return out;
+}
+
+static bool closeOutput(AVFormatContext* out) {
+	av_write_trailer(out);
+	bool ok = WriteBehindFile::closeAvio(&out->pb);
+	avformat_free_context(out);
+	return ok;
+}
+
+static bool sameStreams(AVFormatContext* a, AVFormatContext* b) {
+	if (a->nb_streams != b->nb_streams) return false;
+	for (unsigned i = 0; i < a->nb_streams; i++) {
+		AVCodecParameters* pa = a->streams[i]->codecpar;
+		AVCodecParameters* pb = b->streams[i]->codecpar;
+		if (pa->codec_type != pb->codec_type || pa->codec_id != pb->codec_id) return false;
+		if (pa->width != pb->width || pa->height != pb->height || pa->sample_rate != pb->sample_rate) return false;
+		if (pa->extradata_size != pb->extradata_size) return false;
+		if (pa->extradata_size && memcmp(pa->extradata, pb->extradata, pa->extradata_size) != 0) return false;
+	}
+	return true;
+}
+
+static double msSince(std::chrono::steady_clock::time_point begin) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+bool clip::trim(const std::string& input, const std::string& output, double lastSeconds) {
+	auto begin = std::chrono::steady_clock::now();
+
+	AVFormatContext* in = openInput(input);
+	if (!in) return false;
+
+	int videoIdx = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (videoIdx < 0) {
+		printf("CK::CLIP No video in %s\n", input.c_str());
+		avformat_close_input(&in);
+		return false;
+	}
+
+	// Seek back to the keyframe at or before the cut point
+	int64_t start = in->start_time != AV_NOPTS_VALUE ? in->start_time : 0;
+	int64_t cut = start + std::max<int64_t>(0, in->duration - (int64_t)(lastSeconds * AV_TIME_BASE));
+	AVStream* vst = in->streams[videoIdx];
+	if (av_seek_frame(in, videoIdx, av_rescale_q(cut, AV_TIME_BASE_Q, vst->time_base), AVSEEK_FLAG_BACKWARD) < 0) {
+		printf("CK::CLIP Seek failed, keeping the whole clip\n");
+	}
+
+	std::vector<int> map;
+	AVFormatContext* out = openOutput(output, in, map, sizeOnDisk({ input }));
+	if (!out) {
+		avformat_close_input(&in);
+		return false;
+	}
+
+	// Everything is rebased to the first video keyframe read
+	int64_t originUsec = AV_NOPTS_VALUE;
+	AVPacket* pkt = av_packet_alloc();
+	bool ok = true;
+	while (av_read_frame(in, pkt) >= 0) {
+		int idx = pkt->stream_index;
+		if (map[idx] < 0 || pkt->dts == AV_NOPTS_VALUE) {
+			av_packet_unref(pkt);
+			continue;
+		}
+		AVStream* ist = in->streams[idx];
+		AVStream* ost = out->streams[map[idx]];
+
+		if (originUsec == AV_NOPTS_VALUE) {
+			if (idx != videoIdx || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+				av_packet_unref(pkt);
+				continue;
+			}
+			originUsec = av_rescale_q(pkt->dts, ist->time_base, AV_TIME_BASE_Q);
+		}
+
+		int64_t offset = av_rescale_q(originUsec, AV_TIME_BASE_Q, ist->time_base);
+		if (pkt->dts < offset) {
+			// Audio from before the keyframe
+			av_packet_unref(pkt);
+			continue;
+		}
+		pkt->dts -= offset;
+		if (pkt->pts != AV_NOPTS_VALUE) pkt->pts -= offset;
+		av_packet_rescale_ts(pkt, ist->time_base, ost->time_base);
+		pkt->stream_index = ost->index;
+		pkt->pos = -1;
+
+		if (av_interleaved_write_frame(out, pkt) < 0) {
+			printf("CK::CLIP Failed to write packet!\n");
+			ok = false;
+			break;
+		}
+	}
+
+	av_packet_free(&pkt);
+	ok = closeOutput(out) && ok;
+	avformat_close_input(&in);
+
+	printf("CK::CLIP Trimmed %s to last %.1fs in %.1fms\n", input.c_str(), lastSeconds, msSince(begin));
+	return ok;
+}
+
+// Packets a clip's earliest DTS is looked for in, every stream shows up long before this
+static const size_t CONCAT_PROBE_PACKETS = 256;
+
+bool clip::concat(const std::vector<std::string>& inputs, const std::string& output) {
+	if (inputs.empty()) return false;
+	auto begin = std::chrono::steady_clock::now();
+
+	AVFormatContext* first = openInput(inputs.front());
+	if (!first) return false;
+
+	std::vector<int> map;
+	AVFormatContext* out = openOutput(output, first, map, sizeOnDisk(inputs));
+	if (!out) {
+		avformat_close_input(&first);
+		return false;
+	}
+
+	// Placed in the input streams' time bases, the muxer may pick other ones for the output
+	std::vector<std::pair<int, int>> timeBases(out->nb_streams);
+	for (unsigned i = 0; i < first->nb_streams; i++) {
+		if (map[i] < 0) continue;
+		AVRational tb = first->streams[i]->time_base;
+		timeBases[map[i]] = { tb.num, tb.den };
+	}
+	ClipTimeline timeline(timeBases);
+
+	AVPacket* pkt = av_packet_alloc();
+	bool ok = true;
+	for (size_t n = 0; n < inputs.size() && ok; n++) {
+		AVFormatContext* in = n == 0 ? first : openInput(inputs[n]);
+		if (!in) {
+			ok = false;
+			break;
+		}
+		if (!sameStreams(first, in)) {
+			printf("CK::CLIP %s does not match the first clip's streams\n", inputs[n].c_str());
+			if (in != first) avformat_close_input(&in);
+			ok = false;
+			break;
+		}
+
+		// The clip starts at its earliest DTS, not start_time: that is a PTS, B-frames decode before it
+		std::deque<AVPacket*> probe;
+		int64_t firstDtsUsec = INT64_MAX;
+		while (probe.size() < CONCAT_PROBE_PACKETS && av_read_frame(in, pkt) >= 0) {
+			int idx = pkt->stream_index;
+			if (map[idx] < 0 || pkt->dts == AV_NOPTS_VALUE) {
+				av_packet_unref(pkt);
+				continue;
+			}
+			firstDtsUsec = std::min(firstDtsUsec, av_rescale_q(pkt->dts, in->streams[idx]->time_base, AV_TIME_BASE_Q));
+			probe.push_back(av_packet_clone(pkt));
+			av_packet_unref(pkt);
+		}
+		timeline.beginClip(firstDtsUsec == INT64_MAX ? 0 : firstDtsUsec);
+
+		while (ok) {
+			AVPacket* next = nullptr;
+			if (!probe.empty()) {
+				next = probe.front();
+				probe.pop_front();
+			}
+			else if (av_read_frame(in, pkt) >= 0) {
+				if (map[pkt->stream_index] < 0 || pkt->dts == AV_NOPTS_VALUE) {
+					av_packet_unref(pkt);
+					continue;
+				}
+				next = pkt;
+			}
+			else {
+				break;
+			}
+
+			AVStream* ist = in->streams[next->stream_index];
+			AVStream* ost = out->streams[map[next->stream_index]];
+			int64_t dts = next->dts;
+			int64_t pts = next->pts != AV_NOPTS_VALUE ? next->pts : next->dts;
+			timeline.place(ost->index, dts, pts, next->duration);
+			next->dts = dts;
+			next->pts = pts;
+			av_packet_rescale_ts(next, ist->time_base, ost->time_base);
+			next->stream_index = ost->index;
+			next->pos = -1;
+
+			if (av_interleaved_write_frame(out, next) < 0) {
+				printf("CK::CLIP Failed to write packet!\n");
+				ok = false;
+			}
+			if (next != pkt) av_packet_free(&next);
+		}
+		for (AVPacket* p : probe) {
+			av_packet_free(&p);
+		}
+		if (in != first) avformat_close_input(&in);
+	}
+
+	av_packet_free(&pkt);
+	ok = closeOutput(out) && ok;
+	avformat_close_input(&first);
+
+	printf("CK::CLIP Joined %zu clips into %s in %.1fms\n", inputs.size(), output.c_str(), msSince(begin));
+	return ok;
+}
+
+bool clip::benchmark(const std::string& input, int count) {
+	std::filesystem::path dir = std::filesystem::path(input).parent_path();
+	std::string trimmed = (dir / "CKBENCH_trim.mp4").string();
+	std::string joined = (dir / "CKBENCH_concat.mp4").string();
+	uint64_t inputBytes = sizeOnDisk({ input });
+
+	// Same cut as an upload trim, then the trimmed clip joined to itself `count` times
+	double trimMs = 0;
+	for (int i = 0; i < count; i++) {
+		auto begin = std::chrono::steady_clock::now();
+		if (!trim(input, trimmed, 10.0)) return false;
+		trimMs += msSince(begin);
+	}
+	uint64_t trimmedBytes = sizeOnDisk({ trimmed });
+	printf("CK::CLIP [BENCH] trim: %.1fms per clip, %.1f MB/s read (%.1f MB in, %.1f MB out)\n",
+		trimMs / count, inputBytes * count / 1048576.0 / (trimMs / 1000.0),
+		inputBytes / 1048576.0, trimmedBytes / 1048576.0);
+
+	std::vector<std::string> inputs(count, trimmed);
+	auto begin = std::chrono::steady_clock::now();
+	bool ok = concat(inputs, joined);
+	double concatMs = msSince(begin);
+	if (ok) {
+		uint64_t joinedBytes = sizeOnDisk({ joined });
+		printf("CK::CLIP [BENCH] concat: %d clips in %.1fms, %.1fms per clip, %.1f MB/s written\n",
+			count, concatMs, concatMs / count, joinedBytes / 1048576.0 / (concatMs / 1000.0));
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(trimmed, ec);
+	std::filesystem::remove(joined, ec);
+	return ok;
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "commands.h"
+
+#include <future>
+
+CommandQueue::CommandQueue() {
+	running_ = false;
+	closed_ = false;
+}
+
+CommandQueue::~CommandQueue() {
+	stop();
+}
+
+void CommandQueue::start(Command afterEach) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (running_ || closed_) return;
+	afterEach_ = std::move(afterEach);
+	running_ = true;
+	thread_ = std::thread(&CommandQueue::loop, this);
+	threadId_ = thread_.get_id();
+}
+
+void CommandQueue::stop() {
+	std::deque<std::pair<Command, Command>> dropped;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		running_ = false;
+		closed_ = true;
+		dropped.swap(commands_);
+	}
+	cv_.notify_all();
+	if (thread_.joinable() && std::this_thread::get_id() != threadId_) {
+		thread_.join();
+	}
+	// Destroyed outside the lock, a waiting run() wakes up when its command goes away
+	dropped.clear();
+}
+
+bool CommandQueue::queue(Command cmd, Command done) {
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		if (closed_) return false;
+		commands_.push_back(std::make_pair(std::move(cmd), std::move(done)));
+	}
+	cv_.notify_one();
+	return true;
+}
+
+bool CommandQueue::run(Command cmd) {
+	// Waiting on ourselves would never return
+	if (onWorker()) {
+		cmd();
+		return true;
+	}
+
+	// Only the queued command holds the promise, dropping it breaks the promise & wakes us
+	auto finished = std::make_shared<std::promise<void>>();
+	std::future<void> result = finished->get_future();
+	if (!queue(std::move(cmd), [finished = std::move(finished)]() { finished->set_value(); })) return false;
+	try {
+		result.get();
+		return true;
+	}
+	catch (const std::future_error&) {
+		return false; // Dropped by stop()
+	}
+}
+
+bool CommandQueue::onWorker() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return running_ && std::this_thread::get_id() == threadId_;
+}
+
+void CommandQueue::loop() {
+	while (true) {
+		std::pair<Command, Command> cmd;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return !running_ || !commands_.empty(); });
+			if (!running_) return;
+			cmd = std::move(commands_.front());
+			commands_.pop_front();
+		}
+		cmd.first();
+		if (afterEach_) afterEach_();
+		if (cmd.second) cmd.second();
+	}
+}
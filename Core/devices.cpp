@@ -0,0 +1,179 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "devices.h"
+
+#include <Windows.h>
+#include <mmdeviceapi.h>
+
+#include <obs.h>
+
+static const uint64_t POLL_MS = 3000;
+static const uint64_t AUDIO_DEBOUNCE_MS = 500;
+
+// Endpoint callbacks arrive on a system thread, they only poke the scheduler
+class AudioEndpointListener : public IMMNotificationClient {
+public:
+	explicit AudioEndpointListener(std::function<void()> onChange) {
+		refs_ = 1;
+		onChange_ = onChange;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override {
+		return InterlockedIncrement(&refs_);
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override {
+		ULONG refs = InterlockedDecrement(&refs_);
+		if (refs == 0) delete this;
+		return refs;
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override {
+		if (riid == __uuidof(IUnknown) || riid == __uuidof(IMMNotificationClient)) {
+			*ppv = static_cast<IMMNotificationClient*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override { onChange_(); return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override { onChange_(); return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override { onChange_(); return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow, ERole, LPCWSTR) override { onChange_(); return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override { return S_OK; }
+
+private:
+	LONG refs_;
+	std::function<void()> onChange_;
+};
+
+DeviceRegistry::DeviceRegistry() {
+	scheduler_ = nullptr;
+	pollTimer_ = Scheduler::INVALID_TIMER;
+	enumerator_ = nullptr;
+	listener_ = nullptr;
+}
+
+DeviceRegistry::~DeviceRegistry() {
+	stop();
+}
+
+void DeviceRegistry::start(Scheduler* scheduler, std::function<void()> onChange) {
+	scheduler_ = scheduler;
+	onChange_ = onChange;
+
+	scheduler_->schedule(0, [this]() {
+		registerEndpoints();
+		refreshAudio();
+		refreshVideo();
+	});
+	pollTimer_ = scheduler_->scheduleEvery(POLL_MS, [this]() {
+		refreshVideo();
+		// No notifications to rely on, audio gets diffed as well
+		if (!listener_) refreshAudio();
+	});
+}
+
+void DeviceRegistry::stop() {
+	if (!scheduler_) return;
+
+	scheduler_->cancel(pollTimer_);
+	pollTimer_ = Scheduler::INVALID_TIMER;
+
+	if (enumerator_) {
+		if (listener_) {
+			enumerator_->UnregisterEndpointNotificationCallback(listener_);
+			listener_->Release();
+			listener_ = nullptr;
+		}
+		enumerator_->Release();
+		enumerator_ = nullptr;
+	}
+	scheduler_ = nullptr;
+}
+
+DeviceRegistry::Lists DeviceRegistry::get() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return lists_;
+}
+
+void DeviceRegistry::registerEndpoints() {
+	// The scheduler thread is ours, so it can join the MTA without upsetting Qt's STA
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL,
+		__uuidof(IMMDeviceEnumerator), (void**)&enumerator_);
+	if (FAILED(hr)) {
+		printf("CK::DEV No endpoint enumerator, polling audio devices\n");
+		enumerator_ = nullptr;
+		return;
+	}
+
+	Scheduler* scheduler = scheduler_;
+	AudioEndpointListener* listener = new AudioEndpointListener([this, scheduler]() {
+		// Plugging a headset fires several of these back to back
+		scheduler->debounce("audio-endpoints", AUDIO_DEBOUNCE_MS, [this]() { refreshAudio(); });
+	});
+	if (FAILED(enumerator_->RegisterEndpointNotificationCallback(listener))) {
+		printf("CK::DEV Endpoint notifications unavailable, polling audio devices\n");
+		listener->Release();
+		return;
+	}
+	listener_ = listener;
+}
+
+void DeviceRegistry::refreshAudio() {
+	bool changed = store(&Lists::speakers, enumerate("wasapi_output_capture", "device_id"));
+	changed = store(&Lists::mics, enumerate("wasapi_input_capture", "device_id")) || changed;
+	if (changed && onChange_) onChange_();
+}
+
+void DeviceRegistry::refreshVideo() {
+	bool changed = store(&Lists::monitors, enumerate("monitor_capture", "monitor_id"));
+	changed = store(&Lists::windows, enumerate("window_capture", "window")) || changed;
+	if (changed && onChange_) onChange_();
+}
+
+bool DeviceRegistry::store(propListStr Lists::* field, propListStr items) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (lists_.*field == items) return false;
+	lists_.*field = std::move(items);
+	return true;
+}
+
+propListStr DeviceRegistry::enumerate(const char* sourceId, const char* prop) {
+	propListStr list;
+
+	// By type id, no source instance needed
+	obs_properties_t* props = obs_get_source_properties(sourceId);
+	if (!props) return list;
+
+	obs_property_t* items = obs_properties_get(props, prop);
+	for (size_t i = 0; i < obs_property_list_item_count(items); i++) {
+		const char* name = obs_property_list_item_name(items, i);
+		const char* handle = obs_property_list_item_string(items, i);
+		list.push_back(std::make_pair(std::string(name ? name : ""), std::string(handle ? handle : "")));
+	}
+
+	obs_properties_destroy(props);
+	return list;
+}
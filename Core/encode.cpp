@@ -0,0 +1,274 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "encode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+static uint64_t threadCpuNs() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 100; // 100ns units
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+std::string encode::ffmpegEncoderFor(const std::string& obsEncoderId) {
+	static const std::pair<const char*, const char*> encoders[] = {
+		{ "obs_nvenc_av1_tex", "av1_nvenc" },
+		{ "jim_av1_nvenc", "av1_nvenc" },
+		{ "obs_nvenc_hevc_tex", "hevc_nvenc" },
+		{ "jim_hevc_nvenc", "hevc_nvenc" },
+		{ "ffmpeg_hevc_nvenc", "hevc_nvenc" },
+		{ "obs_nvenc_h264_tex", "h264_nvenc" },
+		{ "jim_nvenc", "h264_nvenc" },
+		{ "ffmpeg_nvenc", "h264_nvenc" },
+		{ "av1_texture_amf", "av1_amf" },
+		{ "h265_texture_amf", "hevc_amf" },
+		{ "h264_texture_amf", "h264_amf" },
+		{ "obs_qsv11_av1", "av1_qsv" },
+		{ "obs_qsv11_hevc", "hevc_qsv" },
+		{ "obs_qsv11_v2", "h264_qsv" },
+		{ "obs_x264", "libx264" },
+	};
+	for (auto& e : encoders) {
+		if (obsEncoderId == e.first) return e.second;
+	}
+	return "";
+}
+
+// Deterministic frame: a drifting gradient with a moving block & per-frame noise, enough detail
+// and motion that the encoders can't coast on a static picture
+static void fillFrame(AVFrame* frame, int index) {
+	uint32_t seed = 0x9E3779B9u * (uint32_t)(index + 1);
+	for (int y = 0; y < frame->height; y++) {
+		uint8_t* row = frame->data[0] + (size_t)y * frame->linesize[0];
+		for (int x = 0; x < frame->width; x++) {
+			seed = seed * 1664525u + 1013904223u;
+			row[x] = (uint8_t)((x + y + index * 4) & 0xFF) ^ (uint8_t)((seed >> 24) & 0x0F);
+		}
+	}
+	int blockSize = frame->height / 4;
+	int bx = (index * 8) % std::max(1, frame->width - blockSize);
+	int by = frame->height / 3;
+	for (int y = by; y < by + blockSize && y < frame->height; y++) {
+		memset(frame->data[0] + (size_t)y * frame->linesize[0] + bx, 235, blockSize);
+	}
+	for (int y = 0; y < frame->height / 2; y++) {
+		uint8_t* row = frame->data[1] + (size_t)y * frame->linesize[1];
+		for (int x = 0; x < frame->width / 2; x++) {
+			row[x * 2] = (uint8_t)(128 + ((x + index) & 0x3F) - 32);
+			row[x * 2 + 1] = (uint8_t)(128 + ((y - index) & 0x3F) - 32);
+		}
+	}
+}
+
+// Packets are kept for the quality pass, decoding them here would land in the encode timings
+static bool drain(AVCodecContext* ctx, AVPacket* pkt, uint64_t& bytes, std::vector<AVPacket*>& packets) {
+	while (true) {
+		int ret = avcodec_receive_packet(ctx, pkt);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return true;
+		if (ret < 0) return false;
+		bytes += pkt->size;
+		AVPacket* kept = av_packet_alloc();
+		av_packet_move_ref(kept, pkt);
+		packets.push_back(kept);
+	}
+}
+
+// Squared luma error of every decoded frame against the frame it was encoded from.
+// NV12 & the planar formats decoders hand back share the same Y plane
+struct QualityPass {
+	AVFrame* decoded;
+	AVFrame* reference;
+	int index;
+	double squaredError;
+	uint64_t pixels;
+};
+
+static bool receiveDecoded(AVCodecContext* dec, QualityPass& q) {
+	while (true) {
+		int ret = avcodec_receive_frame(dec, q.decoded);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return true;
+		if (ret < 0) return false;
+		if (av_frame_make_writable(q.reference) < 0) return false;
+		fillFrame(q.reference, q.index++);
+		int width = std::min(q.decoded->width, q.reference->width);
+		int height = std::min(q.decoded->height, q.reference->height);
+		for (int y = 0; y < height; y++) {
+			const uint8_t* a = q.decoded->data[0] + (size_t)y * q.decoded->linesize[0];
+			const uint8_t* b = q.reference->data[0] + (size_t)y * q.reference->linesize[0];
+			uint64_t rowError = 0;
+			for (int x = 0; x < width; x++) {
+				int d = (int)a[x] - (int)b[x];
+				rowError += (uint64_t)(d * d);
+			}
+			q.squaredError += (double)rowError;
+		}
+		q.pixels += (uint64_t)width * height;
+		av_frame_unref(q.decoded);
+	}
+}
+
+static double measurePsnr(const AVCodecContext* enc, const std::vector<AVPacket*>& packets) {
+	const AVCodec* codec = avcodec_find_decoder(enc->codec_id);
+	if (!codec) return 0.0;
+	AVCodecContext* dec = avcodec_alloc_context3(codec);
+	if (enc->extradata_size > 0) {
+		dec->extradata = (uint8_t*)av_mallocz(enc->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+		memcpy(dec->extradata, enc->extradata, enc->extradata_size);
+		dec->extradata_size = enc->extradata_size;
+	}
+	if (avcodec_open2(dec, codec, nullptr) < 0) {
+		avcodec_free_context(&dec);
+		return 0.0;
+	}
+
+	QualityPass q = {};
+	q.decoded = av_frame_alloc();
+	q.reference = av_frame_alloc();
+	q.reference->format = AV_PIX_FMT_NV12;
+	q.reference->width = enc->width;
+	q.reference->height = enc->height;
+	bool ok = av_frame_get_buffer(q.reference, 32) >= 0;
+	for (size_t i = 0; ok && i < packets.size(); i++) {
+		ok = avcodec_send_packet(dec, packets[i]) >= 0 && receiveDecoded(dec, q);
+	}
+	if (ok) {
+		ok = avcodec_send_packet(dec, nullptr) >= 0 && receiveDecoded(dec, q);
+	}
+
+	av_frame_free(&q.decoded);
+	av_frame_free(&q.reference);
+	avcodec_free_context(&dec);
+	if (!ok || !q.pixels) return 0.0;
+	double mse = q.squaredError / q.pixels;
+	// Identical frames, capped like ffmpeg's psnr filter
+	if (mse <= 0.0) return 100.0;
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+bool encode::benchmark(const std::string& ffmpegEncoder, int width, int height, int fps, int frames, int bitrateKbps, BenchResult& result) {
+	result = {};
+
+	const AVCodec* codec = avcodec_find_encoder_by_name(ffmpegEncoder.c_str());
+	if (!codec) {
+		printf("CK::ENCODE %s is not in this FFmpeg build\n", ffmpegEncoder.c_str());
+		return false;
+	}
+
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	ctx->width = width & ~1;
+	ctx->height = height & ~1;
+	ctx->pix_fmt = AV_PIX_FMT_NV12;
+	ctx->time_base = AVRational{ 1, fps };
+	ctx->framerate = AVRational{ fps, 1 };
+	ctx->gop_size = fps * 2;
+	ctx->max_b_frames = 0;
+	// CBR at the rate the replay buffer would use
+	ctx->bit_rate = (int64_t)bitrateKbps * 1000;
+	ctx->rc_max_rate = ctx->bit_rate;
+	ctx->rc_buffer_size = (int)ctx->bit_rate;
+	if (ffmpegEncoder == "libx264") {
+		av_opt_set(ctx->priv_data, "preset", "veryfast", 0);
+	}
+	else if (ffmpegEncoder.find("_nvenc") != std::string::npos) {
+		av_opt_set(ctx->priv_data, "preset", "p4", 0);
+		av_opt_set(ctx->priv_data, "rc", "cbr", 0);
+	}
+
+	if (avcodec_open2(ctx, codec, nullptr) < 0) {
+		printf("CK::ENCODE Unable to open %s\n", ffmpegEncoder.c_str());
+		avcodec_free_context(&ctx);
+		return false;
+	}
+
+	AVFrame* frame = av_frame_alloc();
+	frame->format = AV_PIX_FMT_NV12;
+	frame->width = ctx->width;
+	frame->height = ctx->height;
+	AVPacket* pkt = av_packet_alloc();
+	std::vector<AVPacket*> packets;
+	bool ok = av_frame_get_buffer(frame, 32) >= 0;
+
+	uint64_t wallNs = 0;
+	uint64_t cpuNs = 0;
+	auto timed = [&](auto fn) {
+		auto begin = std::chrono::steady_clock::now();
+		uint64_t cpuBegin = threadCpuNs();
+		bool r = fn();
+		cpuNs += threadCpuNs() - cpuBegin;
+		wallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+		return r;
+	};
+
+	for (int i = 0; ok && i < frames; i++) {
+		ok = av_frame_make_writable(frame) >= 0;
+		if (!ok) break;
+		fillFrame(frame, i);
+		frame->pts = i;
+		ok = timed([&]() { return avcodec_send_frame(ctx, frame) >= 0 && drain(ctx, pkt, result.bytes, packets); });
+		result.frames = i + 1;
+	}
+	// Flush whatever the encoder still holds
+	if (ok) {
+		ok = timed([&]() { return avcodec_send_frame(ctx, nullptr) >= 0 && drain(ctx, pkt, result.bytes, packets); });
+	}
+	if (ok) {
+		result.psnr = measurePsnr(ctx, packets);
+		if (result.psnr <= 0.0) printf("CK::ENCODE No working decoder for %s, quality not measured\n", ffmpegEncoder.c_str());
+	}
+	for (AVPacket*& p : packets) av_packet_free(&p);
+
+	result.wallMs = wallNs / 1000000.0;
+	result.cpuMs = cpuNs / 1000000.0;
+
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	avcodec_free_context(&ctx);
+	if (!ok) {
+		printf("CK::ENCODE %s failed after %d frames\n", ffmpegEncoder.c_str(), result.frames);
+	}
+	return ok;
+}
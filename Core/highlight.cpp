@@ -0,0 +1,314 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "highlight.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <emmintrin.h>
+
+static const int SAMPLE_RATE = 48000;
+static const float SILENCE_DB = -50.0f;
+static const float FLUX_SIGMA = 3.0f;
+static const uint32_t WARMUP_HOPS = 100;           // ~2s of history before anything counts
+static const float LEVEL_ALPHA = 1.0f / 235.0f;  // ~5s
+static const float FLUX_ALPHA = 1.0f / 94.0f;    // ~2s
+static const float PI = 3.14159265358979f;
+
+static float sumSquares(const float* x, int n) {
+	__m128 acc = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_loadu_ps(x + i);
+		acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i < n; i++) sum += x[i] * x[i];
+	return sum;
+}
+
+// Sum of max(0, cur - prev), the onset strength
+static float positiveDiff(const float* cur, const float* prev, int n) {
+	__m128 acc = _mm_setzero_ps();
+	__m128 zero = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 d = _mm_sub_ps(_mm_loadu_ps(cur + i), _mm_loadu_ps(prev + i));
+		acc = _mm_add_ps(acc, _mm_max_ps(d, zero));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i < n; i++) sum += std::max(0.0f, cur[i] - prev[i]);
+	return sum;
+}
+
+HighlightDetector::HighlightDetector() {
+	thresholdDb_ = 10.0f;
+
+	hop_.resize(HOP);
+	window_.resize(HOP);
+	for (int i = 0; i < HOP; i++) {
+		window_[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / (HOP - 1));
+	}
+	twiddles_.resize(HOP / 2);
+	for (int i = 0; i < HOP / 2; i++) {
+		twiddles_[i] = std::polar(1.0f, -2.0f * PI * i / HOP);
+	}
+	int bits = 0;
+	while ((1 << bits) < HOP) bits++;
+	bitrev_.resize(HOP);
+	for (int i = 0; i < HOP; i++) {
+		int r = 0;
+		for (int b = 0; b < bits; b++) {
+			if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+		}
+		bitrev_[i] = (uint16_t)r;
+	}
+	spectrum_.resize(HOP);
+	magnitude_.resize(HOP / 2);
+	prevMagnitude_.resize(HOP / 2);
+
+	reset();
+}
+
+void HighlightDetector::setThreshold(float db) {
+	thresholdDb_ = std::max(1.0f, db);
+}
+
+float HighlightDetector::getThreshold() {
+	return thresholdDb_;
+}
+
+void HighlightDetector::reset() {
+	filled_ = 0;
+	hops_ = 0;
+	levelDb_ = SILENCE_DB;
+	fluxMean_ = 0.0f;
+	fluxVar_ = 0.0f;
+	std::fill(prevMagnitude_.begin(), prevMagnitude_.end(), 0.0f);
+}
+
+bool HighlightDetector::feed(const float* const* planes, int channels, uint32_t frames) {
+	if (channels <= 0 || !planes[0]) return false;
+	const float* left = planes[0];
+	const float* right = channels > 1 && planes[1] ? planes[1] : planes[0];
+
+	bool event = false;
+	uint32_t i = 0;
+	while (i < frames) {
+		int n = (int)std::min<uint32_t>(frames - i, HOP - filled_);
+		float* dst = hop_.data() + filled_;
+		int j = 0;
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (; j + 4 <= n; j += 4) {
+			__m128 l = _mm_loadu_ps(left + i + j);
+			__m128 r = _mm_loadu_ps(right + i + j);
+			_mm_storeu_ps(dst + j, _mm_mul_ps(_mm_add_ps(l, r), half));
+		}
+		for (; j < n; j++) {
+			dst[j] = (left[i + j] + right[i + j]) * 0.5f;
+		}
+		filled_ += n;
+		i += n;
+
+		if (filled_ == HOP) {
+			event |= processHop();
+			filled_ = 0;
+		}
+	}
+	return event;
+}
+
+bool HighlightDetector::processHop() {
+	float meanSquare = sumSquares(hop_.data(), HOP) / HOP;
+	float db = 10.0f * std::log10(meanSquare + 1e-10f);
+
+	// Windowed spectrum, only the magnitude's rise matters so phase is dropped
+	for (int i = 0; i < HOP; i++) {
+		spectrum_[bitrev_[i]] = std::complex<float>(hop_[i] * window_[i], 0.0f);
+	}
+	fft();
+	for (int k = 0; k < HOP / 2; k++) {
+		magnitude_[k] = std::abs(spectrum_[k]);
+	}
+	float flux = positiveDiff(magnitude_.data(), prevMagnitude_.data(), HOP / 2) / (HOP / 2);
+	magnitude_.swap(prevMagnitude_);
+
+	bool event = hops_ >= WARMUP_HOPS
+		&& db > SILENCE_DB
+		&& db - levelDb_ > thresholdDb_
+		&& flux > fluxMean_ + FLUX_SIGMA * std::sqrt(fluxVar_);
+
+	// Baselines move after the check so the event itself doesn't raise its own bar
+	hops_++;
+	levelDb_ += LEVEL_ALPHA * (std::max(db, SILENCE_DB) - levelDb_);
+	float delta = flux - fluxMean_;
+	fluxMean_ += FLUX_ALPHA * delta;
+	fluxVar_ = (1.0f - FLUX_ALPHA) * (fluxVar_ + FLUX_ALPHA * delta * delta);
+	return event;
+}
+
+void HighlightDetector::fft() {
+	// In place radix-2, input is already in bit reversed order
+	for (int size = 2; size <= HOP; size <<= 1) {
+		int half = size / 2;
+		int step = HOP / size;
+		for (int start = 0; start < HOP; start += size) {
+			for (int k = 0; k < half; k++) {
+				std::complex<float> t = twiddles_[k * step] * spectrum_[start + k + half];
+				std::complex<float> u = spectrum_[start + k];
+				spectrum_[start + k] = u + t;
+				spectrum_[start + k + half] = u - t;
+			}
+		}
+	}
+}
+
+/////////////////////
+// Benchmark
+
+// Mono or stereo 48kHz WAV into two planes
+static bool readWav(const std::string& path, std::vector<float>& left, std::vector<float>& right) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+
+	char riff[12];
+	if (!in.read(riff, 12) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) return false;
+
+	uint16_t format = 0, channels = 0, bits = 0;
+	uint32_t rate = 0;
+	while (in) {
+		char id[4];
+		uint32_t size = 0;
+		if (!in.read(id, 4) || !in.read((char*)&size, 4)) return false;
+
+		if (memcmp(id, "fmt ", 4) == 0) {
+			std::vector<char> fmt(size);
+			in.read(fmt.data(), size);
+			if (size < 16) return false;
+			memcpy(&format, &fmt[0], 2);
+			memcpy(&channels, &fmt[2], 2);
+			memcpy(&rate, &fmt[4], 4);
+			memcpy(&bits, &fmt[14], 2);
+		}
+		else if (memcmp(id, "data", 4) == 0) {
+			bool pcm16 = format == 1 && bits == 16;
+			bool float32 = format == 3 && bits == 32;
+			if (!pcm16 && !float32) return false;
+			if (channels == 0 || rate != SAMPLE_RATE) {
+				printf("CK::HIGHLIGHT [BENCH] Fixture needs %dHz audio\n", SAMPLE_RATE);
+				return false;
+			}
+
+			std::vector<char> data(size);
+			in.read(data.data(), size);
+			size_t frameBytes = (size_t)channels * bits / 8;
+			size_t frames = in.gcount() / frameBytes;
+			left.resize(frames);
+			right.resize(frames);
+			for (size_t i = 0; i < frames; i++) {
+				const char* frame = data.data() + i * frameBytes;
+				float s[2];
+				for (int c = 0; c < 2; c++) {
+					int ch = std::min<int>(c, channels - 1);
+					if (pcm16) {
+						int16_t v;
+						memcpy(&v, frame + ch * 2, 2);
+						s[c] = v / 32768.0f;
+					}
+					else {
+						memcpy(&s[c], frame + ch * 4, 4);
+					}
+				}
+				left[i] = s[0];
+				right[i] = s[1];
+			}
+			return true;
+		}
+		else {
+			in.seekg(size + (size & 1), std::ios::cur);
+		}
+	}
+	return false;
+}
+
+bool HighlightDetector::benchmark(const std::string& wavPath) {
+	std::vector<float> left;
+	std::vector<float> right;
+	int bursts = 0;
+
+	if (!wavPath.empty()) {
+		if (!readWav(wavPath, left, right)) {
+			printf("CK::HIGHLIGHT [BENCH] Unable to read %s\n", wavPath.c_str());
+			return false;
+		}
+	}
+	else {
+		// 60s of quiet noise, a 300ms loud burst every 10s after the first
+		size_t frames = (size_t)SAMPLE_RATE * 60;
+		left.resize(frames);
+		right.resize(frames);
+		std::mt19937 rng(7);
+		std::normal_distribution<float> noise(0.0f, 1.0f);
+		float lp = 0.0f;
+		for (size_t i = 0; i < frames; i++) {
+			lp = 0.9f * lp + 0.1f * noise(rng);
+			float s = 0.03f * lp;
+			size_t t = i % (SAMPLE_RATE * 10);
+			if (i >= (size_t)SAMPLE_RATE * 10 && t < (size_t)SAMPLE_RATE * 3 / 10) {
+				s += 0.4f * noise(rng);
+			}
+			left[i] = s;
+			right[i] = s;
+		}
+		bursts = 5;
+	}
+
+	// libobs hands audio over in ~10ms blocks
+	const uint32_t BLOCK = 480;
+	HighlightDetector detector;
+	int events = 0;
+	size_t lastEvent = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < left.size(); i += BLOCK) {
+		uint32_t n = (uint32_t)std::min<size_t>(BLOCK, left.size() - i);
+		const float* planes[2] = { left.data() + i, right.data() + i };
+		// One event per second at most, the same as a short cooldown
+		if (detector.feed(planes, 2, n) && (events == 0 || i - lastEvent > SAMPLE_RATE)) {
+			events++;
+			lastEvent = i;
+			printf("CK::HIGHLIGHT [BENCH] event at %.2fs\n", (double)i / SAMPLE_RATE);
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	double audioMs = left.size() * 1000.0 / SAMPLE_RATE;
+
+	printf("CK::HIGHLIGHT [BENCH] %.0fs of audio in %.1fms, %.3f%% of a core, %d events",
+		audioMs / 1000.0, ms, 100.0 * ms / audioMs, events);
+	if (bursts > 0) printf(" for %d bursts", bursts);
+	printf("\n");
+	return true;
+}
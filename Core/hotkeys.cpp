@@ -0,0 +1,444 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "hotkeys.h"
+#include "threads.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/input.h>
+#endif
+
+HotkeyService::HotkeyService() {
+	dropped_ = 0;
+	running_ = false;
+#ifdef _WIN32
+	listenerId_ = 0;
+#else
+	stopFd_ = -1;
+#endif
+}
+
+HotkeyService::~HotkeyService() {
+	stop();
+}
+
+void HotkeyService::setBindings(const std::vector<Binding>& bindings) {
+	bool restart = running_;
+	if (restart) stop();
+	bindings_ = bindings;
+	if (restart) start();
+}
+
+void HotkeyService::setHandler(std::function<void(const Event&)> handler) {
+	handler_ = handler;
+}
+
+/////////////////////////////////////////////////////
+// KEY NAMES
+/////////////////////////////////////////////////////
+
+#ifndef _WIN32
+// evdev codes follow the keyboard layout, not the alphabet
+static const uint32_t EVDEV_LETTERS[26] = {
+	KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+	KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+};
+static const uint32_t EVDEV_DIGITS[10] = {
+	KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9
+};
+static const uint32_t EVDEV_FUNCTION[12] = {
+	KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12
+};
+#endif
+
+bool HotkeyService::parseKeys(const std::string& keys, uint32_t& modifiers, uint32_t& code) {
+	modifiers = 0;
+	code = 0;
+
+	std::stringstream parts(keys);
+	std::string part;
+	while (std::getline(parts, part, '+')) {
+		part.erase(std::remove_if(part.begin(), part.end(), ::isspace), part.end());
+		std::transform(part.begin(), part.end(), part.begin(), ::toupper);
+		if (part.empty() || code) return false; // The key goes last
+
+		if (part == "ALT") modifiers |= ALT;
+		else if (part == "CTRL" || part == "CONTROL") modifiers |= CTRL;
+		else if (part == "SHIFT") modifiers |= SHIFT;
+		else if (part == "WIN" || part == "SUPER") modifiers |= SUPER;
+		else if (part.size() == 1 && part[0] >= 'A' && part[0] <= 'Z') {
+#ifdef _WIN32
+			code = (uint32_t)part[0];
+#else
+			code = EVDEV_LETTERS[part[0] - 'A'];
+#endif
+		}
+		else if (part.size() == 1 && part[0] >= '0' && part[0] <= '9') {
+#ifdef _WIN32
+			code = (uint32_t)part[0];
+#else
+			code = EVDEV_DIGITS[part[0] - '0'];
+#endif
+		}
+		else if (part.size() >= 2 && part[0] == 'F' && std::all_of(part.begin() + 1, part.end(), ::isdigit)) {
+			int n = atoi(part.c_str() + 1);
+			if (n < 1 || n > 12) return false;
+#ifdef _WIN32
+			code = VK_F1 + (n - 1);
+#else
+			code = EVDEV_FUNCTION[n - 1];
+#endif
+		}
+		else {
+			return false;
+		}
+	}
+	return code != 0;
+}
+
+/////////////////////////////////////////////////////
+// LIFECYCLE
+/////////////////////////////////////////////////////
+
+bool HotkeyService::start() {
+	if (running_) return true;
+
+	keys_.clear();
+	for (const Binding& b : bindings_) {
+		Key key;
+		if (!parseKeys(b.keys, key.modifiers, key.code)) {
+			printf("CK::HOTKEY Can't bind \"%s\", skipped\n", b.keys.c_str());
+			continue;
+		}
+		key.action = b.action;
+		key.arg = b.arg;
+		keys_.push_back(key);
+	}
+	if (keys_.empty()) return false;
+
+#ifndef _WIN32
+	stopFd_ = eventfd(0, EFD_CLOEXEC);
+#endif
+	running_ = true;
+	dispatcher_ = std::thread(&HotkeyService::dispatchLoop, this);
+
+	// Registration happens on the listener thread, the hotkeys belong to its message queue
+	std::promise<bool> registered;
+	std::future<bool> result = registered.get_future();
+	listener_ = std::thread(&HotkeyService::listenLoop, this, [&registered](bool ok) { registered.set_value(ok); });
+	if (!result.get()) {
+		stop();
+		return false;
+	}
+	return true;
+}
+
+void HotkeyService::stop() {
+	if (!running_ && !listener_.joinable()) return;
+	running_ = false;
+
+#ifdef _WIN32
+	if (listenerId_) PostThreadMessage(listenerId_, WM_QUIT, 0, 0);
+#else
+	if (stopFd_ >= 0) {
+		uint64_t one = 1;
+		if (write(stopFd_, &one, sizeof(one)) < 0) {
+			printf("CK::HOTKEY Failed to wake the listener\n");
+		}
+	}
+#endif
+	if (listener_.joinable()) listener_.join();
+
+	{
+		const std::lock_guard<std::mutex> lock(wakeMtx_);
+	}
+	wakeCv_.notify_all();
+	if (dispatcher_.joinable()) dispatcher_.join();
+
+#ifdef _WIN32
+	listenerId_ = 0;
+#else
+	if (stopFd_ >= 0) close(stopFd_);
+	stopFd_ = -1;
+#endif
+	if (dropped_) {
+		printf("CK::HOTKEY %llu presses dropped on a full queue\n", (unsigned long long)dropped_);
+	}
+}
+
+/////////////////////////////////////////////////////
+// DELIVERY
+/////////////////////////////////////////////////////
+
+void HotkeyService::post(const Event& ev) {
+	if (!queue_.push(ev)) {
+		dropped_++;
+		return;
+	}
+	// Orders the wakeup against the dispatcher checking the queue, presses never contend on it
+	{
+		const std::lock_guard<std::mutex> lock(wakeMtx_);
+	}
+	wakeCv_.notify_one();
+}
+
+void HotkeyService::dispatchLoop() {
+	threads::apply(threads::INTERACTIVE, "ck-hotkey-run");
+	while (true) {
+		Event ev;
+		while (queue_.pop(ev)) {
+			if (handler_) handler_(ev);
+		}
+
+		std::unique_lock<std::mutex> lock(wakeMtx_);
+		wakeCv_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+		if (!running_ && queue_.empty()) return;
+	}
+}
+
+/////////////////////////////////////////////////////
+// LISTENER
+/////////////////////////////////////////////////////
+
+#ifdef _WIN32
+
+// os_gettime_ns' clock without libobs, both read QPC
+static uint64_t nowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void HotkeyService::listenLoop(std::function<void(bool)> ready) {
+	threads::apply(threads::INTERACTIVE, "ck-hotkeys");
+
+	// Creates this thread's message queue before anyone can post WM_QUIT to it
+	MSG msg;
+	PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+	listenerId_ = GetCurrentThreadId();
+
+	int registered = 0;
+	for (size_t i = 0; i < keys_.size(); i++) {
+		UINT mods = MOD_NOREPEAT;
+		if (keys_[i].modifiers & ALT) mods |= MOD_ALT;
+		if (keys_[i].modifiers & CTRL) mods |= MOD_CONTROL;
+		if (keys_[i].modifiers & SHIFT) mods |= MOD_SHIFT;
+		if (keys_[i].modifiers & SUPER) mods |= MOD_WIN;
+		if (RegisterHotKey(NULL, (int)i + 1, mods, keys_[i].code)) {
+			registered++;
+		}
+		else {
+			printf("CK::HOTKEY Hotkey %zu is taken by another application\n", i + 1);
+		}
+	}
+	ready(registered > 0);
+
+	// Blocks until a hotkey or WM_QUIT, nothing runs between presses
+	while (registered > 0 && GetMessage(&msg, NULL, 0, 0) > 0) {
+		if (msg.message != WM_HOTKEY) continue;
+		uint64_t pressNs = nowNs();
+		size_t idx = (size_t)msg.wParam - 1;
+		if (idx < keys_.size()) {
+			post({ keys_[idx].action, keys_[idx].arg, pressNs });
+		}
+	}
+
+	for (size_t i = 0; i < keys_.size(); i++) {
+		UnregisterHotKey(NULL, (int)i + 1);
+	}
+}
+
+#else
+
+// Devices reporting letter keys, -1 for mice, power buttons & nodes we can't read
+static int openKeyboard(const std::string& name) {
+	if (strncmp(name.c_str(), "event", 5) != 0) return -1;
+	std::string path = "/dev/input/" + name;
+	int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) return -1;
+
+	uint8_t keyBits[KEY_MAX / 8 + 1] = {};
+	bool keyboard = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) >= 0
+		&& (keyBits[KEY_A / 8] & (1 << (KEY_A % 8)));
+	// Event times on the steady_clock & os_gettime_ns clock, the press is stamped by the kernel
+	int clock = CLOCK_MONOTONIC;
+	if (!keyboard || ioctl(fd, EVIOCSCLOCKID, &clock) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static uint32_t modifierFor(uint16_t code) {
+	switch (code) {
+	case KEY_LEFTALT: case KEY_RIGHTALT: return HotkeyService::ALT;
+	case KEY_LEFTCTRL: case KEY_RIGHTCTRL: return HotkeyService::CTRL;
+	case KEY_LEFTSHIFT: case KEY_RIGHTSHIFT: return HotkeyService::SHIFT;
+	case KEY_LEFTMETA: case KEY_RIGHTMETA: return HotkeyService::SUPER;
+	default: return 0;
+	}
+}
+
+// Reads key events without grabbing, the game still gets every key.
+// Keyboards plugged in or unplugged later are picked up from /dev/input's inotify events
+void HotkeyService::listenLoop(std::function<void(bool)> ready) {
+	threads::apply(threads::INTERACTIVE, "ck-hotkeys");
+
+	// Slot 0 wakes us for stop(), slot 1 watches /dev/input, keyboards from 2 on
+	std::vector<pollfd> fds;
+	std::vector<std::string> names;
+	fds.push_back({ stopFd_, POLLIN, 0 });
+	names.push_back("");
+	int watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	// udev fixes the node's group after creating it, that arrives as IN_ATTRIB
+	if (watch >= 0 && inotify_add_watch(watch, "/dev/input", IN_CREATE | IN_ATTRIB | IN_DELETE) < 0) {
+		close(watch);
+		watch = -1;
+	}
+	fds.push_back({ watch, POLLIN, 0 });
+	names.push_back("");
+
+	auto addKeyboard = [&fds, &names](const std::string& name) {
+		if (std::find(names.begin(), names.end(), name) != names.end()) return;
+		int fd = openKeyboard(name);
+		if (fd < 0) return;
+		fds.push_back({ fd, POLLIN, 0 });
+		names.push_back(name);
+		printf("CK::HOTKEY Listening on /dev/input/%s\n", name.c_str());
+	};
+	auto removeKeyboard = [&fds, &names](size_t i) {
+		close(fds[i].fd);
+		fds.erase(fds.begin() + i);
+		names.erase(names.begin() + i);
+	};
+
+	if (DIR* dir = opendir("/dev/input")) {
+		while (struct dirent* entry = readdir(dir)) {
+			addKeyboard(entry->d_name);
+		}
+		closedir(dir);
+	}
+	if (fds.size() == 2) {
+		printf("CK::HOTKEY No readable keyboard in /dev/input (input group?), %s\n",
+			watch >= 0 ? "waiting for one" : "hotkeys off");
+	}
+	// Without a watch nothing could show up later
+	ready(fds.size() > 2 || watch >= 0);
+	if (fds.size() == 2 && watch < 0) return;
+
+	// Left & right held separately, releasing one side keeps the modifier
+	uint16_t held[4] = {};
+	auto modifiers = [&held]() {
+		uint32_t mods = 0;
+		for (int bit = 0; bit < 4; bit++) {
+			if (held[bit]) mods |= 1u << bit;
+		}
+		return mods;
+	};
+
+	while (running_) {
+		if (poll(fds.data(), fds.size(), -1) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (fds[0].revents) break;
+
+		if (fds[1].revents & POLLIN) {
+			alignas(struct inotify_event) char buf[4096];
+			ssize_t n;
+			while ((n = read(watch, buf, sizeof(buf))) > 0) {
+				for (char* p = buf; p < buf + n; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+					const struct inotify_event* ev = (const struct inotify_event*)p;
+					if (!ev->len) continue;
+					std::string name = ev->name;
+					if (ev->mask & IN_DELETE) {
+						auto it = std::find(names.begin() + 2, names.end(), name);
+						if (it != names.end()) removeKeyboard(it - names.begin());
+					}
+					else {
+						addKeyboard(name);
+					}
+				}
+			}
+			// Slots moved, the rest of this round's revents are stale
+			continue;
+		}
+
+		for (size_t i = 2; i < fds.size(); i++) {
+			if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				// Unplugged, the IN_DELETE may still be on its way
+				removeKeyboard(i--);
+				continue;
+			}
+			if (!(fds[i].revents & POLLIN)) continue;
+
+			struct input_event events[64];
+			ssize_t n;
+			while ((n = read(fds[i].fd, events, sizeof(events))) > 0) {
+				for (size_t e = 0; e < (size_t)n / sizeof(struct input_event); e++) {
+					const struct input_event& ev = events[e];
+					if (ev.type != EV_KEY) continue;
+
+					uint32_t mod = modifierFor(ev.code);
+					if (mod) {
+						int bit = mod == ALT ? 0 : mod == CTRL ? 1 : mod == SHIFT ? 2 : 3;
+						bool right = ev.code == KEY_RIGHTALT || ev.code == KEY_RIGHTCTRL
+							|| ev.code == KEY_RIGHTSHIFT || ev.code == KEY_RIGHTMETA;
+						uint16_t side = right ? 2 : 1;
+						if (ev.value) held[bit] |= side;
+						else held[bit] &= ~side;
+						continue;
+					}
+					// 1 is the press, 2 autorepeat & 0 release
+					if (ev.value != 1) continue;
+
+					uint64_t pressNs = (uint64_t)ev.input_event_sec * 1000000000ULL + (uint64_t)ev.input_event_usec * 1000ULL;
+					for (const Key& key : keys_) {
+						if (key.code == ev.code && key.modifiers == modifiers()) {
+							post({ key.action, key.arg, pressNs });
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t i = 2; i < fds.size(); i++) {
+		close(fds[i].fd);
+	}
+	if (watch >= 0) close(watch);
+}
+
+#endif
@@ -0,0 +1,365 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifdef _WIN32
+// Winsock has to come before anything that pulls in Windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "metrics.h"
+#include "threads.h"
+
+#include <cstdio>
+#include <sstream>
+
+/////////////////////////////////////////////////////
+// METRIC TYPES
+/////////////////////////////////////////////////////
+
+LatencyHistogram::LatencyHistogram() {
+	for (auto& b : buckets_) {
+		b = 0;
+	}
+	count_ = 0;
+	sumNs_ = 0;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+	uint64_t us = ns / 1000;
+	int idx = 0;
+	while (us > 1 && idx < BUCKETS - 1) {
+		us >>= 1;
+		idx++;
+	}
+	buckets_[idx].fetch_add(1, std::memory_order_relaxed);
+	sumNs_.fetch_add(ns, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() {
+	return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::sumNs() {
+	return sumNs_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucket(int idx) {
+	return buckets_[idx].load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucketBoundUs(int idx) {
+	return 2ULL << idx;
+}
+
+double LatencyHistogram::percentileMs(double p) {
+	uint64_t total = count();
+	if (!total) return 0.0;
+
+	uint64_t target = (uint64_t)(total * p);
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += buckets_[i].load(std::memory_order_relaxed);
+		if (seen > target) {
+			return (double)bucketBoundUs(i) / 1000.0;
+		}
+	}
+	return (double)bucketBoundUs(BUCKETS - 1) / 1000.0;
+}
+
+Counter::Counter() {
+	value_ = 0;
+}
+
+void Counter::add(uint64_t n) {
+	value_.fetch_add(n, std::memory_order_relaxed);
+}
+
+void Counter::addSample(uint64_t total, uint64_t& lastTotal) {
+	add(total >= lastTotal ? total - lastTotal : total);
+	lastTotal = total;
+}
+
+uint64_t Counter::value() {
+	return value_.load(std::memory_order_relaxed);
+}
+
+Gauge::Gauge() {
+	value_ = 0.0;
+}
+
+void Gauge::set(double v) {
+	value_.store(v, std::memory_order_relaxed);
+}
+
+double Gauge::value() {
+	return value_.load(std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////////////
+// REGISTRY
+/////////////////////////////////////////////////////
+
+static std::string withLabels(const std::string& name, const std::string& labels, const std::string& extra = "") {
+	std::string all = labels;
+	if (!extra.empty()) {
+		all += all.empty() ? extra : "," + extra;
+	}
+	return all.empty() ? name : name + "{" + all + "}";
+}
+
+static const char* typeName(int type) {
+	return type == 0 ? "counter" : type == 1 ? "gauge" : "histogram";
+}
+
+MetricsRegistry::MetricsRegistry() {
+}
+
+Counter* MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	counters_.push_back(std::make_unique<Counter>());
+	add({ name, help, labels, COUNTER, counters_.back().get(), nullptr, nullptr });
+	return counters_.back().get();
+}
+
+Gauge* MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	gauges_.push_back(std::make_unique<Gauge>());
+	add({ name, help, labels, GAUGE, nullptr, gauges_.back().get(), nullptr });
+	return gauges_.back().get();
+}
+
+LatencyHistogram* MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	histograms_.push_back(std::make_unique<LatencyHistogram>());
+	add({ name, help, labels, HISTOGRAM, nullptr, nullptr, histograms_.back().get() });
+	return histograms_.back().get();
+}
+
+void MetricsRegistry::addHistogram(const std::string& name, const std::string& help, const std::string& labels, LatencyHistogram* hist) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	add({ name, help, labels, HISTOGRAM, nullptr, nullptr, hist });
+}
+
+void MetricsRegistry::add(const Entry& entry) {
+	// Keep series of one metric together, the exposition format wants them grouped
+	auto it = entries_.end();
+	for (auto e = entries_.begin(); e != entries_.end(); ++e) {
+		if (e->name == entry.name) it = e + 1;
+	}
+	entries_.insert(it, entry);
+}
+
+std::string MetricsRegistry::renderPrometheus() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	std::ostringstream out;
+	for (size_t i = 0; i < entries_.size(); i++) {
+		Entry& e = entries_[i];
+		if (i == 0 || entries_[i - 1].name != e.name) {
+			out << "# HELP " << e.name << " " << e.help << "\n";
+			out << "# TYPE " << e.name << " " << typeName(e.type) << "\n";
+		}
+
+		switch (e.type) {
+		case COUNTER:
+			out << withLabels(e.name, e.labels) << " " << e.counter->value() << "\n";
+			break;
+		case GAUGE:
+			out << withLabels(e.name, e.labels) << " " << e.gauge->value() << "\n";
+			break;
+		case HISTOGRAM: {
+			// The last bucket is open ended, only +Inf covers it
+			uint64_t cumulative = 0;
+			for (int b = 0; b < LatencyHistogram::BUCKETS - 1; b++) {
+				cumulative += e.histogram->bucket(b);
+				std::ostringstream le;
+				le << "le=\"" << LatencyHistogram::bucketBoundUs(b) / 1e6 << "\"";
+				out << withLabels(e.name + "_bucket", e.labels, le.str()) << " " << cumulative << "\n";
+			}
+			out << withLabels(e.name + "_bucket", e.labels, "le=\"+Inf\"") << " " << e.histogram->count() << "\n";
+			out << withLabels(e.name + "_sum", e.labels) << " " << e.histogram->sumNs() / 1e9 << "\n";
+			out << withLabels(e.name + "_count", e.labels) << " " << e.histogram->count() << "\n";
+			break;
+		}
+		}
+	}
+	return out.str();
+}
+
+std::string MetricsRegistry::renderSummary() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	std::ostringstream out;
+	out.precision(4);
+	for (Entry& e : entries_) {
+		out << withLabels(e.name, e.labels) << " ";
+		switch (e.type) {
+		case COUNTER:
+			out << e.counter->value();
+			break;
+		case GAUGE:
+			out << e.gauge->value();
+			break;
+		case HISTOGRAM:
+			out << "n=" << e.histogram->count() << " p50=" << e.histogram->percentileMs(0.5)
+				<< "ms p99=" << e.histogram->percentileMs(0.99) << "ms";
+			break;
+		}
+		out << "\n";
+	}
+	return out.str();
+}
+
+/////////////////////////////////////////////////////
+// PROMETHEUS ENDPOINT
+/////////////////////////////////////////////////////
+
+#ifndef _WIN32
+typedef int SOCKET;
+static const SOCKET INVALID_SOCKET = -1;
+static const int SOCKET_ERROR = -1;
+static int closesocket(SOCKET s) { return close(s); }
+static int WSAGetLastError() { return errno; }
+#endif
+
+static bool netStartup() {
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		printf("CK::METRICS WSAStartup failed\n");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static void netCleanup() {
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+static void setRecvTimeout(SOCKET s, int ms) {
+#ifdef _WIN32
+	DWORD timeout = ms;
+#else
+	struct timeval timeout = { ms / 1000, (ms % 1000) * 1000 };
+#endif
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+MetricsServer::MetricsServer() {
+	registry_ = nullptr;
+	listener_ = (uintptr_t)INVALID_SOCKET;
+	running_ = false;
+}
+
+MetricsServer::~MetricsServer() {
+	stop();
+}
+
+bool MetricsServer::start(MetricsRegistry* registry, uint16_t port) {
+	if (running_ || !registry) return false;
+
+	if (!netStartup()) return false;
+
+	SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) {
+		netCleanup();
+		return false;
+	}
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+	if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(s, 4) == SOCKET_ERROR) {
+		printf("CK::METRICS Unable to listen on 127.0.0.1:%u (%d)\n", port, WSAGetLastError());
+		closesocket(s);
+		netCleanup();
+		return false;
+	}
+
+	registry_ = registry;
+	listener_ = (uintptr_t)s;
+	running_ = true;
+	thread_ = std::thread(&MetricsServer::loop, this);
+	printf("CK::METRICS Serving http://127.0.0.1:%u/metrics\n", port);
+	return true;
+}
+
+void MetricsServer::stop() {
+	if (!running_.exchange(false)) return;
+
+	// Unblocks accept(), Linux only wakes it on a shutdown
+#ifndef _WIN32
+	shutdown((SOCKET)listener_, SHUT_RDWR);
+#endif
+	closesocket((SOCKET)listener_);
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	listener_ = (uintptr_t)INVALID_SOCKET;
+	netCleanup();
+}
+
+void MetricsServer::loop() {
+	threads::apply(threads::BACKGROUND, "ck-metrics");
+	while (running_) {
+		SOCKET client = accept((SOCKET)listener_, nullptr, nullptr);
+		if (client == INVALID_SOCKET) continue;
+
+		// A scraper that never finishes its request can't hold us up for long
+		setRecvTimeout(client, 1000);
+
+		std::string request;
+		char buf[1024];
+		while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+			int n = recv(client, buf, sizeof(buf), 0);
+			if (n <= 0) break;
+			request.append(buf, n);
+		}
+
+		std::string status = "404 Not Found";
+		std::string body = "Not Found\n";
+		if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+			status = "200 OK";
+			body = registry_->renderPrometheus();
+		}
+
+		std::ostringstream response;
+		response << "HTTP/1.1 " << status << "\r\n"
+			<< "Content-Type: text/plain; version=0.0.4\r\n"
+			<< "Content-Length: " << body.size() << "\r\n"
+			<< "Connection: close\r\n\r\n"
+			<< body;
+		std::string out = response.str();
+		send(client, out.data(), (int)out.size(), 0);
+		closesocket(client);
+	}
+}
@@ -0,0 +1,150 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "modules.h"
+
+#include <Windows.h>
+#include <psapi.h>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include <obs.h>
+
+// Which module registers what, ids with a trailing '*' match as a prefix
+struct ModuleType {
+	const char* typeId;
+	const char* module;
+};
+
+static const ModuleType MODULE_TYPES[] = {
+	{ "ffmpeg_muxer", "obs-ffmpeg" },
+	{ "ffmpeg_aac", "obs-ffmpeg" },
+	{ "ffmpeg_nvenc", "obs-ffmpeg" },
+	{ "ffmpeg_hevc_nvenc", "obs-ffmpeg" },
+	{ "jim_*", "obs-ffmpeg" },
+	{ "*_texture_amf", "obs-ffmpeg" },
+	{ "obs_qsv11*", "obs-qsv11" },
+	{ "obs_x264", "obs-x264" },
+	{ "monitor_capture", "win-capture" },
+	{ "window_capture", "win-capture" },
+	{ "wasapi_output_capture", "win-wasapi" },
+	{ "wasapi_input_capture", "win-wasapi" },
+	{ "color_source_v3", "image-source" },
+};
+
+static bool matches(const char* pattern, const std::string& id) {
+	size_t len = strlen(pattern);
+	if (pattern[0] == '*') {
+		return id.size() >= len - 1 && id.compare(id.size() - (len - 1), len - 1, pattern + 1) == 0;
+	}
+	if (pattern[len - 1] == '*') {
+		return id.compare(0, len - 1, pattern, len - 1) == 0;
+	}
+	return id == pattern;
+}
+
+static int64_t privateBytes() {
+	PROCESS_MEMORY_COUNTERS_EX pmc = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
+		return 0;
+	}
+	return (int64_t)pmc.PrivateUsage;
+}
+
+ModuleManager::ModuleManager() {
+}
+
+bool ModuleManager::require(const std::string& module) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	Entry* existing = find(module);
+	if (existing) return existing->loaded;
+
+	auto start = std::chrono::steady_clock::now();
+	int64_t memoryBefore = privateBytes();
+
+	obs_module_t* loaded = nullptr;
+	int res = obs_open_module(&loaded, module.c_str(), nullptr);
+	bool ok = res == MODULE_SUCCESS && obs_init_module(loaded);
+
+	Entry entry;
+	entry.name = module;
+	entry.loaded = ok;
+	entry.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	entry.memoryBytes = privateBytes() - memoryBefore;
+	modules_.push_back(entry);
+
+	if (ok) {
+		printf("CK::MOD Loaded %s in %.1fms (%+.1fMB)\n", module.c_str(), entry.ms, entry.memoryBytes / (1024.0 * 1024.0));
+	}
+	else {
+		printf("CK::MOD Failed to load %s (%d)\n", module.c_str(), res);
+	}
+	return ok;
+}
+
+bool ModuleManager::requireFor(const std::string& typeId) {
+	const char* module = moduleFor(typeId);
+	if (!module) return true;
+	return require(module);
+}
+
+bool ModuleManager::isLoaded(const std::string& module) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	Entry* entry = find(module);
+	return entry && entry->loaded;
+}
+
+const char* ModuleManager::moduleFor(const std::string& typeId) {
+	for (const ModuleType& type : MODULE_TYPES) {
+		if (matches(type.typeId, typeId)) return type.module;
+	}
+	return nullptr;
+}
+
+void ModuleManager::logReport() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	double totalMs = 0.0;
+	int64_t totalBytes = 0;
+	for (const Entry& entry : modules_) {
+		printf("CK::MOD %-14s %s %7.1fms %+7.1fMB\n", entry.name.c_str(), entry.loaded ? "loaded" : "FAILED",
+			entry.ms, entry.memoryBytes / (1024.0 * 1024.0));
+		totalMs += entry.ms;
+		totalBytes += entry.memoryBytes;
+	}
+	printf("CK::MOD total %.1fms %+.1fMB\n", totalMs, totalBytes / (1024.0 * 1024.0));
+
+	std::vector<std::string> skipped;
+	for (const ModuleType& type : MODULE_TYPES) {
+		if (find(type.module)) continue;
+		if (std::find(skipped.begin(), skipped.end(), type.module) == skipped.end()) {
+			skipped.push_back(type.module);
+			printf("CK::MOD %-14s never loaded\n", type.module);
+		}
+	}
+}
+
+ModuleManager::Entry* ModuleManager::find(const std::string& module) {
+	for (Entry& entry : modules_) {
+		if (entry.name == module) return &entry;
+	}
+	return nullptr;
+}
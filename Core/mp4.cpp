@@ -0,0 +1,527 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+static uint32_t readU32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t readU64(const uint8_t* p) {
+	return ((uint64_t)readU32(p) << 32) | readU32(p + 4);
+}
+
+static void writeU32(uint8_t* p, uint32_t v) {
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static void writeU64(uint8_t* p, uint64_t v) {
+	writeU32(p, (uint32_t)(v >> 32));
+	writeU32(p + 4, (uint32_t)v);
+}
+
+std::vector<mp4::Box> mp4::readBoxes(const std::string& path) {
+	std::vector<Box> boxes;
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return boxes;
+
+	in.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t)in.tellg();
+
+	uint64_t pos = 0;
+	while (pos + 8 <= fileSize) {
+		uint8_t hdr[16];
+		in.seekg(pos);
+		in.read((char*)hdr, 8);
+		if (!in) break;
+
+		Box box;
+		box.offset = pos;
+		box.size = readU32(hdr);
+		box.headerSize = 8;
+		memcpy(box.type, hdr + 4, 4);
+		box.type[4] = '\0';
+
+		if (box.size == 1) {
+			// 64 bit size follows the type
+			in.read((char*)hdr + 8, 8);
+			if (!in) break;
+			box.size = readU64(hdr + 8);
+			box.headerSize = 16;
+		}
+		else if (box.size == 0) {
+			// Runs to the end of the file
+			box.size = fileSize - pos;
+		}
+
+		if (box.size < box.headerSize || pos + box.size > fileSize) {
+			// Truncated tail, stop at the last complete box
+			break;
+		}
+
+		boxes.push_back(box);
+		pos += box.size;
+	}
+	return boxes;
+}
+
+static const mp4::Box* findBox(const std::vector<mp4::Box>& boxes, const char* type) {
+	for (const mp4::Box& b : boxes) {
+		if (strcmp(b.type, type) == 0) return &b;
+	}
+	return nullptr;
+}
+
+bool mp4::isFaststart(const std::string& path) {
+	std::vector<Box> boxes = readBoxes(path);
+	const Box* moov = findBox(boxes, "moov");
+	const Box* mdat = findBox(boxes, "mdat");
+	return moov && (!mdat || moov->offset < mdat->offset);
+}
+
+/////////////////////////////////////////////////////
+// MOOV TREE
+/////////////////////////////////////////////////////
+
+namespace {
+
+// Only the path down to the chunk offset tables is parsed, everything else stays raw
+struct Node {
+	char type[4];
+	std::vector<uint8_t> payload;
+	std::vector<Node> children;
+	bool container;
+};
+
+bool isContainer(const char* type) {
+	static const char* containers[] = { "moov", "trak", "mdia", "minf", "stbl" };
+	for (const char* c : containers) {
+		if (memcmp(type, c, 4) == 0) return true;
+	}
+	return false;
+}
+
+bool parseChildren(const uint8_t* data, size_t size, std::vector<Node>& out) {
+	size_t pos = 0;
+	while (pos + 8 <= size) {
+		uint64_t boxSize = readU32(data + pos);
+		size_t header = 8;
+		if (boxSize == 1) {
+			if (pos + 16 > size) return false;
+			boxSize = readU64(data + pos + 8);
+			header = 16;
+		}
+		else if (boxSize == 0) {
+			boxSize = size - pos;
+		}
+		if (boxSize < header || pos + boxSize > size) return false;
+
+		Node node;
+		memcpy(node.type, data + pos + 4, 4);
+		node.container = isContainer(node.type);
+		if (node.container) {
+			if (!parseChildren(data + pos + header, (size_t)boxSize - header, node.children)) return false;
+		}
+		else {
+			node.payload.assign(data + pos + header, data + pos + boxSize);
+		}
+		out.push_back(std::move(node));
+		pos += (size_t)boxSize;
+	}
+	return pos == size;
+}
+
+uint64_t nodeSize(const Node& node) {
+	uint64_t size = 8;
+	if (node.container) {
+		for (const Node& c : node.children) size += nodeSize(c);
+	}
+	else {
+		size += node.payload.size();
+	}
+	return size;
+}
+
+void serialize(const Node& node, std::vector<uint8_t>& out) {
+	size_t start = out.size();
+	out.resize(start + 8);
+	writeU32(&out[start], (uint32_t)nodeSize(node));
+	memcpy(&out[start + 4], node.type, 4);
+	if (node.container) {
+		for (const Node& c : node.children) serialize(c, out);
+	}
+	else {
+		out.insert(out.end(), node.payload.begin(), node.payload.end());
+	}
+}
+
+template <typename Fn>
+void forEachNode(Node& node, Fn fn) {
+	fn(node);
+	for (Node& c : node.children) forEachNode(c, fn);
+}
+
+bool isType(const Node& node, const char* type) {
+	return memcmp(node.type, type, 4) == 0;
+}
+
+// Largest offset in a stco table, 0 if it has none
+uint64_t maxStcoOffset(const Node& node) {
+	if (node.payload.size() < 8) return 0;
+	uint32_t count = readU32(&node.payload[4]);
+	uint64_t maxOffset = 0;
+	for (uint32_t i = 0; i < count && 8 + i * 4 + 4 <= node.payload.size(); i++) {
+		maxOffset = std::max<uint64_t>(maxOffset, readU32(&node.payload[8 + i * 4]));
+	}
+	return maxOffset;
+}
+
+void stcoToCo64(Node& node) {
+	uint32_t count = node.payload.size() >= 8 ? readU32(&node.payload[4]) : 0;
+	std::vector<uint8_t> payload(8 + (size_t)count * 8);
+	memcpy(payload.data(), node.payload.data(), 8);
+	for (uint32_t i = 0; i < count; i++) {
+		writeU64(&payload[8 + i * 8], readU32(&node.payload[8 + i * 4]));
+	}
+	node.payload.swap(payload);
+	memcpy(node.type, "co64", 4);
+}
+
+void shiftOffsets(Node& node, uint64_t shift) {
+	if (node.payload.size() < 8) return;
+	uint32_t count = readU32(&node.payload[4]);
+	bool wide = isType(node, "co64");
+	size_t entry = wide ? 8 : 4;
+	for (uint32_t i = 0; i < count && 8 + (i + 1) * entry <= node.payload.size(); i++) {
+		uint8_t* p = &node.payload[8 + i * entry];
+		if (wide) {
+			writeU64(p, readU64(p) + shift);
+		}
+		else {
+			writeU32(p, (uint32_t)(readU32(p) + shift));
+		}
+	}
+}
+
+}
+
+/////////////////////////////////////////////////////
+// FASTSTART
+/////////////////////////////////////////////////////
+
+static bool copyRange(std::ifstream& in, std::ofstream& out, uint64_t offset, uint64_t size, std::vector<char>& buffer) {
+	in.seekg(offset);
+	while (size > 0) {
+		size_t chunk = (size_t)std::min<uint64_t>(size, buffer.size());
+		in.read(buffer.data(), chunk);
+		if (!in) return false;
+		out.write(buffer.data(), chunk);
+		if (!out) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+bool mp4::faststart(const std::string& path) {
+	auto begin = std::chrono::steady_clock::now();
+
+	std::vector<Box> boxes = readBoxes(path);
+	const Box* moovBox = findBox(boxes, "moov");
+	const Box* mdatBox = findBox(boxes, "mdat");
+	if (!moovBox || !mdatBox) {
+		printf("CK::MP4 %s has no moov/mdat, skipping faststart\n", path.c_str());
+		return false;
+	}
+	if (findBox(boxes, "moof")) {
+		printf("CK::MP4 %s is fragmented, nothing to move\n", path.c_str());
+		return true;
+	}
+	if (moovBox->offset < mdatBox->offset) {
+		return true; // Already faststart
+	}
+	Box moovInfo = *moovBox;
+	Box mdatInfo = *mdatBox;
+
+	// Load & parse moov, it's small compared to mdat
+	std::vector<uint8_t> moovData((size_t)moovInfo.size);
+	{
+		std::ifstream in(path, std::ios::binary);
+		in.seekg(moovInfo.offset);
+		in.read((char*)moovData.data(), moovData.size());
+		if (!in) return false;
+	}
+	Node moov;
+	memcpy(moov.type, "moov", 4);
+	moov.container = true;
+	if (!parseChildren(moovData.data() + moovInfo.headerSize, moovData.size() - moovInfo.headerSize, moov.children)) {
+		printf("CK::MP4 Malformed moov in %s\n", path.c_str());
+		return false;
+	}
+
+	// In place: a free box ahead of mdat that moov fits into, mdat does not move
+	uint64_t moovSize = nodeSize(moov);
+	bool moovIsLast = &boxes.back() == moovBox;
+	for (const Box& b : boxes) {
+		if (b.offset >= mdatInfo.offset) break;
+		if (strcmp(b.type, "free") != 0 && strcmp(b.type, "skip") != 0) continue;
+
+		uint64_t spare = b.size - moovSize;
+		if (!moovIsLast || b.size < moovSize || (spare != 0 && spare < 8)) continue;
+
+		std::vector<uint8_t> out;
+		serialize(moov, out);
+		if (spare) {
+			// Pad the rest of the slot with a smaller free box
+			size_t start = out.size();
+			out.resize(start + (size_t)spare, 0);
+			writeU32(&out[start], (uint32_t)spare);
+			memcpy(&out[start + 4], "free", 4);
+		}
+
+		std::fstream io(path, std::ios::binary | std::ios::in | std::ios::out);
+		io.seekp(b.offset);
+		io.write((const char*)out.data(), out.size());
+		io.close();
+		if (!io) return false;
+
+		std::error_code ec;
+		std::filesystem::resize_file(path, moovInfo.offset, ec);
+		printf("CK::MP4 Faststart %s in place in %.1fms\n", path.c_str(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+		return !ec;
+	}
+
+	// Everything from mdat on moves down by the final moov size, 32 bit tables may need widening
+	uint64_t fileEnd = boxes.back().offset + boxes.back().size;
+	bool widen = false;
+	forEachNode(moov, [&](Node& n) {
+		if (isType(n, "stco") && maxStcoOffset(n) + moovSize > UINT32_MAX) widen = true;
+	});
+	if (widen) {
+		forEachNode(moov, [](Node& n) {
+			if (isType(n, "stco")) stcoToCo64(n);
+		});
+		moovSize = nodeSize(moov);
+	}
+	forEachNode(moov, [&](Node& n) {
+		if (isType(n, "stco") || isType(n, "co64")) shiftOffsets(n, moovSize);
+	});
+
+	std::vector<uint8_t> moovOut;
+	serialize(moov, moovOut);
+
+	// Single sequential pass: boxes before mdat, moov, then the rest minus the old moov
+	std::string tmpPath = path + ".faststart";
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!in || !out) {
+			printf("CK::MP4 Unable to open %s for faststart\n", tmpPath.c_str());
+			return false;
+		}
+
+		std::vector<char> buffer(4 * 1024 * 1024);
+		bool ok = copyRange(in, out, 0, mdatInfo.offset, buffer);
+		out.write((const char*)moovOut.data(), moovOut.size());
+		for (const Box& b : boxes) {
+			if (!ok) break;
+			if (b.offset < mdatInfo.offset || b.offset == moovInfo.offset) continue;
+			ok = copyRange(in, out, b.offset, b.size, buffer);
+		}
+		out.close();
+		if (!ok || !out) {
+			printf("CK::MP4 Faststart copy failed for %s\n", path.c_str());
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		printf("CK::MP4 Unable to replace %s: %s\n", path.c_str(), ec.message().c_str());
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	printf("CK::MP4 Faststart %s: %.1f MB in %.1fms (%.1f MB/s)\n", path.c_str(),
+		fileEnd / 1048576.0, ms, ms > 0 ? fileEnd / 1048576.0 / (ms / 1000.0) : 0.0);
+	return true;
+}
+
+/////////////////////////////////////////////////////
+// CRASH RECOVERY
+/////////////////////////////////////////////////////
+
+std::string mp4::partialMarker(const std::string& path) {
+	return path + ".partial";
+}
+
+bool mp4::markPartial(const std::string& path) {
+	std::ofstream marker(partialMarker(path), std::ios::binary | std::ios::trunc);
+	return (bool)marker;
+}
+
+void mp4::clearPartial(const std::string& path) {
+	std::remove(partialMarker(path).c_str());
+}
+
+bool mp4::recoverFragmented(const std::string& path) {
+	auto begin = std::chrono::steady_clock::now();
+
+	std::error_code ec;
+	uint64_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec) return false;
+
+	// readBoxes already stops at a box cut short, a moof is only usable with its mdat behind it
+	std::vector<Box> boxes = readBoxes(path);
+	bool header = false;
+	bool inFragment = false;
+	int fragments = 0;
+	uint64_t validEnd = 0;
+	for (const Box& b : boxes) {
+		if (strcmp(b.type, "moov") == 0) {
+			header = true;
+		}
+		else if (strcmp(b.type, "moof") == 0) {
+			inFragment = true;
+			continue;
+		}
+		else if (strcmp(b.type, "mdat") == 0 && inFragment) {
+			fragments++;
+			validEnd = b.offset + b.size;
+		}
+		inFragment = false;
+	}
+	if (!header || fragments == 0) {
+		printf("CK::MP4 %s has no complete fragment, can't recover\n", path.c_str());
+		return false;
+	}
+
+	if (validEnd < fileSize) {
+		std::filesystem::resize_file(path, validEnd, ec);
+		if (ec) {
+			printf("CK::MP4 Unable to truncate %s: %s\n", path.c_str(), ec.message().c_str());
+			return false;
+		}
+	}
+	printf("CK::MP4 Recovered %s: %d fragments, dropped %llu bytes in %.1fms\n", path.c_str(), fragments,
+		(unsigned long long)(fileSize - validEnd),
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+	return true;
+}
+
+/////////////////////////////////////////////////////
+// BENCHMARK
+/////////////////////////////////////////////////////
+
+static void appendBox(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& payload) {
+	uint8_t hdr[8];
+	writeU32(hdr, (uint32_t)(8 + payload.size()));
+	memcpy(hdr + 4, type, 4);
+	out.insert(out.end(), hdr, hdr + 8);
+	out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// One track, one stco entry per chunk of the mdat that starts at dataStart
+static std::vector<uint8_t> benchMoov(uint64_t dataStart, uint32_t chunks, size_t chunkSize) {
+	std::vector<uint8_t> stco(8 + (size_t)chunks * 4, 0);
+	writeU32(&stco[4], chunks);
+	for (uint32_t c = 0; c < chunks; c++) writeU32(&stco[8 + c * 4], (uint32_t)(dataStart + (uint64_t)c * chunkSize));
+
+	std::vector<uint8_t> stbl, minf, mdia, trak, body, moov;
+	appendBox(stbl, "stsd", std::vector<uint8_t>(8, 0));
+	appendBox(stbl, "stco", stco);
+	appendBox(minf, "stbl", stbl);
+	appendBox(mdia, "minf", minf);
+	appendBox(trak, "tkhd", std::vector<uint8_t>(84, 0));
+	appendBox(trak, "mdia", mdia);
+	appendBox(body, "mvhd", std::vector<uint8_t>(100, 0));
+	appendBox(body, "trak", trak);
+	appendBox(moov, "moov", body);
+	return moov;
+}
+
+// ftyp, [free], mdat of `megabytes` in 64KB chunks, moov last the way the muxer leaves a replay save.
+// The free slot is big enough for the in place rewrite
+static bool writeBenchFile(const std::string& path, int megabytes, bool freeSlot) {
+	const size_t CHUNK = 64 * 1024;
+	const uint64_t mdatPayload = (uint64_t)megabytes * 1024 * 1024;
+	uint32_t chunks = (uint32_t)(mdatPayload / CHUNK);
+
+	std::vector<uint8_t> head;
+	appendBox(head, "ftyp", { 'i', 's', 'o', 'm', 0, 0, 2, 0, 'i', 's', 'o', 'm' });
+	if (freeSlot) appendBox(head, "free", std::vector<uint8_t>(benchMoov(0, chunks, CHUNK).size() + 64, 0));
+	std::vector<uint8_t> moov = benchMoov(head.size() + 8, chunks, CHUNK);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+	uint8_t mdatHdr[8];
+	writeU32(mdatHdr, (uint32_t)(8 + mdatPayload));
+	memcpy(mdatHdr + 4, "mdat", 4);
+	out.write((const char*)head.data(), head.size());
+	out.write((const char*)mdatHdr, 8);
+	std::vector<char> chunk(CHUNK);
+	for (size_t i = 0; i < CHUNK; i++) chunk[i] = (char)(i * 31);
+	for (uint32_t c = 0; c < chunks; c++) out.write(chunk.data(), CHUNK);
+	out.write((const char*)moov.data(), moov.size());
+	return (bool)out;
+}
+
+bool mp4::benchmark(const std::string& dir, int megabytes) {
+	megabytes = std::clamp(megabytes, 1, 4000);
+	const char* names[] = { "copy", "in place" };
+	bool ok = true;
+	for (int i = 0; i < 2; i++) {
+		std::string path = dir + "/CKBENCH_faststart.mp4";
+		if (!writeBenchFile(path, megabytes, i == 1)) {
+			printf("CK::MP4 [BENCH] Unable to create %s\n", path.c_str());
+			return false;
+		}
+		uint64_t bytes = std::filesystem::file_size(path);
+
+		auto begin = std::chrono::steady_clock::now();
+		bool moved = faststart(path);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		moved = moved && isFaststart(path);
+		ok = ok && moved;
+		// The in place rewrite only writes moov, its rate is over those bytes
+		if (i == 1) {
+			for (const Box& b : readBoxes(path)) {
+				if (memcmp(b.type, "moov", 4) == 0) bytes = b.size;
+			}
+		}
+		printf("CK::MP4 [BENCH] faststart %s: %.1f MB written in %.1fms, %.0f bytes/s (%.1f MB/s)%s\n", names[i],
+			bytes / 1048576.0, ms, ms > 0 ? bytes / (ms / 1000.0) : 0.0, ms > 0 ? bytes / 1048576.0 / (ms / 1000.0) : 0.0,
+			moved ? "" : " FAILED");
+		std::remove(path.c_str());
+	}
+	return ok;
+}
@@ -0,0 +1,178 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "pipeline.h"
+#include "threads.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static uint64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////
+// PIPELINE
+/////////////////////////////////////////////////////
+
+PostSavePipeline::PostSavePipeline() {
+	const char* names[STAGE_COUNT] = { "finalize", "faststart", "thumbnail", "upload", "notify" };
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		stages_[i].name = names[i];
+		stages_[i].workers = 1;
+		stages_[i].capacity = 16;
+	}
+	running_ = false;
+}
+
+PostSavePipeline::~PostSavePipeline() {
+	stop();
+}
+
+void PostSavePipeline::setStage(Stage stage, int workers, size_t capacity, StageFn fn) {
+	StageQueue& sq = stages_[stage];
+	sq.workers = std::max(1, workers);
+	sq.capacity = std::max<size_t>(1, capacity);
+	sq.fn = fn;
+}
+
+void PostSavePipeline::start() {
+	if (running_) return;
+	running_ = true;
+
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		for (int w = 0; w < stages_[i].workers; w++) {
+			stages_[i].threads.emplace_back(&PostSavePipeline::worker, this, (Stage)i);
+		}
+	}
+}
+
+void PostSavePipeline::stop() {
+	if (!running_) return;
+	running_ = false;
+
+	// Wake everything first, a worker can be blocked pushing into the next stage
+	for (auto& sq : stages_) {
+		const std::lock_guard<std::mutex> lock(sq.mtx);
+		sq.notEmpty.notify_all();
+		sq.notFull.notify_all();
+	}
+	for (auto& sq : stages_) {
+		for (auto& t : sq.threads) {
+			t.join();
+		}
+		sq.threads.clear();
+	}
+}
+
+bool PostSavePipeline::enqueue(const std::string& filePath) {
+	Job job;
+	job.filePath = filePath;
+	job.uploadPath = filePath;
+	job.thumbsUploaded = false;
+	job.uploadAttempts = 0;
+	job.stageMs.fill(0.0);
+	return resubmit(FINALIZE, job);
+}
+
+bool PostSavePipeline::resubmit(Stage stage, const Job& job) {
+	StageQueue& sq = stages_[stage];
+	const std::lock_guard<std::mutex> lock(sq.mtx);
+	if (!running_ || sq.jobs.size() >= sq.capacity) {
+		printf("CK::PIPE Queue full, dropping %s\n", job.filePath.c_str());
+		return false;
+	}
+	sq.jobs.push_back(job);
+	sq.jobs.back().stageStartNs = nowNs();
+	sq.notEmpty.notify_one();
+	return true;
+}
+
+void PostSavePipeline::push(Stage stage, Job job) {
+	// Workers may block here, that's the backpressure between stages
+	StageQueue& sq = stages_[stage];
+	std::unique_lock<std::mutex> lock(sq.mtx);
+	sq.notFull.wait(lock, [&]() { return !running_ || sq.jobs.size() < sq.capacity; });
+	if (!running_) return;
+
+	job.stageStartNs = nowNs();
+	sq.jobs.push_back(job);
+	sq.notEmpty.notify_one();
+}
+
+void PostSavePipeline::worker(Stage stage) {
+	// Trims, remuxes & uploads are never urgent enough to take time from the game
+	threads::apply(threads::BACKGROUND, "ck-pipeline");
+	StageQueue& sq = stages_[stage];
+
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(sq.mtx);
+			sq.notEmpty.wait(lock, [&]() { return !running_ || !sq.jobs.empty(); });
+			if (!running_) return;
+
+			job = sq.jobs.front();
+			sq.jobs.pop_front();
+			sq.notFull.notify_one();
+		}
+
+		uint64_t begin = nowNs();
+		sq.wait.record(begin - job.stageStartNs);
+
+		bool ok = sq.fn ? sq.fn(job) : true;
+
+		uint64_t elapsed = nowNs() - begin;
+		sq.run.record(elapsed);
+		job.stageMs[stage] = elapsed / 1000000.0;
+
+		if (!ok) {
+			printf("CK::PIPE %s stopped at %s\n", job.filePath.c_str(), sq.name);
+			continue;
+		}
+
+		if (stage + 1 < STAGE_COUNT) {
+			push((Stage)(stage + 1), job);
+		}
+		else {
+			printf("CK::PIPE Done %s [finalize %.1fms][faststart %.1fms][thumbnail %.1fms][upload %.1fms][notify %.1fms]\n",
+				job.filePath.c_str(), job.stageMs[FINALIZE], job.stageMs[FASTSTART],
+				job.stageMs[THUMBNAIL], job.stageMs[UPLOAD], job.stageMs[NOTIFY]);
+		}
+	}
+}
+
+void PostSavePipeline::registerMetrics(MetricsRegistry& registry) {
+	for (auto& sq : stages_) {
+		std::string labels = std::string("stage=\"") + sq.name + "\"";
+		registry.addHistogram("ck_pipeline_wait_seconds", "Time a saved clip waited for a stage worker", labels, &sq.wait);
+		registry.addHistogram("ck_pipeline_run_seconds", "Time spent inside a post-save stage", labels, &sq.run);
+	}
+}
+
+void PostSavePipeline::logStats() {
+	for (auto& sq : stages_) {
+		printf("CK::PIPE [%s] jobs=%llu wait p50=%.1fms p99=%.1fms run p50=%.1fms p99=%.1fms\n",
+			sq.name, (unsigned long long)sq.run.count(),
+			sq.wait.percentileMs(0.5), sq.wait.percentileMs(0.99),
+			sq.run.percentileMs(0.5), sq.run.percentileMs(0.99));
+	}
+}
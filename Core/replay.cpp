@@ -0,0 +1,852 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "replay.h"
+#include "writer.h"
+#include "threads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include <obs.hpp>
+#include <util/platform.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/////////////////////////////////////////////////////
+// SPILL FILE
+/////////////////////////////////////////////////////
+
+SpillFile::SpillFile() {
+	file_ = INVALID_HANDLE_VALUE;
+	mapping_ = NULL;
+	view_ = nullptr;
+	capacity_ = 0;
+}
+
+SpillFile::~SpillFile() {
+	close();
+}
+
+bool SpillFile::open(const std::string& path, size_t capacity) {
+	close();
+
+	// Temporary + delete on close, nothing is left behind if we crash
+	file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (file_ == INVALID_HANDLE_VALUE) {
+		printf("CK::REPLAY Failed to create spill file %s\n", path.c_str());
+		return false;
+	}
+
+	// Preallocate the whole ring up front so it never fragments
+	LARGE_INTEGER size;
+	size.QuadPart = (LONGLONG)capacity;
+	if (!SetFilePointerEx(file_, size, NULL, FILE_BEGIN) || !SetEndOfFile(file_)) {
+		printf("CK::REPLAY Failed to preallocate %zu bytes for spill file\n", capacity);
+		close();
+		return false;
+	}
+
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+	if (!mapping_) {
+		close();
+		return false;
+	}
+	view_ = (uint8_t*)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, capacity);
+	if (!view_) {
+		close();
+		return false;
+	}
+
+	path_ = path;
+	capacity_ = capacity;
+	return true;
+}
+
+void SpillFile::close() {
+	if (view_) {
+		UnmapViewOfFile(view_);
+		view_ = nullptr;
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+		mapping_ = NULL;
+	}
+	if (file_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+	// Delete on close covers it unless another handle kept the file open
+	if (!path_.empty()) {
+		DeleteFileA(path_.c_str());
+		path_.clear();
+	}
+	capacity_ = 0;
+}
+
+/////////////////////////////////////////////////////
+// REPLAY RING
+/////////////////////////////////////////////////////
+
+ReplayRing::ReplayRing() {
+	spillEnabled_ = false;
+	memoryUsec_ = 0;
+	memoryLimit_ = 0;
+	maxUsec_ = 0;
+	nextSeq_ = 0;
+	memoryBytes_ = 0;
+	videoDtsUsec_ = 0;
+	videoSysUsec_ = 0;
+}
+
+ReplayRing::~ReplayRing() {
+	close();
+}
+
+bool ReplayRing::open(const std::string& spillPath, size_t spillBytes, int memorySeconds, size_t memoryBytes, int maxSeconds) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	reset();
+	spill_.close();
+
+	maxUsec_ = maxSeconds * 1000000LL;
+	memoryUsec_ = std::min(memorySeconds, maxSeconds) * 1000000LL;
+	memoryLimit_ = memoryBytes;
+
+	spillEnabled_ = false;
+	if (maxSeconds > memorySeconds && spillBytes > 0) {
+		spillEnabled_ = spill_.open(spillPath, spillBytes);
+		if (!spillEnabled_) {
+			printf("CK::REPLAY Spill unavailable, history limited to memory!\n");
+		}
+	}
+	if (!spillEnabled_) {
+		// Everything has to fit in RAM
+		memoryUsec_ = maxUsec_;
+	}
+	diskIndex_.reset(spill_.capacity());
+	return true;
+}
+
+void ReplayRing::close() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	reset();
+	spill_.close();
+	spillEnabled_ = false;
+}
+
+void ReplayRing::clear() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	reset();
+}
+
+void ReplayRing::reset() {
+	open_ = nullptr;
+	memory_.clear();
+	disk_.clear();
+	memoryBytes_ = 0;
+	diskIndex_.reset(spill_.capacity());
+	videoDtsUsec_ = 0;
+	videoSysUsec_ = 0;
+}
+
+void ReplayRing::push(const struct encoder_packet* pkt) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	bool video = pkt->type == OBS_ENCODER_VIDEO;
+	if (video && pkt->keyframe) {
+		closeGop();
+		open_ = std::make_shared<ReplayGop>();
+		open_->seq = nextSeq_++;
+		open_->startUsec = pkt->dts_usec;
+		open_->endUsec = pkt->dts_usec;
+		open_->diskOffset = 0;
+		open_->diskSize = 0;
+	}
+	if (!open_) {
+		// Nothing is playable before the first keyframe
+		return;
+	}
+
+	ReplayPacket p;
+	p.type = pkt->type;
+	p.track = pkt->track_idx;
+	p.pts = pkt->pts;
+	p.dts = pkt->dts;
+	p.timebaseNum = pkt->timebase_num;
+	p.timebaseDen = pkt->timebase_den;
+	p.dtsUsec = pkt->dts_usec;
+	p.sysDtsUsec = pkt->sys_dts_usec;
+	p.keyframe = video ? pkt->keyframe : true;
+	p.priority = pkt->priority;
+	p.offset = open_->data.size();
+	p.size = pkt->size;
+
+	open_->data.insert(open_->data.end(), pkt->data, pkt->data + pkt->size);
+	open_->packets.push_back(p);
+	open_->endUsec = std::max(open_->endUsec, (int64_t)pkt->dts_usec);
+	memoryBytes_ += pkt->size;
+	if (video) {
+		videoDtsUsec_ = pkt->dts_usec;
+		videoSysUsec_ = pkt->sys_dts_usec;
+	}
+
+	enforceLimits();
+}
+
+void ReplayRing::closeGop() {
+	if (!open_) return;
+	memory_.push_back(open_);
+	open_ = nullptr;
+}
+
+void ReplayRing::enforceLimits() {
+	int64_t newest = open_ ? open_->endUsec : (memory_.empty() ? 0 : memory_.back()->endUsec);
+
+	// Memory tier, oldest closed GOPs move to disk (or are dropped without a spill file)
+	while (!memory_.empty()
+		&& (newest - memory_.front()->endUsec > memoryUsec_ || memoryBytes_ > memoryLimit_)) {
+		std::shared_ptr<ReplayGop> gop = memory_.front();
+		memory_.pop_front();
+		memoryBytes_ -= gop->data.size();
+		if (spillEnabled_) {
+			spillGop(gop);
+		}
+	}
+
+	// Whole history
+	while (!disk_.empty() && newest - disk_.front()->endUsec > maxUsec_) {
+		diskIndex_.popFront();
+		disk_.pop_front();
+	}
+}
+
+bool ReplayRing::spillGop(std::shared_ptr<ReplayGop> gop) {
+	size_t size = gop->data.size();
+	size_t pos = 0;
+	size_t evicted = 0;
+	if (!diskIndex_.reserve(size, pos, evicted)) {
+		printf("CK::REPLAY GOP of %zu bytes does not fit the spill file, dropped\n", size);
+		return false;
+	}
+	// The slot overwrote the oldest GOPs
+	for (size_t i = 0; i < evicted && !disk_.empty(); i++) {
+		disk_.pop_front();
+	}
+
+	memcpy(spill_.data() + pos, gop->data.data(), size);
+
+	// Snapshots may still hold the in-memory GOP, the disk tier gets its own record
+	std::shared_ptr<ReplayGop> spilled = std::make_shared<ReplayGop>();
+	spilled->seq = gop->seq;
+	spilled->startUsec = gop->startUsec;
+	spilled->endUsec = gop->endUsec;
+	spilled->packets = gop->packets;
+	spilled->diskOffset = pos;
+	spilled->diskSize = size;
+
+	disk_.push_back(spilled);
+	return true;
+}
+
+std::vector<std::shared_ptr<const ReplayGop>> ReplayRing::snapshot(int64_t fromUsec) {
+	std::vector<std::shared_ptr<const ReplayGop>> result;
+
+	auto readBack = [this](const std::shared_ptr<ReplayGop>& gop) {
+		std::shared_ptr<ReplayGop> copy = std::make_shared<ReplayGop>(*gop);
+		const uint8_t* src = spill_.data() + gop->diskOffset;
+		copy->data.assign(src, src + gop->diskSize);
+		return copy;
+	};
+
+	// Spilled GOPs are copied one at a time so the encoder threads only ever wait for one memcpy
+	std::vector<uint64_t> spilled;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		for (auto& gop : disk_) {
+			if (gop->endUsec >= fromUsec) {
+				spilled.push_back(gop->seq);
+			}
+		}
+	}
+	for (uint64_t seq : spilled) {
+		const std::lock_guard<std::mutex> lock(mtx_);
+		auto it = std::find_if(disk_.begin(), disk_.end(),
+			[seq](const std::shared_ptr<ReplayGop>& g) { return g->seq == seq; });
+		if (it == disk_.end()) {
+			continue; // Overwritten while saving
+		}
+		result.push_back(readBack(*it));
+	}
+
+	const std::lock_guard<std::mutex> lock(mtx_);
+	uint64_t lastSeq = result.empty() ? 0 : result.back()->seq + 1;
+	// Anything spilled since the first pass
+	for (auto& gop : disk_) {
+		if (gop->seq >= lastSeq && gop->endUsec >= fromUsec) {
+			result.push_back(readBack(gop));
+		}
+	}
+	lastSeq = result.empty() ? 0 : result.back()->seq + 1;
+	for (auto& gop : memory_) {
+		if (gop->seq >= lastSeq && gop->endUsec >= fromUsec) {
+			result.push_back(gop);
+		}
+	}
+	// The open GOP keeps growing, take a copy
+	if (open_) {
+		result.push_back(std::make_shared<ReplayGop>(*open_));
+	}
+	return result;
+}
+
+int64_t ReplayRing::latestUsec() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (open_) return open_->endUsec;
+	if (!memory_.empty()) return memory_.back()->endUsec;
+	if (!disk_.empty()) return disk_.back()->endUsec;
+	return 0;
+}
+
+int64_t ReplayRing::oldestUsec() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (!disk_.empty()) return disk_.front()->startUsec;
+	if (!memory_.empty()) return memory_.front()->startUsec;
+	if (open_) return open_->startUsec;
+	return 0;
+}
+
+int64_t ReplayRing::latestSysUsec() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return videoSysUsec_;
+}
+
+// Both clocks advance together for the life of the encoder, the newest frame gives the offset
+int64_t ReplayRing::sysToDtsUsec(int64_t sysUsec) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return sysUsec - (videoSysUsec_ - videoDtsUsec_);
+}
+
+size_t ReplayRing::memoryBytes() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return memoryBytes_;
+}
+
+size_t ReplayRing::diskBytes() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return diskIndex_.usedBytes();
+}
+
+/////////////////////////////////////////////////////
+// MP4 WRITER
+/////////////////////////////////////////////////////
+
+static AVCodecID toAVCodec(const std::string& codec) {
+	if (codec == "hevc") return AV_CODEC_ID_HEVC;
+	if (codec == "av1") return AV_CODEC_ID_AV1;
+	return AV_CODEC_ID_H264;
+}
+
+static void setExtraData(AVCodecParameters* par, const std::vector<uint8_t>& extra) {
+	if (extra.empty()) return;
+	par->extradata = (uint8_t*)av_mallocz(extra.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+	memcpy(par->extradata, extra.data(), extra.size());
+	par->extradata_size = (int)extra.size();
+}
+
+bool replay::writeMp4(const std::string& path,
+			const ReplayStreamInfo& info,
+			const std::vector<std::shared_ptr<const ReplayGop>>& gops,
+			int64_t fromUsec,
+			int64_t toUsec) {
+	if (gops.empty()) {
+		printf("CK::REPLAY Nothing buffered to save!\n");
+		return false;
+	}
+
+	// Always begin on a keyframe, the latest one at or before fromUsec
+	int64_t startUsec = gops.front()->startUsec;
+	for (auto& gop : gops) {
+		if (gop->startUsec > fromUsec) break;
+		startUsec = gop->startUsec;
+	}
+
+	AVFormatContext* ctx = nullptr;
+	if (avformat_alloc_output_context2(&ctx, nullptr, "mp4", path.c_str()) < 0 || !ctx) {
+		printf("CK::REPLAY Failed to allocate muxer!\n");
+		return false;
+	}
+
+	AVStream* vs = avformat_new_stream(ctx, nullptr);
+	vs->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+	vs->codecpar->codec_id = toAVCodec(info.videoCodec);
+	vs->codecpar->width = info.width;
+	vs->codecpar->height = info.height;
+	setExtraData(vs->codecpar, info.videoExtra);
+	vs->time_base = AVRational{ (int)info.fpsDen, (int)info.fpsNum };
+	vs->avg_frame_rate = AVRational{ (int)info.fpsNum, (int)info.fpsDen };
+
+	AVStream* as = avformat_new_stream(ctx, nullptr);
+	as->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+	as->codecpar->codec_id = AV_CODEC_ID_AAC;
+	as->codecpar->sample_rate = info.sampleRate;
+	as->codecpar->frame_size = 1024;
+	av_channel_layout_default(&as->codecpar->ch_layout, info.channels);
+	setExtraData(as->codecpar, info.audioExtra);
+	as->time_base = AVRational{ 1, (int)info.sampleRate };
+
+	// Payload plus room for moov, trimmed on close
+	uint64_t expectedSize = 1024 * 1024;
+	for (auto& gop : gops) {
+		if (gop->endUsec >= startUsec) expectedSize += gop->data.size();
+	}
+	ctx->pb = WriteBehindFile::openAvio(path, expectedSize);
+	if (!ctx->pb) {
+		printf("CK::REPLAY Failed to open %s\n", path.c_str());
+		avformat_free_context(ctx);
+		return false;
+	}
+	if (avformat_write_header(ctx, nullptr) < 0) {
+		printf("CK::REPLAY Failed to write header!\n");
+		WriteBehindFile::closeAvio(&ctx->pb);
+		avformat_free_context(ctx);
+		return false;
+	}
+
+	// Packets are already encoded, only timestamps are rebased to the first keyframe
+	AVPacket* pkt = av_packet_alloc();
+	bool ok = true;
+	for (auto& gop : gops) {
+		for (const ReplayPacket& p : gop->packets) {
+			if (p.dtsUsec < startUsec || p.dtsUsec > toUsec) continue;
+
+			bool video = p.type == OBS_ENCODER_VIDEO;
+			if (!video && p.track != 0) continue; // Single audio track
+
+			AVStream* st = video ? vs : as;
+			AVRational tb = AVRational{ p.timebaseNum, p.timebaseDen };
+			int64_t offset = av_rescale_q(startUsec, AVRational{ 1, 1000000 }, tb);
+
+			av_packet_unref(pkt);
+			pkt->data = const_cast<uint8_t*>(gop->data.data() + p.offset);
+			pkt->size = (int)p.size;
+			pkt->pts = av_rescale_q(p.pts - offset, tb, st->time_base);
+			pkt->dts = av_rescale_q(p.dts - offset, tb, st->time_base);
+			pkt->stream_index = st->index;
+			pkt->flags = p.keyframe ? AV_PKT_FLAG_KEY : 0;
+
+			if (av_interleaved_write_frame(ctx, pkt) < 0) {
+				printf("CK::REPLAY Failed to write packet!\n");
+				ok = false;
+				break;
+			}
+		}
+		if (!ok) break;
+	}
+
+	av_write_trailer(ctx);
+	av_packet_free(&pkt);
+	ok = WriteBehindFile::closeAvio(&ctx->pb) && ok;
+	avformat_free_context(ctx);
+	return ok;
+}
+
+/////////////////////////////////////////////////////
+// OBS OUTPUT
+/////////////////////////////////////////////////////
+
+// Encoder latency allowance past a hotkey save's end target, after that it saves what arrived
+static const uint64_t ALIGN_WAIT_NS = 1000000000ULL;
+
+namespace {
+
+struct SaveRequest {
+	int64_t fromUsec;
+	int64_t toUsec;
+	int64_t seconds;
+	// Hotkey saves: the press time & where the clip should end, both on the os_gettime_ns clock
+	uint64_t pressNs;
+	int64_t endSysUsec;
+	uint64_t queuedNs;
+	// Copied at request time, a restart rewrites the output's own while this waits
+	std::string directory;
+	std::string format;
+	std::string extension;
+	bool allowSpaces;
+	ReplayStreamInfo info;
+};
+
+struct ReplayOutput {
+	obs_output_t* output;
+	ReplayRing ring;
+	ReplayStreamInfo info;
+	std::atomic<uint64_t> totalBytes; // Everything pushed, for obs_output_get_total_bytes
+	std::atomic<uint64_t> videoPackets; // Packet flow for the encoder watchdog
+
+	// Settings
+	std::string directory;
+	std::string format;
+	std::string extension;
+	std::string spillPath;
+	bool allowSpaces;
+	int maxSeconds;
+	int memorySeconds;
+	size_t memoryBytes;
+
+	// Saves run here, off the proc caller's thread. saveMtx also guards the settings & info above
+	std::thread saver;
+	std::mutex saveMtx;
+	std::condition_variable saveCv;
+	std::condition_variable idleCv;
+	std::deque<SaveRequest> saveQueue;
+	bool capturing; // Between ringStart & ringStop, saves are only taken then
+	bool saving;
+	bool exiting;
+	std::atomic<bool> stopping; // Hotkey saves stop waiting for frames that won't come
+
+	std::mutex pathMtx;
+	std::string lastReplay;
+};
+
+}
+
+static const char* ringGetName(void* type) {
+	return "Conkors Replay Ring";
+}
+
+// Pins a hotkey save's end to its target frame. A target ahead of the newest frame waits for the
+// encoder to get there, one already passed drops the frames captured since
+static void alignSave(ReplayOutput* ro, SaveRequest& req) {
+	uint64_t deadline = (uint64_t)req.endSysUsec * 1000 + ALIGN_WAIT_NS;
+	while (ro->ring.latestSysUsec() < req.endSysUsec && !ro->stopping && os_gettime_ns() < deadline) {
+		os_sleep_ms(5);
+	}
+	req.toUsec = std::min(ro->ring.sysToDtsUsec(req.endSysUsec), ro->ring.latestUsec());
+	req.fromUsec = req.toUsec - req.seconds * 1000000LL;
+}
+
+static void ringSave(ReplayOutput* ro, SaveRequest req) {
+	uint64_t begin = os_gettime_ns();
+	if (req.pressNs) {
+		alignSave(ro, req);
+	}
+
+	std::vector<std::shared_ptr<const ReplayGop>> gops = ro->ring.snapshot(req.fromUsec);
+
+	// Capture time of the last frame that made it in, against the target
+	int64_t endErrorUsec = 0;
+	if (req.pressNs) {
+		int64_t lastDts = INT64_MIN;
+		for (auto& gop : gops) {
+			for (const ReplayPacket& p : gop->packets) {
+				if (p.type != OBS_ENCODER_VIDEO || p.dtsUsec > req.toUsec || p.dtsUsec < lastDts) continue;
+				lastDts = p.dtsUsec;
+				endErrorUsec = p.sysDtsUsec - req.endSysUsec;
+			}
+		}
+	}
+
+	char* name = os_generate_formatted_filename(req.extension.c_str(), req.allowSpaces, req.format.c_str());
+	std::string path = req.directory + name;
+	bfree(name);
+
+	if (!replay::writeMp4(path, req.info, gops, req.fromUsec, req.toUsec)) {
+		printf("CK::REPLAY Failed to save replay %s\n", path.c_str());
+		return;
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(ro->pathMtx);
+		ro->lastReplay = path;
+	}
+
+	printf("CK::REPLAY Saved %s in %.1fms [memory %zu KB][disk %zu KB]\n", path.c_str(),
+		(os_gettime_ns() - begin) / 1000000.0, ro->ring.memoryBytes() / 1024, ro->ring.diskBytes() / 1024);
+	if (req.pressNs) {
+		printf("CK::REPLAY [HOTKEY] press to request %.1fms, clip end %+.1fms from target\n",
+			(req.queuedNs - req.pressNs) / 1000000.0, endErrorUsec / 1000.0);
+	}
+
+	calldata_t cd = { 0 };
+	calldata_set_int(&cd, "press_ns", (long long)req.pressNs);
+	calldata_set_int(&cd, "end_error_us", (long long)endErrorUsec);
+	signal_handler_t* sh = obs_output_get_signal_handler(ro->output);
+	signal_handler_signal(sh, "saved", &cd);
+	calldata_free(&cd);
+}
+
+static void ringSaverLoop(ReplayOutput* ro) {
+	threads::apply(threads::NORMAL, "ck-replay-save");
+	while (true) {
+		SaveRequest req;
+		{
+			std::unique_lock<std::mutex> lock(ro->saveMtx);
+			ro->saveCv.wait(lock, [ro]() { return ro->exiting || !ro->saveQueue.empty(); });
+			if (ro->saveQueue.empty()) {
+				return; // Exiting
+			}
+			req = ro->saveQueue.front();
+			ro->saveQueue.pop_front();
+			ro->saving = true;
+		}
+		ringSave(ro, req);
+		{
+			const std::lock_guard<std::mutex> lock(ro->saveMtx);
+			ro->saving = false;
+		}
+		ro->idleCv.notify_all();
+	}
+}
+
+static void ringSaveProc(void* data, calldata_t* cd) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	const std::lock_guard<std::mutex> lock(ro->saveMtx);
+	if (!ro->capturing) return;
+
+	// Any window up to the ring length, all served from the same packets
+	int64_t seconds = calldata_int(cd, "seconds");
+	if (seconds <= 0 || seconds > ro->maxSeconds) {
+		seconds = ro->maxSeconds;
+	}
+
+	SaveRequest req;
+	req.directory = ro->directory;
+	req.format = ro->format;
+	req.extension = ro->extension;
+	req.allowSpaces = ro->allowSpaces;
+	req.info = ro->info;
+	req.seconds = seconds;
+	req.toUsec = ro->ring.latestUsec();
+	req.fromUsec = req.toUsec - seconds * 1000000LL;
+	req.queuedNs = os_gettime_ns();
+	req.pressNs = (uint64_t)calldata_int(cd, "press_ns");
+	req.endSysUsec = 0;
+	if (req.pressNs) {
+		// The window is placed again on the saver thread, once the target frame exists
+		req.endSysUsec = (int64_t)(req.pressNs / 1000) + calldata_int(cd, "end_offset_ms") * 1000;
+	}
+
+	ro->saveQueue.push_back(req);
+	ro->saveCv.notify_one();
+}
+
+static void ringGetLastReplayProc(void* data, calldata_t* cd) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	const std::lock_guard<std::mutex> lock(ro->pathMtx);
+	calldata_set_string(cd, "path", ro->lastReplay.c_str());
+}
+
+// Buffer fill for metrics, how much history is held against how much is wanted
+static void ringGetStatsProc(void* data, calldata_t* cd) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	int64_t oldest = ro->ring.oldestUsec();
+	int64_t latest = ro->ring.latestUsec();
+	calldata_set_int(cd, "memory_bytes", (long long)ro->ring.memoryBytes());
+	calldata_set_int(cd, "disk_bytes", (long long)ro->ring.diskBytes());
+	calldata_set_int(cd, "span_ms", oldest && latest > oldest ? (latest - oldest) / 1000 : 0);
+	int maxSeconds;
+	{
+		const std::lock_guard<std::mutex> lock(ro->saveMtx);
+		maxSeconds = ro->maxSeconds;
+	}
+	calldata_set_int(cd, "max_ms", (long long)maxSeconds * 1000);
+	calldata_set_int(cd, "video_packets", (long long)ro->videoPackets);
+}
+
+static uint64_t ringTotalBytes(void* data) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	return ro->totalBytes;
+}
+
+static void ringUpdate(void* data, obs_data_t* settings) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	const std::lock_guard<std::mutex> lock(ro->saveMtx);
+
+	ro->directory = obs_data_get_string(settings, "directory");
+	ro->format = obs_data_get_string(settings, "format");
+	ro->extension = obs_data_get_string(settings, "extension");
+	ro->allowSpaces = obs_data_get_bool(settings, "allow_spaces");
+	ro->maxSeconds = (int)obs_data_get_int(settings, "max_time_sec");
+	ro->memorySeconds = (int)obs_data_get_int(settings, "memory_sec");
+	ro->memoryBytes = (size_t)obs_data_get_int(settings, "max_size_mb") * 1024 * 1024;
+
+	ro->spillPath = obs_data_get_string(settings, "spill_path");
+	if (ro->spillPath.empty()) {
+		// Per process, a second instance would otherwise truncate the first one's history
+		std::error_code ec;
+		std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+		if (ec) tmp = ro->directory;
+		ro->spillPath = (tmp / ("CKREPLAY-" + std::to_string(GetCurrentProcessId()) + ".spill")).string();
+	}
+}
+
+static void ringDefaults(obs_data_t* settings) {
+	obs_data_set_default_int(settings, "max_time_sec", 30);
+	obs_data_set_default_int(settings, "memory_sec", 30);
+	obs_data_set_default_int(settings, "max_size_mb", 512);
+	obs_data_set_default_string(settings, "extension", "mp4");
+}
+
+static void* ringCreate(obs_data_t* settings, obs_output_t* output) {
+	ReplayOutput* ro = new ReplayOutput();
+	ro->output = output;
+	ro->capturing = false;
+	ro->saving = false;
+	ro->exiting = false;
+	ro->stopping = false;
+	ro->totalBytes = 0;
+	ro->videoPackets = 0;
+
+	// Same procs & signal as libobs' replay_buffer, callers don't need to care which one they have
+	proc_handler_t* ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph, "void save(in int seconds, in int press_ns, in int end_offset_ms)", ringSaveProc, ro);
+	proc_handler_add(ph, "void get_last_replay(out string path)", ringGetLastReplayProc, ro);
+	proc_handler_add(ph, "void get_stats(out int memory_bytes, out int disk_bytes, out int span_ms, out int max_ms, out int video_packets)", ringGetStatsProc, ro);
+
+	signal_handler_t* sh = obs_output_get_signal_handler(output);
+	signal_handler_add(sh, "void saved(int press_ns, int end_error_us)");
+
+	ringUpdate(ro, settings);
+	ro->saver = std::thread(ringSaverLoop, ro);
+	return ro;
+}
+
+static void ringDestroy(void* data) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	{
+		const std::lock_guard<std::mutex> lock(ro->saveMtx);
+		ro->exiting = true;
+		ro->saveCv.notify_one();
+	}
+	ro->saver.join();
+	ro->ring.close();
+	delete ro;
+}
+
+// Caller holds saveMtx. Takes no new saves & returns once the queued ones are written
+static void waitSaverIdle(ReplayOutput* ro, std::unique_lock<std::mutex>& lock) {
+	ro->capturing = false;
+	ro->stopping = true;
+	ro->idleCv.wait(lock, [ro]() { return ro->saveQueue.empty() && !ro->saving; });
+}
+
+static bool ringStart(void* data) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+
+	if (!obs_output_can_begin_data_capture(ro->output, 0)) return false;
+	if (!obs_output_initialize_encoders(ro->output, 0)) return false;
+
+	obs_encoder_t* venc = obs_output_get_video_encoder(ro->output);
+	obs_encoder_t* aenc = obs_output_get_audio_encoder(ro->output, 0);
+	if (!venc || !aenc) return false;
+
+	// Codec parameters for muxing later
+	struct obs_video_info ovi;
+	obs_get_video_info(&ovi);
+
+	ReplayStreamInfo info;
+	info.videoCodec = obs_encoder_get_codec(venc);
+	info.width = obs_encoder_get_width(venc);
+	info.height = obs_encoder_get_height(venc);
+	info.fpsNum = ovi.fps_num;
+	info.fpsDen = ovi.fps_den;
+	info.sampleRate = obs_encoder_get_sample_rate(aenc);
+	info.channels = (uint32_t)audio_output_get_channels(obs_get_audio());
+
+	uint8_t* extra = nullptr;
+	size_t extraSize = 0;
+	if (obs_encoder_get_extra_data(venc, &extra, &extraSize)) {
+		info.videoExtra.assign(extra, extra + extraSize);
+	}
+	if (obs_encoder_get_extra_data(aenc, &extra, &extraSize)) {
+		info.audioExtra.assign(extra, extra + extraSize);
+	}
+
+	// Size the spill ring from the configured bitrates, with headroom for keyframe bursts
+	OBSDataAutoRelease vsettings = obs_encoder_get_settings(venc);
+	OBSDataAutoRelease asettings = obs_encoder_get_settings(aenc);
+	int64_t kbps = obs_data_get_int(vsettings, "bitrate") + obs_data_get_int(asettings, "bitrate");
+	if (kbps <= 0) kbps = 6000;
+	{
+		// Normally ringStop already drained it, an encoder failure stops the output without one
+		std::unique_lock<std::mutex> lock(ro->saveMtx);
+		waitSaverIdle(ro, lock);
+		ro->info = info;
+		int spillSeconds = std::max(0, ro->maxSeconds - ro->memorySeconds);
+		size_t spillBytes = (size_t)(kbps * 1000 / 8) * spillSeconds * 3 / 2;
+		ro->ring.open(ro->spillPath, spillBytes, ro->memorySeconds, ro->memoryBytes, ro->maxSeconds);
+		ro->stopping = false;
+		ro->capturing = true;
+	}
+
+	obs_output_begin_data_capture(ro->output, 0);
+	return true;
+}
+
+// Queued saves still write from the ring as it is, the next ringStart reopens it only after
+static void ringStop(void* data, uint64_t ts) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	obs_output_end_data_capture(ro->output);
+
+	std::unique_lock<std::mutex> lock(ro->saveMtx);
+	waitSaverIdle(ro, lock);
+}
+
+static void ringEncodedPacket(void* data, struct encoder_packet* pkt) {
+	ReplayOutput* ro = (ReplayOutput*)data;
+	if (!pkt) {
+		// Encoder failure
+		obs_output_signal_stop(ro->output, OBS_OUTPUT_ENCODE_ERROR);
+		return;
+	}
+	// Packets arrive on the thread that encoded them: the video thread, the GPU encode thread or audio.
+	// Only a video encoder's thread is ENCODE, one that already has a role (graphics) keeps it
+	thread_local bool checked = false;
+	if (!checked && pkt->type == OBS_ENCODER_VIDEO) {
+		if (!threads::hasRole()) threads::apply(threads::ENCODE, nullptr);
+		checked = true;
+	}
+	if (pkt->type == OBS_ENCODER_VIDEO) ro->videoPackets++;
+	ro->totalBytes += pkt->size;
+	ro->ring.push(pkt);
+}
+
+void replay::registerOutput() {
+	struct obs_output_info info = {};
+	info.id = REPLAY_RING_OUTPUT_ID;
+	info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+	info.encoded_video_codecs = "h264;hevc;av1";
+	info.encoded_audio_codecs = "aac";
+	info.get_name = ringGetName;
+	info.create = ringCreate;
+	info.destroy = ringDestroy;
+	info.start = ringStart;
+	info.stop = ringStop;
+	info.encoded_packet = ringEncodedPacket;
+	info.update = ringUpdate;
+	info.get_defaults = ringDefaults;
+	info.get_total_bytes = ringTotalBytes;
+	obs_register_output(&info);
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "scene.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <emmintrin.h>
+
+// Sum of absolute differences over one TILE x TILE block
+static uint32_t tileSad(const uint8_t* a, uint32_t strideA, const uint8_t* b, uint32_t strideB) {
+	__m128i acc = _mm_setzero_si128();
+	for (int y = 0; y < ChangeDetector::TILE; y++) {
+		__m128i ra = _mm_loadu_si128((const __m128i*)(a + y * strideA));
+		__m128i rb = _mm_loadu_si128((const __m128i*)(b + y * strideB));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(ra, rb));
+	}
+	return (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+}
+
+ChangeDetector::ChangeDetector(uint32_t tileThreshold) {
+	tileThreshold_ = tileThreshold;
+	prev_.resize(WIDTH * HEIGHT);
+	hasPrev_ = false;
+	changedTiles_ = 0;
+}
+
+bool ChangeDetector::feed(const uint8_t* luma, uint32_t linesize) {
+	changedTiles_ = 0;
+	if (hasPrev_) {
+		for (int ty = 0; ty < HEIGHT; ty += TILE) {
+			for (int tx = 0; tx < WIDTH; tx += TILE) {
+				uint32_t sad = tileSad(luma + ty * linesize + tx, linesize, prev_.data() + ty * WIDTH + tx, WIDTH);
+				if (sad > tileThreshold_) changedTiles_++;
+			}
+		}
+	}
+	else {
+		changedTiles_ = (WIDTH / TILE) * (HEIGHT / TILE);
+		hasPrev_ = true;
+	}
+
+	for (int y = 0; y < HEIGHT; y++) {
+		memcpy(prev_.data() + y * WIDTH, luma + y * linesize, WIDTH);
+	}
+	return changedTiles_ > 0;
+}
+
+int ChangeDetector::changedTiles() const {
+	return changedTiles_;
+}
+
+void ChangeDetector::reset() {
+	hasPrev_ = false;
+	changedTiles_ = 0;
+}
+
+void ChangeDetector::benchmark(int frames) {
+	// First half a still desktop, second half a small box moving across it
+	std::vector<uint8_t> frame(WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			frame[y * WIDTH + x] = (uint8_t)(16 + ((x / 8 + y / 8) % 2) * 40);
+		}
+	}
+	std::vector<uint8_t> base = frame;
+
+	ChangeDetector detector;
+	int staticHalfFlagged = 0;
+	int movingHalfMissed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		bool moving = i >= frames / 2;
+		if (moving) {
+			frame = base;
+			int bx = (i * 3) % (WIDTH - 8);
+			for (int y = 60; y < 68; y++) {
+				memset(frame.data() + y * WIDTH + bx, 235, 8);
+			}
+		}
+		bool changed = detector.feed(frame.data(), WIDTH);
+		if (i == 0) continue;
+		if (!moving && changed) staticHalfFlagged++;
+		if (moving && !changed) movingHalfMissed++;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	printf("CK::SCENE [BENCH] %d frames, %.2fus/frame, static half flagged changed %d, moving half missed %d\n",
+		frames, ms * 1000.0 / frames, staticHalfFlagged, movingHalfMissed);
+}
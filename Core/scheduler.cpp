@@ -0,0 +1,208 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "scheduler.h"
+
+#include <algorithm>
+
+static uint32_t timerIndex(Scheduler::TimerId id) {
+	return (uint32_t)(id & 0xFFFFFFFF) - 1;
+}
+
+static uint32_t timerGeneration(Scheduler::TimerId id) {
+	return (uint32_t)(id >> 32);
+}
+
+Scheduler::Scheduler(uint32_t tickMs, uint32_t slots) {
+	tickMs_ = std::max<uint32_t>(1, tickMs);
+	wheel_.resize(std::max<uint32_t>(1, slots));
+	currentMs_ = 0;
+	lastTick_ = 0;
+	running_ = false;
+	epoch_ = std::chrono::steady_clock::now();
+}
+
+Scheduler::~Scheduler() {
+	stop();
+}
+
+void Scheduler::start() {
+	if (running_) return;
+	running_ = true;
+	thread_ = std::thread(&Scheduler::loop, this);
+}
+
+void Scheduler::stop() {
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		if (!running_) return;
+		running_ = false;
+	}
+	wake_.notify_all();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+}
+
+uint64_t Scheduler::nowMs() {
+	if (!running_) {
+		const std::lock_guard<std::mutex> lock(mtx_);
+		return currentMs_;
+	}
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+Scheduler::TimerId Scheduler::schedule(uint64_t delayMs, Task task) {
+	return add(delayMs, 0, std::move(task));
+}
+
+Scheduler::TimerId Scheduler::scheduleEvery(uint64_t periodMs, Task task) {
+	return add(periodMs, std::max<uint64_t>(1, periodMs), std::move(task));
+}
+
+Scheduler::TimerId Scheduler::add(uint64_t delayMs, uint64_t periodMs, Task task) {
+	uint64_t now = nowMs();
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return addLocked(now, delayMs, periodMs, std::move(task));
+}
+
+Scheduler::TimerId Scheduler::addLocked(uint64_t now, uint64_t delayMs, uint64_t periodMs, Task task) {
+	uint32_t index;
+	if (!freeTimers_.empty()) {
+		index = freeTimers_.back();
+		freeTimers_.pop_back();
+	}
+	else {
+		index = (uint32_t)timers_.size();
+		timers_.push_back(Timer());
+		timers_[index].generation = 1;
+	}
+
+	Timer& t = timers_[index];
+	t.task = std::move(task);
+	// Never due before the next tick, so a timer can't fire inside the call that made it
+	t.deadlineMs = std::max(now, currentMs_) + delayMs;
+	t.periodMs = periodMs;
+	t.active = true;
+	insert(index);
+
+	return ((uint64_t)t.generation << 32) | (index + 1);
+}
+
+void Scheduler::insert(uint32_t index) {
+	Timer& t = timers_[index];
+	// Round up so nothing fires early, and never into a slot that was already swept
+	uint64_t slot = std::max((t.deadlineMs + tickMs_ - 1) / tickMs_, lastTick_);
+	wheel_[slot % wheel_.size()].push_back({ index, t.generation });
+}
+
+void Scheduler::release(uint32_t index) {
+	// Wheel entries are dropped lazily, the generation bump makes them stale
+	Timer& t = timers_[index];
+	t.task = nullptr;
+	t.active = false;
+	t.generation++;
+	if (t.generation == 0) t.generation = 1;
+	freeTimers_.push_back(index);
+}
+
+bool Scheduler::cancel(TimerId id) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	return cancelLocked(id);
+}
+
+bool Scheduler::cancelLocked(TimerId id) {
+	if (id == INVALID_TIMER) return false;
+
+	uint32_t index = timerIndex(id);
+	if (index >= timers_.size()) return false;
+	Timer& t = timers_[index];
+	if (!t.active || t.generation != timerGeneration(id)) return false;
+	release(index);
+	return true;
+}
+
+void Scheduler::debounce(const std::string& key, uint64_t delayMs, Task task) {
+	uint64_t now = nowMs();
+
+	const std::lock_guard<std::mutex> lock(mtx_);
+	TimerId& id = debounced_[key];
+	cancelLocked(id);
+	id = addLocked(now, delayMs, 0, std::move(task));
+}
+
+void Scheduler::tick(uint64_t nowMs) {
+	std::vector<Task> due;
+	std::vector<uint32_t> rearm;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		if (nowMs < currentMs_) return;
+		currentMs_ = nowMs;
+
+		uint64_t target = nowMs / tickMs_;
+		if (target < lastTick_) return;
+		// A jump longer than a full turn only has to visit every slot once
+		uint64_t steps = std::min<uint64_t>(target - lastTick_ + 1, wheel_.size());
+		uint64_t first = target + 1 - steps;
+
+		for (uint64_t s = first; s <= target; s++) {
+			std::vector<Entry>& slot = wheel_[s % wheel_.size()];
+			size_t keep = 0;
+			for (size_t i = 0; i < slot.size(); i++) {
+				Entry e = slot[i];
+				Timer& t = timers_[e.index];
+				if (!t.active || t.generation != e.generation) continue;
+				if (t.deadlineMs > nowMs) {
+					// Later turn of the wheel
+					slot[keep++] = e;
+					continue;
+				}
+
+				if (t.periodMs) {
+					due.push_back(t.task);
+					t.deadlineMs = std::max(t.deadlineMs + t.periodMs, nowMs + 1);
+					// Re-inserted after the sweep so the slot being walked isn't grown
+					rearm.push_back(e.index);
+					continue;
+				}
+				due.push_back(std::move(t.task));
+				release(e.index);
+			}
+			slot.resize(keep);
+		}
+		lastTick_ = target + 1;
+
+		for (uint32_t index : rearm) {
+			insert(index);
+		}
+	}
+
+	for (Task& task : due) {
+		if (task) task();
+	}
+}
+
+void Scheduler::loop() {
+	while (running_) {
+		tick(nowMs());
+
+		std::unique_lock<std::mutex> lock(mtx_);
+		wake_.wait_for(lock, std::chrono::milliseconds(tickMs_), [this]() { return !running_; });
+	}
+}
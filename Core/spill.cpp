@@ -0,0 +1,73 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "spill.h"
+
+SpillIndex::SpillIndex() {
+	capacity_ = 0;
+	head_ = 0;
+	used_ = 0;
+	laps_ = 0;
+}
+
+void SpillIndex::reset(size_t capacity) {
+	slots_.clear();
+	capacity_ = capacity;
+	head_ = 0;
+	used_ = 0;
+	laps_ = 0;
+}
+
+bool SpillIndex::reserve(size_t size, size_t& offset, size_t& evicted) {
+	evicted = 0;
+	if (size > capacity_) return false;
+
+	size_t pos = head_;
+	if (pos + size > capacity_) {
+		pos = 0;
+		laps_++;
+		// Everything past the old head is a lap older than anything before it, and
+		// the tail is abandoned this lap, drop it even where the new slot doesn't reach
+		while (!slots_.empty() && slots_.front().offset >= head_) {
+			popFront();
+			evicted++;
+		}
+	}
+
+	// Now the oldest slots are the ones right after pos
+	while (!slots_.empty()) {
+		const Slot& old = slots_.front();
+		bool overlaps = old.offset < pos + size && pos < old.offset + old.size;
+		if (!overlaps) break;
+		popFront();
+		evicted++;
+	}
+
+	slots_.push_back({ pos, size });
+	used_ += size;
+	head_ = pos + size;
+	offset = pos;
+	return true;
+}
+
+void SpillIndex::popFront() {
+	if (slots_.empty()) return;
+	used_ -= slots_.front().size;
+	slots_.pop_front();
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "startup.h"
+
+#include <algorithm>
+
+Startup::Startup() {
+	remaining_ = 0;
+	ok_ = true;
+	started_ = false;
+	finished_ = false;
+}
+
+Startup::~Startup() {
+	wait();
+}
+
+void Startup::add(const std::string& name, const std::vector<std::string>& deps, Step step) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (started_) return;
+
+	Phase phase;
+	phase.name = name;
+	phase.depNames = deps;
+	phase.step = step;
+	phase.state = PENDING;
+	phase.startMs = 0.0;
+	phase.endMs = 0.0;
+	phases_.push_back(phase);
+}
+
+bool Startup::run(std::function<void(bool)> done) {
+	const std::lock_guard<std::mutex> lock(mtx_);
+	if (started_) return false;
+	if (!resolve()) return false;
+
+	started_ = true;
+	done_ = done;
+	remaining_ = phases_.size();
+	epoch_ = std::chrono::steady_clock::now();
+
+	if (remaining_ == 0) {
+		finished_ = true;
+		if (done_) done_(true);
+		return true;
+	}
+	launchReadyLocked();
+	return true;
+}
+
+void Startup::wait() {
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+		if (!started_) return;
+		finishedCv_.wait(lock, [this]() { return finished_; });
+	}
+	// Nothing launches once finished, the last step may still be inside done_
+	for (std::thread& t : threads_) {
+		if (t.joinable()) t.join();
+	}
+}
+
+void Startup::logReport() {
+	const std::lock_guard<std::mutex> lock(mtx_);
+
+	double total = 0.0;
+	double busy = 0.0;
+	for (const Phase& phase : phases_) {
+		double took = phase.endMs - phase.startMs;
+		if (phase.state == DONE || phase.state == FAILED) busy += took;
+		total = std::max(total, phase.endMs);
+		printf("CK::START %-10s at %7.1fms took %7.1fms %s\n",
+			phase.name.c_str(), phase.startMs, took, stateName(phase.state));
+	}
+	// Anything over 1.0x is time saved by overlapping steps
+	printf("CK::START total %.1fms, serial %.1fms (%.2fx)\n", total, busy, total > 0.0 ? busy / total : 1.0);
+}
+
+bool Startup::resolve() {
+	for (Phase& phase : phases_) {
+		phase.deps.clear();
+		for (const std::string& dep : phase.depNames) {
+			size_t idx = 0;
+			while (idx < phases_.size() && phases_[idx].name != dep) idx++;
+			if (idx == phases_.size()) {
+				printf("CK::START %s depends on unknown step %s\n", phase.name.c_str(), dep.c_str());
+				return false;
+			}
+			phase.deps.push_back(idx);
+		}
+	}
+
+	// Kahn's, anything left over sits on a cycle
+	std::vector<size_t> inDegree(phases_.size(), 0);
+	for (size_t i = 0; i < phases_.size(); i++) {
+		inDegree[i] = phases_[i].deps.size();
+	}
+	std::vector<size_t> ready;
+	for (size_t i = 0; i < phases_.size(); i++) {
+		if (inDegree[i] == 0) ready.push_back(i);
+	}
+	size_t visited = 0;
+	while (!ready.empty()) {
+		size_t idx = ready.back();
+		ready.pop_back();
+		visited++;
+		for (size_t i = 0; i < phases_.size(); i++) {
+			for (size_t dep : phases_[i].deps) {
+				if (dep == idx && --inDegree[i] == 0) ready.push_back(i);
+			}
+		}
+	}
+	if (visited != phases_.size()) {
+		printf("CK::START Dependency cycle in startup steps!\n");
+		return false;
+	}
+	return true;
+}
+
+void Startup::launchReadyLocked() {
+	// Skipping can unblock (skip) more steps, so loop until nothing changes
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = 0; i < phases_.size(); i++) {
+			Phase& phase = phases_[i];
+			if (phase.state != PENDING) continue;
+
+			bool ready = true;
+			bool blocked = false;
+			for (size_t dep : phase.deps) {
+				State s = phases_[dep].state;
+				if (s == FAILED || s == SKIPPED) blocked = true;
+				else if (s != DONE) ready = false;
+			}
+
+			if (blocked) {
+				phase.state = SKIPPED;
+				phase.startMs = phase.endMs = elapsedMs();
+				remaining_--;
+				changed = true;
+			}
+			else if (ready) {
+				phase.state = RUNNING;
+				phase.startMs = elapsedMs();
+				threads_.push_back(std::thread(&Startup::runPhase, this, i));
+			}
+		}
+	}
+}
+
+void Startup::runPhase(size_t idx) {
+	Step step;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		step = phases_[idx].step;
+	}
+
+	bool ok = step ? step() : true;
+
+	std::function<void(bool)> done;
+	bool allOk = false;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		Phase& phase = phases_[idx];
+		phase.endMs = elapsedMs();
+		phase.state = ok ? DONE : FAILED;
+		if (!ok) {
+			ok_ = false;
+			printf("CK::START %s failed!\n", phase.name.c_str());
+		}
+		remaining_--;
+		launchReadyLocked();
+
+		if (remaining_ > 0) return;
+		finished_ = true;
+		done = done_;
+		allOk = ok_;
+	}
+	finishedCv_.notify_all();
+	if (done) done(allOk);
+}
+
+const char* Startup::stateName(State state) {
+	switch (state) {
+	case DONE: return "ok";
+	case FAILED: return "FAILED";
+	case SKIPPED: return "skipped";
+	default: return "unfinished";
+	}
+}
+
+double Startup::elapsedMs() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch_).count();
+}
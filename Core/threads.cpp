@@ -0,0 +1,215 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "threads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<uint64_t> affinity[threads::ROLE_COUNT];
+static thread_local bool roleApplied = false;
+
+static const char* roleName(threads::Role role) {
+	switch (role) {
+	case threads::GRAPHICS: return "graphics";
+	case threads::ENCODE: return "encode";
+	case threads::INTERACTIVE: return "interactive";
+	case threads::BACKGROUND: return "background";
+	case threads::NORMAL:
+	default: return "normal";
+	}
+}
+
+void threads::setAffinity(Role role, uint64_t mask) {
+	if (role < 0 || role >= ROLE_COUNT) return;
+	affinity[role] = mask;
+}
+
+#ifdef _WIN32
+
+static void setName(const char* name) {
+	wchar_t wide[64];
+	if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wide, 64) > 0) {
+		SetThreadDescription(GetCurrentThread(), wide);
+	}
+}
+
+static bool setPriority(threads::Role role) {
+	HANDLE self = GetCurrentThread();
+	switch (role) {
+	case threads::GRAPHICS:
+	case threads::ENCODE:
+	case threads::INTERACTIVE:
+		return SetThreadPriority(self, THREAD_PRIORITY_ABOVE_NORMAL) != 0;
+	case threads::BACKGROUND:
+		// Lowers CPU, I/O and memory priority together, only valid on the calling thread
+		return SetThreadPriority(self, THREAD_MODE_BACKGROUND_BEGIN) != 0;
+	case threads::NORMAL:
+	default:
+		return SetThreadPriority(self, THREAD_PRIORITY_NORMAL) != 0;
+	}
+}
+
+static bool setAffinityMask(uint64_t mask) {
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+}
+
+#else
+
+static void setName(const char* name) {
+	char shortName[16]; // Linux keeps 15 characters
+	snprintf(shortName, sizeof(shortName), "%s", name);
+	pthread_setname_np(pthread_self(), shortName);
+}
+
+// From linux/ioprio.h, glibc has no wrapper
+static const int IOPRIO_WHO_PROCESS = 1;
+static const int IOPRIO_CLASS_BE = 2;
+static const int IOPRIO_CLASS_IDLE = 3;
+static const int IOPRIO_CLASS_SHIFT = 13;
+
+static bool setPriority(threads::Role role) {
+	// Per thread on Linux: nice & ioprio take a tid
+	pid_t tid = (pid_t)syscall(SYS_gettid);
+	int nice = 0;
+	int ioClass = IOPRIO_CLASS_BE;
+	int ioLevel = 4;
+	switch (role) {
+	case threads::GRAPHICS:
+	case threads::ENCODE:
+	case threads::INTERACTIVE:
+		nice = -5; // Needs CAP_SYS_NICE, falls back to the default without it
+		ioLevel = 2;
+		break;
+	case threads::BACKGROUND:
+		nice = 19;
+		ioClass = IOPRIO_CLASS_IDLE;
+		ioLevel = 0;
+		break;
+	case threads::NORMAL:
+	default:
+		break;
+	}
+	bool ok = setpriority(PRIO_PROCESS, (id_t)tid, nice) == 0;
+	ok = syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, (ioClass << IOPRIO_CLASS_SHIFT) | ioLevel) == 0 && ok;
+	return ok;
+}
+
+static bool setAffinityMask(uint64_t mask) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+		if (mask & (1ULL << cpu)) CPU_SET(cpu, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+void threads::apply(Role role, const char* name) {
+	if (name) setName(name);
+	roleApplied = true;
+
+	// Raising priority takes elevation (CAP_SYS_NICE on Linux), the first refusal is enough to know
+	static std::atomic<bool> warned(false);
+	if (!setPriority(role) && !warned.exchange(true)) {
+		printf("CK::THREADS Unable to set %s priority for %s, running at default\n", roleName(role), name ? name : "thread");
+	}
+	uint64_t mask = affinity[role];
+	if (mask && !setAffinityMask(mask)) {
+		printf("CK::THREADS Unable to pin %s to 0x%llx\n", name ? name : "thread", (unsigned long long)mask);
+	}
+}
+
+bool threads::hasRole() {
+	return roleApplied;
+}
+
+/////////////////////////////////////////////////////
+// BENCHMARK
+/////////////////////////////////////////////////////
+
+// Iterations of a dependent integer loop, cheap enough that only CPU time matters
+static uint64_t spin(const std::atomic<bool>& stop) {
+	uint64_t iterations = 0;
+	uint64_t x = 88172645463325252ULL;
+	while (!stop.load(std::memory_order_relaxed)) {
+		for (int i = 0; i < 4096; i++) {
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+		}
+		iterations++;
+	}
+	return iterations + (x & 1); // Keeps the loop from being optimized out
+}
+
+// Foreground iterations per second with `background` extra busy threads alongside
+static double foregroundRate(int seconds, int foreground, int background, bool policy) {
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> total(0);
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < background; i++) {
+		workers.emplace_back([&stop, policy]() {
+			if (policy) threads::apply(threads::BACKGROUND, "ck-bench-bg");
+			spin(stop);
+		});
+	}
+	for (int i = 0; i < foreground; i++) {
+		workers.emplace_back([&stop, &total]() { total += spin(stop); });
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	stop = true;
+	for (std::thread& t : workers) {
+		t.join();
+	}
+	return (double)total / seconds;
+}
+
+void threads::benchmark(int seconds) {
+	// The game takes every core, the background work one per core on top
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+
+	double alone = foregroundRate(seconds, cores, 0, false);
+	double contended = foregroundRate(seconds, cores, cores, false);
+	double managed = foregroundRate(seconds, cores, cores, true);
+
+	printf("CK::THREADS [BENCH] %d foreground threads, %d background threads, %ds each\n", cores, cores, seconds);
+	printf("CK::THREADS [BENCH] foreground alone: %.0f it/s\n", alone);
+	printf("CK::THREADS [BENCH] with default priority background: %.0f it/s (%.1f%% of alone)\n",
+		contended, alone > 0 ? contended / alone * 100.0 : 0.0);
+	printf("CK::THREADS [BENCH] with background policy: %.0f it/s (%.1f%% of alone)\n",
+		managed, alone > 0 ? managed / alone * 100.0 : 0.0);
+}
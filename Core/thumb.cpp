@@ -0,0 +1,366 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "thumb.h"
+
+#include <Windows.h>
+#include "gdiplus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <emmintrin.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+static const int POSTER_WIDTH = 640;
+static const int TILE_WIDTH = 160;
+static const int SPRITE_COLUMNS = 4;
+static const int SPRITE_TILES = 16;
+static const ULONG JPEG_QUALITY = 80;
+
+namespace {
+
+struct Plane {
+	std::vector<uint8_t> data;
+	int width = 0;
+	int height = 0;
+};
+
+struct Image {
+	std::vector<uint8_t> bgra;
+	int width = 0;
+	int height = 0;
+};
+
+// 2x2 box average of two source rows into one destination row
+void halveRow(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int dstWidth) {
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+	int x = 0;
+	for (; x + 16 <= dstWidth; x += 16) {
+		const uint8_t* s0 = row0 + x * 2;
+		const uint8_t* s1 = row1 + x * 2;
+		__m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)s0), _mm_loadu_si128((const __m128i*)s1));
+		__m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(s0 + 16)), _mm_loadu_si128((const __m128i*)(s1 + 16)));
+		// Average horizontal neighbours: even bytes vs odd bytes as 16 bit lanes
+		a = _mm_avg_epu16(_mm_and_si128(a, lowMask), _mm_srli_epi16(a, 8));
+		b = _mm_avg_epu16(_mm_and_si128(b, lowMask), _mm_srli_epi16(b, 8));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(a, b));
+	}
+	for (; x < dstWidth; x++) {
+		dst[x] = (uint8_t)((row0[x * 2] + row0[x * 2 + 1] + row1[x * 2] + row1[x * 2 + 1] + 2) >> 2);
+	}
+}
+
+// Halves with SIMD while it can, then a bilinear pass lands on the exact size
+Plane scalePlane(const uint8_t* src, int stride, int width, int height, int dstWidth, int dstHeight) {
+	Plane tmp;
+	const uint8_t* cur = src;
+	int curStride = stride;
+
+	while (width / 2 >= dstWidth && height / 2 >= dstHeight) {
+		Plane half;
+		half.width = width / 2;
+		half.height = height / 2;
+		half.data.resize((size_t)half.width * half.height);
+		for (int y = 0; y < half.height; y++) {
+			halveRow(cur + (size_t)(y * 2) * curStride, cur + (size_t)(y * 2 + 1) * curStride,
+				&half.data[(size_t)y * half.width], half.width);
+		}
+		tmp = std::move(half);
+		cur = tmp.data.data();
+		curStride = tmp.width;
+		width = tmp.width;
+		height = tmp.height;
+	}
+
+	Plane out;
+	out.width = dstWidth;
+	out.height = dstHeight;
+	out.data.resize((size_t)dstWidth * dstHeight);
+
+	std::vector<int> x0(dstWidth), x1(dstWidth);
+	std::vector<int> wx(dstWidth);
+	for (int x = 0; x < dstWidth; x++) {
+		float fx = std::max(0.0f, (x + 0.5f) * width / dstWidth - 0.5f);
+		x0[x] = std::min((int)fx, width - 1);
+		x1[x] = std::min(x0[x] + 1, width - 1);
+		wx[x] = (int)((fx - x0[x]) * 256);
+	}
+	for (int y = 0; y < dstHeight; y++) {
+		float fy = std::max(0.0f, (y + 0.5f) * height / dstHeight - 0.5f);
+		int y0 = std::min((int)fy, height - 1);
+		int y1 = std::min(y0 + 1, height - 1);
+		int wy = (int)((fy - y0) * 256);
+		const uint8_t* r0 = cur + (size_t)y0 * curStride;
+		const uint8_t* r1 = cur + (size_t)y1 * curStride;
+		uint8_t* dst = &out.data[(size_t)y * dstWidth];
+		for (int x = 0; x < dstWidth; x++) {
+			int top = r0[x0[x]] * (256 - wx[x]) + r0[x1[x]] * wx[x];
+			int bottom = r1[x0[x]] * (256 - wx[x]) + r1[x1[x]] * wx[x];
+			dst[x] = (uint8_t)((top * (256 - wy) + bottom * wy + (1 << 15)) >> 16);
+		}
+	}
+	return out;
+}
+
+uint8_t clampByte(float v) {
+	return (uint8_t)std::min(255.0f, std::max(0.0f, v + 0.5f));
+}
+
+// Scales a decoded 4:2:0 frame straight to BGRA at the requested size
+bool frameToImage(const AVFrame* frame, int width, int height, Image& img) {
+	if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P) {
+		return false;
+	}
+
+	int chromaWidth = (frame->width + 1) / 2;
+	int chromaHeight = (frame->height + 1) / 2;
+	Plane y = scalePlane(frame->data[0], frame->linesize[0], frame->width, frame->height, width, height);
+	Plane u = scalePlane(frame->data[1], frame->linesize[1], chromaWidth, chromaHeight, width, height);
+	Plane v = scalePlane(frame->data[2], frame->linesize[2], chromaWidth, chromaHeight, width, height);
+
+	// OBS tags its output, anything untagged is treated as 709
+	bool bt601 = frame->colorspace == AVCOL_SPC_BT470BG || frame->colorspace == AVCOL_SPC_SMPTE170M;
+	bool fullRange = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+	float kr = bt601 ? 0.299f : 0.2126f;
+	float kb = bt601 ? 0.114f : 0.0722f;
+	float kg = 1.0f - kr - kb;
+	float yScale = fullRange ? 1.0f : 255.0f / 219.0f;
+	float cScale = fullRange ? 1.0f : 255.0f / 224.0f;
+	float yOffset = fullRange ? 0.0f : 16.0f;
+	float rv = 2.0f * (1.0f - kr) * cScale;
+	float gu = 2.0f * kb * (1.0f - kb) / kg * cScale;
+	float gv = 2.0f * kr * (1.0f - kr) / kg * cScale;
+	float bu = 2.0f * (1.0f - kb) * cScale;
+
+	img.width = width;
+	img.height = height;
+	img.bgra.resize((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+		float luma = (y.data[i] - yOffset) * yScale;
+		float cb = u.data[i] - 128.0f;
+		float cr = v.data[i] - 128.0f;
+		img.bgra[i * 4 + 0] = clampByte(luma + bu * cb);
+		img.bgra[i * 4 + 1] = clampByte(luma - gu * cb - gv * cr);
+		img.bgra[i * 4 + 2] = clampByte(luma + rv * cr);
+		img.bgra[i * 4 + 3] = 255;
+	}
+	return true;
+}
+
+void blitTile(const Image& tile, Image& sprite, int index) {
+	int ox = (index % SPRITE_COLUMNS) * tile.width;
+	int oy = (index / SPRITE_COLUMNS) * tile.height;
+	for (int y = 0; y < tile.height; y++) {
+		memcpy(&sprite.bgra[((size_t)(oy + y) * sprite.width + ox) * 4],
+			&tile.bgra[(size_t)y * tile.width * 4], (size_t)tile.width * 4);
+	}
+}
+
+bool saveJpeg(const Image& img, const std::string& path) {
+	CLSID clsid_jpg;
+	if (CLSIDFromString(L"{557cf401-1a04-11d3-9a73-0000f81ef32e}", &clsid_jpg) != 0)
+		return false;
+
+	ULONG quality = JPEG_QUALITY;
+	Gdiplus::EncoderParameters params;
+	params.Count = 1;
+	params.Parameter[0].Guid = Gdiplus::EncoderQuality;
+	params.Parameter[0].Type = Gdiplus::EncoderParameterValueTypeLong;
+	params.Parameter[0].NumberOfValues = 1;
+	params.Parameter[0].Value = &quality;
+
+	std::wstring widePath(MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, nullptr, 0), L'\0');
+	MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, &widePath[0], (int)widePath.size());
+
+	Gdiplus::Bitmap bmp(img.width, img.height, img.width * 4, PixelFormat32bppRGB, (BYTE*)img.bgra.data());
+	return bmp.Save(widePath.c_str(), &clsid_jpg, &params) == Gdiplus::Ok;
+}
+
+int evenSize(int v) {
+	return std::max(2, v & ~1);
+}
+
+// Deletes whatever was written unless the caller keeps it, a half written pair is never left behind
+struct OutputGuard {
+	std::vector<std::string> paths;
+	bool keep = false;
+	~OutputGuard() {
+		if (keep) return;
+		for (const std::string& p : paths) DeleteFileA(p.c_str());
+	}
+};
+
+}
+
+bool thumb::generate(const std::string& videoPath, Result& result) {
+	auto begin = std::chrono::steady_clock::now();
+	result = Result();
+
+	AVFormatContext* in = nullptr;
+	if (avformat_open_input(&in, videoPath.c_str(), nullptr, nullptr) < 0) {
+		printf("CK::THUMB Unable to open %s\n", videoPath.c_str());
+		return false;
+	}
+	if (avformat_find_stream_info(in, nullptr) < 0) {
+		avformat_close_input(&in);
+		return false;
+	}
+	int idx = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (idx < 0) {
+		printf("CK::THUMB No video stream in %s\n", videoPath.c_str());
+		avformat_close_input(&in);
+		return false;
+	}
+	AVStream* st = in->streams[idx];
+
+	const AVCodec* codec = avcodec_find_decoder(st->codecpar->codec_id);
+	AVCodecContext* dec = codec ? avcodec_alloc_context3(codec) : nullptr;
+	if (!dec || avcodec_parameters_to_context(dec, st->codecpar) < 0) {
+		printf("CK::THUMB No decoder for %s\n", videoPath.c_str());
+		avcodec_free_context(&dec);
+		avformat_close_input(&in);
+		return false;
+	}
+	// Inter frames are never sent, and the decoder is told to drop any that slip through
+	dec->skip_frame = AVDISCARD_NONKEY;
+	dec->thread_type = FF_THREAD_SLICE;
+	dec->thread_count = 0;
+	if (avcodec_open2(dec, codec, nullptr) < 0) {
+		avcodec_free_context(&dec);
+		avformat_close_input(&in);
+		return false;
+	}
+
+	int srcWidth = st->codecpar->width;
+	int srcHeight = st->codecpar->height;
+	int posterWidth = evenSize(std::min(POSTER_WIDTH, srcWidth));
+	int posterHeight = evenSize((int)((int64_t)posterWidth * srcHeight / std::max(1, srcWidth)));
+	int tileHeight = evenSize((int)((int64_t)TILE_WIDTH * srcHeight / std::max(1, srcWidth)));
+
+	Image poster, tile, sprite;
+	sprite.width = TILE_WIDTH * SPRITE_COLUMNS;
+	sprite.height = tileHeight * ((SPRITE_TILES + SPRITE_COLUMNS - 1) / SPRITE_COLUMNS);
+	sprite.bgra.assign((size_t)sprite.width * sprite.height * 4, 0);
+
+	// Tiles are spread evenly over the clip, the poster comes from the middle
+	int64_t startPts = st->start_time != AV_NOPTS_VALUE ? st->start_time : 0;
+	int64_t durationUsec = in->duration > 0 ? in->duration : 0;
+	int64_t interval = std::max<int64_t>(1, durationUsec / SPRITE_TILES);
+	int64_t posterUsec = durationUsec / 2;
+	int64_t nextSampleUsec = 0;
+	bool posterQueued = false;
+	bool posterTaken = false;
+	int tiles = 0;
+	bool unsupported = false;
+
+	auto toUsec = [&](int64_t ts) {
+		return ts == AV_NOPTS_VALUE ? 0 : av_rescale_q(ts - startPts, st->time_base, AV_TIME_BASE_Q);
+	};
+
+	AVFrame* frame = av_frame_alloc();
+	auto drain = [&]() {
+		while (avcodec_receive_frame(dec, frame) == 0) {
+			int64_t t = toUsec(frame->best_effort_timestamp);
+			result.keyframes++;
+
+			if (tiles < SPRITE_TILES && frameToImage(frame, TILE_WIDTH, tileHeight, tile)) {
+				blitTile(tile, sprite, tiles++);
+			}
+			// First frame stands in until the middle one shows up
+			if (!posterTaken && (poster.bgra.empty() || t >= posterUsec)) {
+				if (!frameToImage(frame, posterWidth, posterHeight, poster)) {
+					unsupported = true;
+				}
+				posterTaken = t >= posterUsec;
+			}
+			av_frame_unref(frame);
+		}
+	};
+
+	AVPacket* pkt = av_packet_alloc();
+	while (!unsupported && av_read_frame(in, pkt) >= 0) {
+		if (pkt->stream_index != idx || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+			av_packet_unref(pkt);
+			continue;
+		}
+
+		int64_t t = toUsec(pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts);
+		bool wantTile = t >= nextSampleUsec;
+		bool wantPoster = !posterQueued && t >= posterUsec;
+		if (!wantTile && !wantPoster) {
+			av_packet_unref(pkt);
+			continue;
+		}
+		while (nextSampleUsec <= t) nextSampleUsec += interval;
+		posterQueued = posterQueued || wantPoster;
+
+		if (avcodec_send_packet(dec, pkt) == 0) {
+			drain();
+		}
+		av_packet_unref(pkt);
+	}
+	avcodec_send_packet(dec, nullptr);
+	drain();
+
+	av_packet_free(&pkt);
+	av_frame_free(&frame);
+	avcodec_free_context(&dec);
+	avformat_close_input(&in);
+
+	if (unsupported || poster.bgra.empty()) {
+		printf("CK::THUMB No usable keyframe in %s\n", videoPath.c_str());
+		return false;
+	}
+
+	// Drop unused sprite rows
+	sprite.height = tileHeight * ((tiles + SPRITE_COLUMNS - 1) / SPRITE_COLUMNS);
+	sprite.bgra.resize((size_t)sprite.width * sprite.height * 4);
+
+	std::string base = videoPath.substr(0, videoPath.find_last_of('.'));
+	result.posterPath = base + "_poster.jpg";
+	result.spritePath = base + "_sprite.jpg";
+
+	OutputGuard written;
+	written.paths = { result.posterPath, result.spritePath };
+
+	ULONG_PTR gdiToken;
+	Gdiplus::GdiplusStartupInput gdiInput;
+	Gdiplus::GdiplusStartup(&gdiToken, &gdiInput, NULL);
+	bool ok = saveJpeg(poster, result.posterPath) && saveJpeg(sprite, result.spritePath);
+	Gdiplus::GdiplusShutdown(gdiToken);
+
+	result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	if (!ok) {
+		printf("CK::THUMB Failed to write thumbnails for %s\n", videoPath.c_str());
+		result.posterPath.clear();
+		result.spritePath.clear();
+		return false;
+	}
+	written.keep = true;
+	printf("CK::THUMB %s: %dx%d, %d keyframes decoded, %d tiles in %.1fms\n", videoPath.c_str(),
+		srcWidth, srcHeight, result.keyframes, tiles, result.ms);
+	return true;
+}
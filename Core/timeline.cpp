@@ -0,0 +1,60 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "timeline.h"
+
+#include <algorithm>
+
+ClipTimeline::ClipTimeline(const std::vector<std::pair<int, int>>& timeBases) {
+	timeBases_ = timeBases;
+	lastDts_.assign(timeBases.size(), INT64_MIN);
+	offsetUsec_ = 0;
+	endUsec_ = 0;
+}
+
+// Rounded to the nearest, usec is finer than any stream tick so ticks survive the round trip
+int64_t ClipTimeline::toUsec(int stream, int64_t ticks) {
+	int64_t num = (int64_t)timeBases_[stream].first * 1000000;
+	int64_t den = timeBases_[stream].second;
+	int64_t scaled = ticks * num;
+	return (scaled >= 0 ? scaled + den / 2 : scaled - den / 2) / den;
+}
+
+int64_t ClipTimeline::toTicks(int stream, int64_t usec) {
+	int64_t num = timeBases_[stream].second;
+	int64_t den = (int64_t)timeBases_[stream].first * 1000000;
+	int64_t scaled = usec * num;
+	return (scaled >= 0 ? scaled + den / 2 : scaled - den / 2) / den;
+}
+
+void ClipTimeline::beginClip(int64_t firstDtsUsec) {
+	offsetUsec_ = endUsec_ - firstDtsUsec;
+}
+
+void ClipTimeline::place(int stream, int64_t& dts, int64_t& pts, int64_t duration) {
+	int64_t offset = toTicks(stream, offsetUsec_);
+	dts += offset;
+	pts += offset;
+	if (lastDts_[stream] != INT64_MIN && dts <= lastDts_[stream]) {
+		dts = lastDts_[stream] + 1;
+	}
+	pts = std::max(pts, dts);
+	lastDts_[stream] = dts;
+	endUsec_ = std::max(endUsec_, toUsec(stream, pts + std::max<int64_t>(duration, 0)));
+}
@@ -1,734 +1,2075 @@
-/******************************************************************************
-	CONKORS COMPANION
-	www.conkors.com
-	Copyright (C) Conkors LLC
-
-	This program is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 2 of the License, or
-	(at your option) any later version.
-
-	This program is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-******************************************************************************/
-
-#define NOMINMAX // WINDOWS SUX???
-
-#include "vid.h"
-#include "webapi.h"
-#include <chrono>
-#include <thread>
-#include <algorithm>
-
-static void log_props(obs_source_t* src) {
-	if (!src) return;
-	obs_properties_t* props = obs_source_properties(src);
-	if (!props) return;
-
-	blog(LOG_INFO, "\n\n====== Properties For [%s] ======", obs_source_get_name(src));
-	obs_property_t* item = obs_properties_first(props);
-	while (item) {
-		if (obs_property_get_type(item) == OBS_PROPERTY_LIST) {
-			blog(LOG_INFO, "List - [Name: %s][Type: %d][Format: %d]:", obs_property_name(item), obs_property_list_type(item), obs_property_list_format(item));
-			for (int i = 0; i < obs_property_list_item_count(item); i++) {
-				blog(LOG_INFO, "\tName: %s", obs_property_list_item_name(item, i));
-			}
-		}
-		else {
-			blog(LOG_INFO, "Name: %s | Type: %d", obs_property_name(item), obs_property_get_type(item));
-		}
-		obs_property_next(&item);
-	}
-	blog(LOG_INFO, "====================================\n\n");
-}
-
-static void SIGSaved(void* data, calldata_t* params) {
-	VidCore* core = (VidCore*)data;
-	std::string filePath = core->getLastReplay();
-	printf("CK::VID NEW REPLAY SAVED!: %s\n", filePath.c_str());
-	core->uploadVideo(filePath);
-}
-
-static void SIGSavedLive(void* data, calldata_t* params) {
-	VidCore* core = (VidCore*)data;
-	std::string filePath = core->getLastLive();
-	printf("CK::VID NEW VIDEO SAVED!: %s\n", filePath.c_str());
-	core->uploadVideo(filePath);
-}
-
-VidCore::VidCore() {
-	isReplayBufferActive_ = false;
-	isLiveActive_ = false;
-	captureWindowMode_ = false;
-
-	lastRecordingLive_ = "";
-}
-
-VidCore::~VidCore() {}
-
-bool VidCore::resetAudio() {
-	struct obs_audio_info2 ai = {};
-	ai.samples_per_sec = 48000;
-	ai.speakers = SPEAKERS_STEREO;
-	if (!obs_reset_audio2(&ai)) {
-		printf("CK::VID Failed to reset audio!!!\n");
-		return false;
-	}
-	obs_set_audio_monitoring_device("Default", "default");
-	return true;
-}
-
-bool VidCore::resetVideo(int width, int height) {
-	// Cap Dimensions - Maintain Aspect Ratio
-	int newWidth = width;
-	int newHeight = height;
-	if (width > 1280 || height > 720) {
-		double aspectRatio = static_cast<double>(width) / height;
-		newWidth = std::min(width, 1280);
-		newHeight = static_cast<int>(newWidth / aspectRatio);
-		if (newHeight > 720) {
-			newHeight = 720;
-			newWidth = static_cast<int>(newHeight * aspectRatio);
-		}
-	}
-	
-	ovi_.graphics_module = "libobs-d3d11.dll";
-	ovi_.fps_num = 60;
-	ovi_.fps_den = 1;
-	ovi_.base_width = width;
-	ovi_.base_height = height;
-	ovi_.output_width = newWidth;
-	ovi_.output_height = newHeight;
-	ovi_.output_format = VIDEO_FORMAT_NV12;
-	ovi_.colorspace = VIDEO_CS_709;
-	ovi_.range = VIDEO_RANGE_PARTIAL;
-	ovi_.gpu_conversion = true;
-	ovi_.scale_type = OBS_SCALE_LANCZOS;
-	int ret = obs_reset_video(&ovi_);
-
-	if (ret != OBS_VIDEO_SUCCESS) {
-		printf("CK::VID Failed to reset video!!!\n");
-		return false;
-	}
-	obs_set_video_levels(300.000000, 1000.00000);
-	return true;
-}
-
-VidCore::AdapterType VidCore::getAdapterType(int idx) {
-	// Essentially guessing the vendor based on keywords in name
-	std::string nvidiaKeys[] = { "nvidia", "geforce", "gtx", "rtx" };
-	std::string amdKeys[] = { "amd", "radeon", "rx", "ati" };
-	std::string intelKeys[] = { "intel", "arc" };
-
-	std::string name = availableAdapters_[idx];
-	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-
-	for (const std::string& keyword : nvidiaKeys) {
-		if (name.find(keyword) != std::string::npos) {
-			return NVIDIA;
-		}
-	}
-	for (const std::string& keyword : amdKeys) {
-		if (name.find(keyword) != std::string::npos) {
-			return AMD;
-		}
-	}
-	for (const std::string& keyword : intelKeys) {
-		if (name.find(keyword) != std::string::npos) {
-			return INTEL;
-		}
-	}
-
-	printf("CK::VID Unable to determine type!\n");
-	return UNKNOWN;
-}
-
-void VidCore::detectVideoEncoder() {
-	bool jimNvenc = false;
-	bool ffmpegNvenc = false;
-	bool amf = false;
-	bool qsv = false;
-
-	// Enumerate available encoders
-	size_t idx = 0;
-	const char* id;
-	while (obs_enum_encoder_types(idx++, &id)) {
-		printf("CK::VID [ENUM_ENCODERS] - %s\n", id);
-		if (strcmp(id, "ffmpeg_nvenc") == 0) {
-			ffmpegNvenc = true;
-		} else if (strcmp(id, "jim_nvenc") == 0) {
-			jimNvenc = true;
-		} else if (strcmp(id, "obs_qsv11_v2") == 0) {
-			qsv = true;
-		} else if (strcmp(id, "h264_texture_amf") == 0) {
-			amf = true;
-		}
-	}
-
-	// Identify Adapter Type & Set Encoder Accordingly
-	AdapterType at = getAdapterType(ovi_.adapter);
-	std::string selectedEncoder;
-	switch (at) {
-	case NVIDIA:
-		if (jimNvenc) {
-			selectedEncoder = "jim_nvenc";
-		}
-		else if (ffmpegNvenc) {
-			selectedEncoder = "ffmpeg_nvenc";
-		}
-		break;
-	case AMD:
-		if (amf) {
-			selectedEncoder = "h264_texture_amf";
-		}
-		break;
-	case INTEL:
-		if (qsv) {
-			selectedEncoder = "obs_qsv11_v2";
-		}
-		break;
-	default:
-		selectedEncoder = "obs_x264";
-	}
-
-	if (selectedEncoder.empty()) {
-		encoderString_ = "obs_x264";
-		printf("CK::VID Encoder fallback to software\n");
-	}
-	else {
-		encoderString_ = selectedEncoder;
-	}
-
-	printf("CK::VID [ENCODER] chose %s with card type %d\n", encoderString_.c_str(), at);
-}
-
-bool VidCore::loadOBS() {
-	if (!obs_startup("en-US", nullptr, nullptr)) {
-		printf("CK::VID OBS STARTUP FAILED!\n");
-		return false;
-	}
-
-	resetAudio();
-
-	// Effects Files
-	CHAR szFileName[MAX_PATH];
-	GetModuleFileNameA(NULL, szFileName, MAX_PATH);
-	std::string path = std::string(szFileName);
-	std::replace(path.begin(), path.end(), '\\', '/');
-	std::size_t lastSlashIndex = path.find_last_of('/');
-	if (lastSlashIndex != std::string::npos) {
-		path.erase(lastSlashIndex + 1);
-	}
-	path += "effects/";
-	obs_add_data_path(path.c_str());
-
-	int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-	int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-	ovi_.adapter = 0; // Default to first graphics card
-	resetVideo(screenWidth, screenHeight);
-
-	// Load Modules
-	obs_module_t* loaded;
-	if (obs_open_module(&loaded, "obs-ffmpeg", nullptr) == MODULE_SUCCESS) {
-		obs_init_module(loaded);
-	}
-	if (obs_open_module(&loaded, "obs-x264", nullptr) == MODULE_SUCCESS) {
-		obs_init_module(loaded);
-	}
-	if (obs_open_module(&loaded, "obs-qsv11", nullptr) == MODULE_SUCCESS) {
-		obs_init_module(loaded);
-	}
-	if (obs_open_module(&loaded, "win-capture", nullptr) == MODULE_SUCCESS) {
-		obs_init_module(loaded);
-	}
-	if (obs_open_module(&loaded, "win-wasapi", nullptr) == MODULE_SUCCESS) {
-		obs_init_module(loaded);
-	}
-
-	detectVideoEncoder();
-
-	return true;
-}
-
-void VidCore::configureBuffer() {
-	OBSDataAutoRelease settings = obs_data_create();
-
-	std::string videoDir = acm_->getVideoDir();
-	obs_data_set_string(settings, "directory", videoDir.c_str());
-	obs_data_set_string(settings, "format", "CKREPLAY_%CCYY-%MM-%DD_%hh-%mm-%ss");
-	obs_data_set_string(settings, "extension", "mp4");
-	obs_data_set_bool(settings, "allow_spaces", false);
-	obs_data_set_int(settings, "max_time_sec", 30);
-	obs_data_set_int(settings, "max_size_mb", 512);
-
-	obs_output_update(replayBuffer_, settings);
-}
-
-void VidCore::configureLive() {
-	OBSDataAutoRelease settings = obs_data_create();
-
-	std::string dir = acm_->getVideoDir();
-	std::string timestamp = webapi::getTimestamp();
-	std::string extension = ".mp4";
-
-	lastRecordingLive_ = dir + "CKVID_" + timestamp + extension;
-
-	obs_data_set_string(settings, "path", lastRecordingLive_.c_str());
-	obs_output_update(fileOutput_, settings);
-}
-
-void VidCore::addSources() {
-	for (int i = 0; i < MAX_CHANNELS; i++)
-		obs_set_output_source(i, nullptr);
-
-	// Display Capture
-	if (captureWindowMode_) {
-		captureWindow();
-	} else {
-		captureMonitor();
-	}
-
-	// Audio Out
-	sourceAud_ = obs_source_create("wasapi_output_capture", "Desktop Audio", NULL, nullptr);
-	obs_set_output_source(3, sourceAud_);
-
-	// Audio In
-	sourceMic_ = obs_source_create("wasapi_input_capture", "Mic/Aux", NULL, nullptr);
-	obs_set_output_source(4, sourceMic_);
-
-#ifdef _DEBUG
-	log_props(disp_);
-	log_props(sourceAud_);
-	log_props(sourceMic_);
-#endif
-}
-
-void VidCore::addOutputs() {
-	// Replay Buffer
-	replayBuffer_ = obs_output_create("replay_buffer",
-		"Replay Buffer",
-		nullptr, nullptr);
-	signal_handler_t* rbSignal =
-		obs_output_get_signal_handler(replayBuffer_);
-
-	replayBufferSaved_.Connect(rbSignal, "saved",
-		SIGSaved, (void*)this);
-
-	// File Output (ffmpeg_muxer)
-	fileOutput_ = obs_output_create(
-		"ffmpeg_muxer", "simple_file_output", nullptr, nullptr);
-	if (!fileOutput_)
-		throw "Failed to create recording output (simple output)";
-
-	signal_handler_t* liveSignal =
-		obs_output_get_signal_handler(fileOutput_);
-
-	liveVideoSaved_.Connect(liveSignal, "stop",
-		SIGSavedLive, (void*)this);
-}
-
-void VidCore::startEncoders() {
-	videoRecording_ = obs_video_encoder_create(
-		encoderString_.c_str(), "simple_video_recording", nullptr, nullptr);
-	if (!videoRecording_) {
-		printf("CK::FATAL: Failed to create video encoder!!!\n");
-	}
-	aacRecording_ = obs_audio_encoder_create("ffmpeg_aac", "simple_aac_recording", nullptr, 0, nullptr);
-	if (!aacRecording_) {
-		printf("CK::FATAL: Failed to create audio encoder!!!\n");
-	}
-
-	// Video Encoder Settings
-	OBSDataAutoRelease vsettings = obs_data_create();
-	obs_data_set_string(vsettings, "rate_control", "CBR");
-	obs_data_set_string(vsettings, "profile", "high");
-	obs_data_set_int(vsettings, "bitrate", 3000);
-	obs_encoder_update(videoRecording_, vsettings);
-
-	// Audio Encorder Settings
-	OBSDataAutoRelease asettings = obs_data_create();
-	obs_data_set_int(asettings, "bitrate", 128);
-	obs_data_set_string(asettings, "rate_control", "CBR");
-	obs_encoder_update(aacRecording_, asettings);
-
-	// Attach Encoders
-	obs_encoder_set_video(videoRecording_, obs_get_video());
-	obs_encoder_set_audio(aacRecording_, obs_get_audio());
-
-	obs_output_set_video_encoder(fileOutput_, videoRecording_);
-	obs_output_set_audio_encoder(fileOutput_, aacRecording_, 0);
-
-	obs_output_set_video_encoder(replayBuffer_, videoRecording_);
-	obs_output_set_audio_encoder(replayBuffer_, aacRecording_, 0);
-}
-
-/////////////////////////////////////////////////////
-/////////////////////////////////////////////////////
-
-bool VidCore::init(std::shared_ptr<AccountManager> acm, const std::vector<std::string>& adapters) {
-	if (!acm) {
-		return false;
-	}
-	acm_ = acm;
-	availableAdapters_ = adapters;
-
-	if (!loadOBS()) {
-		return false;
-	}
-	addSources();
-	addOutputs();
-	startEncoders();
-	return true;
-}
-
-bool VidCore::overrideAdapter(int idx) {
-	if (idx == ovi_.adapter) return false;
-
-	// Stop outputs
-	stopReplay();
-	saveLive();
-	// Release outputs
-	replayBuffer_ = nullptr;
-	fileOutput_ = nullptr;
-	// Release sources
-	disp_ = nullptr;
-	sourceMic_ = nullptr;
-	sourceAud_ = nullptr;
-
-	ovi_.adapter = idx;
-
-	// Reset video
-	int ret = obs_reset_video(&ovi_);
-	if (ret != OBS_VIDEO_SUCCESS) {
-		printf("CK::VID Failed to override graphics card!!!\n");
-	}
-	
-	// Re-add sources
-	addSources();
-	// Re-add outputs
-	addOutputs();
-	// Restart encoders
-	startEncoders();
-	
-	// Restart replay buffer
-	recordReplay();
-
-	return ret == OBS_VIDEO_SUCCESS;
-}
-
-void VidCore::forceSoftwareEncoder() {
-	// Stop the outputs
-	stopReplay();
-	saveLive();
-	// Release the outputs
-	replayBuffer_ = nullptr;
-	fileOutput_ = nullptr;
-	// Release sources
-	disp_ = nullptr;
-	sourceMic_ = nullptr;
-	sourceAud_ = nullptr;
-
-	// Force
-	encoderString_ = "obs_x264";
-
-	// Re-add sources
-	addSources();
-	// Re-add outputs
-	addOutputs();
-	// Restart encoders
-	startEncoders();
-	
-	// Restart replay buffer
-	recordReplay();
-}
-
-propListInt VidCore::getAdapters() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	propListInt list;
-	int i = 0;
-	for (auto& name : availableAdapters_) {
-		list.push_back(std::make_pair(name, i++));
-	}
-	return list;
-}
-
-propListStr VidCore::getDisplayOpts() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	propListStr list;
-
-	const char* name = obs_source_get_name(disp_);
-	int isDisplayCapture = std::strcmp(name, "Display Capture") == 0;
-
-	obs_properties_t* props = obs_source_properties(disp_);
-	obs_property_t* monitors = obs_properties_get(props, isDisplayCapture ? "monitor_id" : "window");
-	for (int i = 0; i < obs_property_list_item_count(monitors); i++) {
-		std::string name = std::string(obs_property_list_item_name(monitors, i));
-		std::string handle = std::string(obs_property_list_item_string(monitors, i));
-		list.push_back(std::make_pair(name, handle));
-	}
-	return list;
-}
-
-propListStr VidCore::getSpeakerOpts() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	propListStr list;
-
-	obs_properties_t* props = obs_source_properties(sourceAud_);
-	obs_property_t* speakers = obs_properties_get(props, "device_id");
-	for (int i = 0; i < obs_property_list_item_count(speakers); i++) {
-		std::string name = std::string(obs_property_list_item_name(speakers, i));
-		std::string handle = std::string(obs_property_list_item_string(speakers, i));
-		list.push_back(std::make_pair(name, handle));
-	}
-	return list;
-}
-
-propListStr VidCore::getMicOpts() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	propListStr list;
-
-	obs_properties_t* props = obs_source_properties(sourceMic_);
-	obs_property_t* mics = obs_properties_get(props, "device_id");
-	for (int i = 0; i < obs_property_list_item_count(mics); i++) {
-		std::string name = std::string(obs_property_list_item_name(mics, i));
-		std::string handle = std::string(obs_property_list_item_string(mics, i));
-		list.push_back(std::make_pair(name, handle));
-	}
-	return list;
-}
-
-void VidCore::updateDisplay(const char* id) {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	const char* name = obs_source_get_name(disp_);
-	int isDisplayCapture = std::strcmp(name, "Display Capture") == 0;
-
-	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
-	obs_data_set_string(settings, isDisplayCapture ? "monitor_id" : "window", id);
-	obs_source_update(disp_, settings);
-
-	// FIXME: WAIT FOR DIMENSIONS TO PROPOGATE?
-	std::this_thread::sleep_for(std::chrono::seconds(2));
-
-	int width = obs_source_get_width(disp_);
-	int height = obs_source_get_height(disp_);
-	resetVideo(width, height);
-}
-
-void VidCore::updateSpeaker(const char* id){
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	OBSDataAutoRelease settings = obs_source_get_settings(sourceAud_);
-	obs_data_set_string(settings, "device_id", id);
-	obs_source_update(sourceAud_, settings);
-}
-
-void VidCore::updateMic(const char* id){
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	OBSDataAutoRelease settings = obs_source_get_settings(sourceMic_);
-	obs_data_set_string(settings, "device_id", id);
-	obs_source_update(sourceMic_, settings);
-}
-
-void VidCore::toggleSpeakerAudio(bool mute) {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-	if (!mute) {
-		obs_source_set_volume(sourceAud_, 1.0);
-	} else {
-		obs_source_set_volume(sourceAud_, 0.0);
-	}
-}
-
-void VidCore::toggleMicAudio(bool mute) {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-	if (!mute) {
-		obs_source_set_volume(sourceMic_, 1.0);
-	} else {
-		obs_source_set_volume(sourceMic_, 0.0);
-	}
-}
-
-void VidCore::captureWindow() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	if (disp_ && captureWindowMode_) {
-		printf("CK::VID Already capturing window\n");
-		return;
-	}
-
-	// Window Capture
-	disp_ = obs_source_create("window_capture", "Window Capture", NULL, nullptr);
-	obs_set_output_source(1, disp_);
-
-	initializeWindowCapture();
-
-	// FIXME: WAIT FOR DIMENSIONS TO PROPOGATE?
-	std::this_thread::sleep_for(std::chrono::seconds(2));
-
-	int width = obs_source_get_width(disp_);
-	int height = obs_source_get_height(disp_);
-	resetVideo(width, height);
-
-	captureWindowMode_ = true;
-}
-
-void VidCore::captureMonitor() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	if (disp_ && !captureWindowMode_) {
-		printf("CK::VID Already capturing monitor\n");
-		return;
-	}
-
-	// Display Capture
-	disp_ = obs_source_create("monitor_capture", "Display Capture", NULL, nullptr);
-	obs_set_output_source(1, disp_);
-	
-	initializeDisplayCapture();
-
-	// FIXME: WAIT FOR DIMENSIONS TO PROPOGATE?
-	std::this_thread::sleep_for(std::chrono::seconds(2));
-
-	int width = obs_source_get_width(disp_);
-	int height = obs_source_get_height(disp_);
-	resetVideo(width, height);
-
-	captureWindowMode_ = false;
-}
-
-void VidCore::initializeDisplayCapture() {
-	// Using props, select the first monitor available
-	obs_properties_t* props = obs_source_properties(disp_);
-	obs_property_t* monitors = obs_properties_get(props, "monitor_id");
-	const char* devId = obs_property_list_item_string(monitors, 0);
-
-	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
-	obs_data_set_int(settings, "method", 0); // AUTO
-	obs_data_set_string(settings, "monitor_id", devId);
-	obs_source_update(disp_, settings);
-}
-
-void VidCore::initializeWindowCapture() {
-	// Using props, select the first window available
-	obs_properties_t* props = obs_source_properties(disp_);
-	obs_property_t* windows = obs_properties_get(props, "window");
-	const char* devId = obs_property_list_item_string(windows, 0);
-
-	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
-	obs_data_set_int(settings, "method", 2); // WGC
-	obs_data_set_string(settings, "window", devId);
-	obs_data_set_bool(settings, "client_area", false);
-	obs_source_update(disp_, settings);
-}
-
-bool VidCore::recordReplay() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-	if (isReplayBufferActive_) { return false; } // Already Started
-
-	configureBuffer();
-
-	if (!obs_output_start(replayBuffer_)) {
-		printf("CK::VID Unable to start replay buffer!\n");
-		return false;
-	}
-
-	isReplayBufferActive_ = true;
-	return true;
-}
-
-void VidCore::stopReplay() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	if (!isReplayBufferActive_) { return; }
-
-	obs_output_stop(replayBuffer_);
-	isReplayBufferActive_ = false;
-}
-
-void VidCore::saveReplay() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	if (!isReplayBufferActive_) { return; } // Replay Buffer Inactive
-
-	calldata_t cd = { 0 };
-	proc_handler_t* ph =
-		obs_output_get_proc_handler(replayBuffer_);
-	proc_handler_call(ph, "save", &cd);
-	calldata_free(&cd);
-
-	acm_->playSaveReplay();
-}
-
-void VidCore::toggleRecordLive() {
-	const std::lock_guard<std::mutex> lock(vidMtx_);
-
-	if (isLiveActive_) {
-		saveLive();
-	}
-	else {
-		recordLive();
-	}
-}
-
-bool VidCore::recordLive() {
-	if (isLiveActive_) { return false; } // Already Started
-
-	configureLive();
-
-	if (!obs_output_start(fileOutput_)) {
-		printf("CK::VID Unable to start live recording!\n");
-		return false;
-	}
-
-	// 30s Max
-	std::thread([this]() {
-		std::this_thread::sleep_for(std::chrono::seconds(30));
-		if (isLiveActive_) {
-			saveLive();
-		}
-	}).detach();
-
-	isLiveActive_ = true;
-	acm_->playStartLive();
-	return true;
-}
-
-void VidCore::saveLive() {
-	if (!isLiveActive_) { return; } // Not recording
-
-	obs_output_stop(fileOutput_);
-
-	isLiveActive_ = false;
-	acm_->playStopLive();
-}
-
-std::string VidCore::getLastLive() {
-	return lastRecordingLive_;
-}
-
-std::string VidCore::getLastReplay() {
-	calldata_t cd = { 0 };
-	proc_handler_t* ph =
-		obs_output_get_proc_handler(replayBuffer_);
-
-	proc_handler_call(ph, "get_last_replay", &cd);
-	const char* path = calldata_string(&cd, "path");
-	std::string strPath = std::string(path);
-	calldata_free(&cd);
-	return strPath;
-}
-
-void VidCore::uploadVideo(std::string filePath) {
-	acm_->uploadMedia(filePath, true);
-}
-
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#define NOMINMAX // WINDOWS SUX???
+
+#include "vid.h"
+#include "clip.h"
+#include "replay.h"
+#include "pipeline.h"
+#include "mp4.h"
+#include "thumb.h"
+#include "webapi.h"
+#include "writer.h"
+#include "threads.h"
+#include "encode.h"
+#include <chrono>
+#include <filesystem>
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include <util/platform.h>
+
+static const uint64_t LIVE_MAX_MS = 30000;
+static const uint64_t DEVICE_DEBOUNCE_MS = 300;
+static const int UPLOAD_ATTEMPTS = 4;
+static const uint64_t UPLOAD_RETRY_MS = 5000;
+static const int SOURCE_SIZE_TIMEOUT_MS = 2000;
+// Half a second without a changed tile drops to 1/4 bitrate, the first changed frame restores it
+static const int STATIC_ENTER_MS = 500;
+static const int STATIC_BITRATE_DIVISOR = 4;
+// One automatic save per burst of action, taken a little after the spike so the aftermath is in it
+static const uint64_t HIGHLIGHT_COOLDOWN_MS = 20000;
+static const uint64_t HIGHLIGHT_TAIL_MS = 3000;
+static const uint64_t METRICS_SAMPLE_MS = 1000;
+// No video packet for this long while the replay buffer is on means the encoder is gone
+static const uint64_t WATCHDOG_SAMPLE_MS = 500;
+static const uint64_t WATCHDOG_STALL_MS = 5000;
+// A rebuild stops walking down the encoder ranking once this is spent
+static const uint64_t RECOVERY_BUDGET_MS = 10000;
+// Failing again this soon after a recovery skips retrying the same encoder
+static const uint64_t RECOVERY_REPEAT_MS = 60000;
+// Dragging a window edge is a burst of sizes, only the one it settles on is applied
+static const uint64_t RESIZE_POLL_MS = 250;
+static const uint64_t RESIZE_SETTLE_MS = 500;
+// Shape changes under 5% letterbox into the current canvas instead of resetting it
+static const double RESIZE_ASPECT_TOLERANCE = 0.05;
+// Hotkey saves can end at most this far either side of the press
+static const int HOTKEY_OFFSET_MAX_MS = 5000;
+static const int SYNTHETIC_WIDTH = 1920;
+static const int SYNTHETIC_HEIGHT = 1080;
+
+// Before the registry's first pass there is nothing cached yet
+static std::string firstListItem(const char* sourceId, const char* prop) {
+	obs_properties_t* props = obs_get_source_properties(sourceId);
+	if (!props) return "";
+	const char* item = obs_property_list_item_string(obs_properties_get(props, prop), 0);
+	std::string value = item ? item : "";
+	obs_properties_destroy(props);
+	return value;
+}
+
+static void log_props(obs_source_t* src) {
+	if (!src) return;
+	obs_properties_t* props = obs_source_properties(src);
+	if (!props) return;
+
+	blog(LOG_INFO, "\n\n====== Properties For [%s] ======", obs_source_get_name(src));
+	obs_property_t* item = obs_properties_first(props);
+	while (item) {
+		if (obs_property_get_type(item) == OBS_PROPERTY_LIST) {
+			blog(LOG_INFO, "List - [Name: %s][Type: %d][Format: %d]:", obs_property_name(item), obs_property_list_type(item), obs_property_list_format(item));
+			for (int i = 0; i < obs_property_list_item_count(item); i++) {
+				blog(LOG_INFO, "\tName: %s", obs_property_list_item_name(item, i));
+			}
+		}
+		else {
+			blog(LOG_INFO, "Name: %s | Type: %d", obs_property_name(item), obs_property_get_type(item));
+		}
+		obs_property_next(&item);
+	}
+	blog(LOG_INFO, "====================================\n\n");
+	obs_properties_destroy(props);
+}
+
+// Signal handlers run on libobs threads, they only hand the file to the pipeline
+static void SIGSaved(void* data, calldata_t* params) {
+	VidCore* core = (VidCore*)data;
+	std::string filePath = core->getLastReplay();
+	printf("CK::VID NEW REPLAY SAVED!: %s\n", filePath.c_str());
+	uint64_t pressNs = (uint64_t)calldata_int(params, "press_ns");
+	if (pressNs) {
+		core->handleHotkeySaved(pressNs, calldata_int(params, "end_error_us"));
+	}
+	core->handleReplaySaved(filePath);
+}
+
+static void SIGSavedLive(void* data, calldata_t* params) {
+	VidCore* core = (VidCore*)data;
+	std::string filePath = core->getLastLive();
+	printf("CK::VID NEW VIDEO SAVED!: %s\n", filePath.c_str());
+	mp4::clearPartial(filePath);
+	core->uploadVideo(filePath);
+}
+
+// Requested stops report OBS_OUTPUT_SUCCESS, anything else is the encoder or output failing
+static void SIGReplayStopped(void* data, calldata_t* params) {
+	VidCore* core = (VidCore*)data;
+	core->handleReplayStopped((int)calldata_int(params, "code"));
+}
+
+// Ticks run on the libobs graphics thread, the first one raises it
+static void onGraphicsTick(void* param, float seconds) {
+	thread_local bool applied = false;
+	if (applied) return;
+	threads::apply(threads::GRAPHICS, nullptr);
+	applied = true;
+}
+
+static void onRawVideo(void* param, struct video_data* frame) {
+	VidCore* core = static_cast<VidCore*>(param);
+	core->handleSceneFrame(frame->data[0], frame->linesize[0]);
+}
+
+static void onDesktopAudio(void* param, obs_source_t*, const struct audio_data* audio, bool muted) {
+	static_cast<VidCore*>(param)->handleHighlightAudio(false, audio, muted);
+}
+
+static void onMicAudio(void* param, obs_source_t*, const struct audio_data* audio, bool muted) {
+	static_cast<VidCore*>(param)->handleHighlightAudio(true, audio, muted);
+}
+
+// Capture sources report 0x0 until their first frame lands
+static void waitForDimensions(obs_source_t* source, int timeoutMs) {
+	auto start = std::chrono::steady_clock::now();
+	while (obs_source_get_width(source) == 0 || obs_source_get_height(source) == 0) {
+		auto waited = std::chrono::steady_clock::now() - start;
+		if (waited >= std::chrono::milliseconds(timeoutMs)) {
+			printf("CK::VID Source size still unknown after %dms\n", timeoutMs);
+			return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	printf("CK::VID Source sized after %lldms\n", (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count());
+}
+
+VidCore::VidCore() {
+	isReplayBufferActive_ = false;
+	isLiveActive_ = false;
+	captureWindowMode_ = false;
+	displayItem_ = nullptr;
+	trackedWidth_ = 0;
+	trackedHeight_ = 0;
+	resizeTimer_ = Scheduler::INVALID_TIMER;
+	forceSoftware_ = false;
+	preset_ = BALANCED;
+	replaySeconds_ = 30;
+	replayWindows_ = { 15, 60, 300 };
+	uploadTrimSeconds_ = 0;
+	hotkeySaveOffsetMs_ = 0;
+	liveCapTimer_ = Scheduler::INVALID_TIMER;
+	liveSession_ = 0;
+	graphicsModule_ = "libobs-d3d11.dll";
+	syntheticSources_ = false;
+	unchangedFrames_ = 0;
+	staticEnterFrames_ = 30;
+	sceneWatching_ = false;
+	sceneStatic_ = false;
+	sceneFrames_ = 0;
+	sceneStaticFrames_ = 0;
+	autoHighlights_ = false;
+	lastHighlightMs_ = 0;
+	health_ = {};
+	recoveryStats_ = {};
+	lastHotkeySave_ = {};
+	metricsPort_ = 0;
+	metricsTimer_ = Scheduler::INVALID_TIMER;
+	watchdog_ = {};
+	watchdogTimer_ = Scheduler::INVALID_TIMER;
+	recoveryPending_ = false;
+	recoveryStartMs_ = 0;
+
+	lastRecordingLive_ = "";
+}
+
+VidCore::~VidCore() {
+	commands_.stop();
+
+	// Scrapes read pipeline histograms
+	metricsServer_.stop();
+	// The video & audio threads call into us until these return
+	watchScene(false);
+	sceneEncoder_ = nullptr;
+	obs_remove_tick_callback(onGraphicsTick, this);
+	if (sourceAud_) obs_source_remove_audio_capture_callback(sourceAud_, onDesktopAudio, this);
+	if (sourceMic_) obs_source_remove_audio_capture_callback(sourceMic_, onMicAudio, this);
+	// Pending timers may still touch the pipeline
+	scheduler_.stop();
+	devices_.stop();
+	pipeline_.logStats();
+	pipeline_.stop();
+	modules_.logReport();
+	logSceneStats();
+}
+
+bool VidCore::resetAudio() {
+	struct obs_audio_info2 ai = {};
+	ai.samples_per_sec = 48000;
+	ai.speakers = SPEAKERS_STEREO;
+	if (!obs_reset_audio2(&ai)) {
+		printf("CK::VID Failed to reset audio!!!\n");
+		return false;
+	}
+	obs_set_audio_monitoring_device("Default", "default");
+	return true;
+}
+
+VidCore::PresetConfig VidCore::getPresetConfig(QualityPreset preset) {
+	switch (preset) {
+	case PERFORMANCE:
+		// Cheapest scaler & half rate, for iGPUs sharing with the game
+		return { "performance", OBS_SCALE_BILINEAR, 1280, 720, 30, "speed", 2500 };
+	case QUALITY:
+		return { "quality", OBS_SCALE_LANCZOS, 1920, 1080, 60, "quality", 6000 };
+	case BALANCED:
+	default:
+		return { "balanced", OBS_SCALE_BICUBIC, 1280, 720, 60, "balanced", 3000 };
+	}
+}
+
+void VidCore::capToPreset(const PresetConfig& cfg, int& width, int& height) {
+	// Cap Dimensions - Maintain Aspect Ratio
+	if (width > cfg.maxWidth || height > cfg.maxHeight) {
+		double aspectRatio = static_cast<double>(width) / height;
+		int capped = std::min(width, cfg.maxWidth);
+		height = static_cast<int>(capped / aspectRatio);
+		width = capped;
+		if (height > cfg.maxHeight) {
+			height = cfg.maxHeight;
+			width = static_cast<int>(height * aspectRatio);
+		}
+	}
+	// NV12 needs even dimensions
+	width &= ~1;
+	height &= ~1;
+}
+
+bool VidCore::resetVideo(int width, int height) {
+	PresetConfig cfg = getPresetConfig(preset_);
+
+	int newWidth = width;
+	int newHeight = height;
+	capToPreset(cfg, newWidth, newHeight);
+
+	ovi_.graphics_module = graphicsModule_.c_str();
+	ovi_.fps_num = cfg.fps;
+	ovi_.fps_den = 1;
+	ovi_.base_width = width;
+	ovi_.base_height = height;
+	ovi_.output_width = newWidth;
+	ovi_.output_height = newHeight;
+	ovi_.output_format = VIDEO_FORMAT_NV12;
+	ovi_.colorspace = VIDEO_CS_709;
+	ovi_.range = VIDEO_RANGE_PARTIAL;
+	ovi_.gpu_conversion = true;
+	ovi_.scale_type = cfg.scaleType;
+
+	// A raw video callback counts as active video, obs_reset_video refuses while one is attached
+	bool watching = sceneWatching_;
+	watchScene(false);
+	int ret = obs_reset_video(&ovi_);
+	staticEnterFrames_ = std::max<int>(1, cfg.fps * STATIC_ENTER_MS / 1000);
+	if (watching) watchScene(true);
+
+	if (ret != OBS_VIDEO_SUCCESS) {
+		printf("CK::VID Failed to reset video!!!\n");
+		return false;
+	}
+	obs_set_video_levels(300.000000, 1000.00000);
+	applyRegion();
+	return true;
+}
+
+VidCore::AdapterType VidCore::getAdapterType(int idx) {
+	// Essentially guessing the vendor based on keywords in name
+	std::string nvidiaKeys[] = { "nvidia", "geforce", "gtx", "rtx" };
+	std::string amdKeys[] = { "amd", "radeon", "rx", "ati" };
+	std::string intelKeys[] = { "intel", "arc" };
+
+	// Headless runs may not pass any adapter names
+	if (idx < 0 || idx >= (int)availableAdapters_.size()) return UNKNOWN;
+
+	std::string name = availableAdapters_[idx];
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	for (const std::string& keyword : nvidiaKeys) {
+		if (name.find(keyword) != std::string::npos) {
+			return NVIDIA;
+		}
+	}
+	for (const std::string& keyword : amdKeys) {
+		if (name.find(keyword) != std::string::npos) {
+			return AMD;
+		}
+	}
+	for (const std::string& keyword : intelKeys) {
+		if (name.find(keyword) != std::string::npos) {
+			return INTEL;
+		}
+	}
+
+	printf("CK::VID Unable to determine type!\n");
+	return UNKNOWN;
+}
+
+static std::string getCodec(const std::string& encoderId) {
+	const char* codec = obs_get_encoder_codec(encoderId.c_str());
+	return codec ? std::string(codec) : std::string();
+}
+
+void VidCore::detectVideoEncoder() {
+	// Only the adapter's vendor module, the muxer & AAC live in obs-ffmpeg either way
+	AdapterType at = getAdapterType(ovi_.adapter);
+	modules_.require("obs-ffmpeg");
+	if (at == INTEL) {
+		modules_.require("obs-qsv11");
+	}
+
+	// Enumerate available encoders
+	std::vector<std::string> available;
+	size_t idx = 0;
+	const char* id;
+	while (obs_enum_encoder_types(idx++, &id)) {
+		printf("CK::VID [ENUM_ENCODERS] - %s (%s)\n", id, getCodec(id).c_str());
+		available.push_back(id);
+	}
+
+	// Rank the adapter's encoders, smallest output first
+	std::vector<std::string> candidates;
+	switch (at) {
+	case NVIDIA:
+		candidates = {
+			"obs_nvenc_av1_tex", "jim_av1_nvenc",
+			"obs_nvenc_hevc_tex", "jim_hevc_nvenc", "ffmpeg_hevc_nvenc",
+			"obs_nvenc_h264_tex", "jim_nvenc", "ffmpeg_nvenc"
+		};
+		break;
+	case AMD:
+		candidates = { "av1_texture_amf", "h265_texture_amf", "h264_texture_amf" };
+		break;
+	case INTEL:
+		candidates = { "obs_qsv11_av1", "obs_qsv11_hevc", "obs_qsv11_v2" };
+		break;
+	default:
+		break;
+	}
+	// HEVC/AV1 only when the account can take them
+	bool advancedCodecs = acm_ && acm_->allowsAdvancedCodecs();
+
+	encoderRanking_.clear();
+	for (const std::string& candidate : candidates) {
+		if (std::find(available.begin(), available.end(), candidate) == available.end()) {
+			continue;
+		}
+		if (!advancedCodecs && getCodec(candidate) != "h264") {
+			continue;
+		}
+		encoderRanking_.push_back(candidate);
+	}
+	// Software H.264 is always the last resort, obs-x264 only loads once something falls back to it
+	encoderRanking_.push_back("obs_x264");
+
+	if (forceSoftware_ || encoderRanking_.empty() || encoderRanking_.front() == "obs_x264") {
+		encoderString_ = "obs_x264";
+		printf("CK::VID Encoder fallback to software\n");
+	}
+	else {
+		encoderString_ = encoderRanking_.front();
+	}
+
+	printf("CK::VID [ENCODER] chose %s (%s) with card type %d\n", encoderString_.c_str(), getCodec(encoderString_).c_str(), at);
+}
+
+bool VidCore::fallbackEncoder() {
+	// Step down the ranking, ends on software H.264
+	auto it = std::find(encoderRanking_.begin(), encoderRanking_.end(), encoderString_);
+	if (it == encoderRanking_.end() || ++it == encoderRanking_.end()) {
+		if (encoderString_ == "obs_x264") {
+			return false;
+		}
+		encoderString_ = "obs_x264";
+	}
+	else {
+		encoderString_ = *it;
+	}
+	printf("CK::VID [ENCODER] falling back to %s\n", encoderString_.c_str());
+	return true;
+}
+
+bool VidCore::loadOBS() {
+	if (!obs_startup("en-US", nullptr, nullptr)) {
+		printf("CK::VID OBS STARTUP FAILED!\n");
+		return false;
+	}
+
+	resetAudio();
+
+	// Effects Files
+	CHAR szFileName[MAX_PATH];
+	GetModuleFileNameA(NULL, szFileName, MAX_PATH);
+	std::string path = std::string(szFileName);
+	std::replace(path.begin(), path.end(), '\\', '/');
+	std::size_t lastSlashIndex = path.find_last_of('/');
+	if (lastSlashIndex != std::string::npos) {
+		path.erase(lastSlashIndex + 1);
+	}
+	path += "effects/";
+	obs_add_data_path(path.c_str());
+
+	int screenWidth = syntheticSources_ ? SYNTHETIC_WIDTH : GetSystemMetrics(SM_CXSCREEN);
+	int screenHeight = syntheticSources_ ? SYNTHETIC_HEIGHT : GetSystemMetrics(SM_CYSCREEN);
+	ovi_.adapter = 0; // Default to first graphics card
+	resetVideo(screenWidth, screenHeight);
+	obs_add_tick_callback(onGraphicsTick, this);
+
+	// Plugin modules load on first use through modules_
+
+	// Our own outputs
+	replay::registerOutput();
+
+	detectVideoEncoder();
+
+	return true;
+}
+
+void VidCore::configureBuffer() {
+	OBSDataAutoRelease settings = obs_data_create();
+
+	std::string videoDir = acm_->getVideoDir();
+	obs_data_set_string(settings, "directory", videoDir.c_str());
+	obs_data_set_string(settings, "format", "CKREPLAY_%CCYY-%MM-%DD_%hh-%mm-%ss");
+	obs_data_set_string(settings, "extension", "mp4");
+	obs_data_set_bool(settings, "allow_spaces", false);
+	// The ring holds the longest window, shorter ones are views onto it
+	int longest = replaySeconds_;
+	for (int w : replayWindows_) {
+		longest = std::max(longest, w);
+	}
+	obs_data_set_int(settings, "max_time_sec", longest);
+	// Recent history stays in RAM, anything older spills to disk, so RAM stays bounded however long the window
+	obs_data_set_int(settings, "memory_sec", std::min(replaySeconds_, 30));
+	obs_data_set_int(settings, "max_size_mb", 512);
+
+	obs_output_update(replayBuffer_, settings);
+}
+
+void VidCore::configureLive() {
+	OBSDataAutoRelease settings = obs_data_create();
+
+	std::string dir = acm_->getVideoDir();
+	std::string timestamp = webapi::getTimestamp();
+	std::string extension = ".mp4";
+
+	lastRecordingLive_ = dir + "CKVID_" + timestamp + extension;
+
+	obs_data_set_string(settings, "path", lastRecordingLive_.c_str());
+	// Fragment per keyframe behind an empty moov, a crash only costs the fragment being written
+	obs_data_set_string(settings, "muxer_settings", "movflags=frag_keyframe+empty_moov+default_base_moof");
+	obs_output_update(fileOutput_, settings);
+}
+
+void VidCore::addSources() {
+	for (int i = 0; i < MAX_CHANNELS; i++)
+		obs_set_output_source(i, nullptr);
+
+	// Display Capture
+	if (captureWindowMode_) {
+		captureWindow();
+	} else {
+		captureMonitor();
+	}
+
+	// No audio devices to fake, the encoders still run on silence
+	if (syntheticSources_) return;
+
+	// Audio Out
+	modules_.requireFor("wasapi_output_capture");
+	sourceAud_ = obs_source_create("wasapi_output_capture", "Desktop Audio", NULL, nullptr);
+	obs_set_output_source(3, sourceAud_);
+	obs_source_add_audio_capture_callback(sourceAud_, onDesktopAudio, this);
+
+	// Audio In
+	sourceMic_ = obs_source_create("wasapi_input_capture", "Mic/Aux", NULL, nullptr);
+	obs_set_output_source(4, sourceMic_);
+	obs_source_add_audio_capture_callback(sourceMic_, onMicAudio, this);
+
+#ifdef _DEBUG
+	log_props(disp_);
+	log_props(sourceAud_);
+	log_props(sourceMic_);
+#endif
+}
+
+void VidCore::addOutputs() {
+	// Replay Buffer
+	replayBuffer_ = obs_output_create(REPLAY_RING_OUTPUT_ID,
+		"Replay Buffer",
+		nullptr, nullptr);
+	signal_handler_t* rbSignal =
+		obs_output_get_signal_handler(replayBuffer_);
+
+	replayBufferSaved_.Connect(rbSignal, "saved",
+		SIGSaved, (void*)this);
+	replayStopped_.Connect(rbSignal, "stop",
+		SIGReplayStopped, (void*)this);
+
+	// File Output (ffmpeg_muxer)
+	modules_.requireFor("ffmpeg_muxer");
+	fileOutput_ = obs_output_create(
+		"ffmpeg_muxer", "simple_file_output", nullptr, nullptr);
+	if (!fileOutput_)
+		throw "Failed to create recording output (simple output)";
+
+	signal_handler_t* liveSignal =
+		obs_output_get_signal_handler(fileOutput_);
+
+	liveVideoSaved_.Connect(liveSignal, "stop",
+		SIGSavedLive, (void*)this);
+}
+
+void VidCore::startEncoders() {
+	modules_.requireFor(encoderString_);
+	videoRecording_ = obs_video_encoder_create(
+		encoderString_.c_str(), "simple_video_recording", nullptr, nullptr);
+	while (!videoRecording_ && fallbackEncoder()) {
+		modules_.requireFor(encoderString_);
+		videoRecording_ = obs_video_encoder_create(
+			encoderString_.c_str(), "simple_video_recording", nullptr, nullptr);
+	}
+	if (!videoRecording_) {
+		printf("CK::FATAL: Failed to create video encoder!!!\n");
+	}
+	modules_.requireFor("ffmpeg_aac");
+	aacRecording_ = obs_audio_encoder_create("ffmpeg_aac", "simple_aac_recording", nullptr, 0, nullptr);
+	if (!aacRecording_) {
+		printf("CK::FATAL: Failed to create audio encoder!!!\n");
+	}
+
+	// Video Encoder Settings
+	configureVideoEncoder(videoRecording_, encoderString_);
+
+	// Audio Encorder Settings
+	OBSDataAutoRelease asettings = obs_data_create();
+	obs_data_set_int(asettings, "bitrate", 128);
+	obs_data_set_string(asettings, "rate_control", "CBR");
+	obs_encoder_update(aacRecording_, asettings);
+
+	// Attach Encoders
+	obs_encoder_set_video(videoRecording_, obs_get_video());
+	obs_encoder_set_audio(aacRecording_, obs_get_audio());
+
+	obs_output_set_video_encoder(fileOutput_, videoRecording_);
+	obs_output_set_audio_encoder(fileOutput_, aacRecording_, 0);
+
+	obs_output_set_video_encoder(replayBuffer_, videoRecording_);
+	obs_output_set_audio_encoder(replayBuffer_, aacRecording_, 0);
+}
+
+// Newer codecs hit the same quality with fewer bits
+static int scaleBitrateForCodec(const std::string& codec, int bitrate) {
+	if (codec == "hevc") {
+		return bitrate * 6 / 10;
+	}
+	if (codec == "av1") {
+		return bitrate / 2;
+	}
+	return bitrate;
+}
+
+void VidCore::configureVideoEncoder(obs_encoder_t* encoder, const std::string& encoderId) {
+	std::string codec = getCodec(encoderId);
+	int bitrate = getPresetConfig(preset_).bitrate;
+
+	const char* profile = (codec == "hevc" || codec == "av1") ? "main" : "high";
+	bitrate = scaleBitrateForCodec(codec, bitrate);
+	// A cropped capture encodes fewer pixels than the full source would, spend fewer bits on it
+	if (region_.width > 0 && region_.height > 0 && disp_) {
+		int fullWidth = obs_source_get_width(disp_);
+		int fullHeight = obs_source_get_height(disp_);
+		capToPreset(getPresetConfig(preset_), fullWidth, fullHeight);
+		double fullPixels = (double)fullWidth * fullHeight;
+		if (fullPixels > 0) {
+			double ratio = (double)ovi_.output_width * ovi_.output_height / fullPixels;
+			bitrate = (int)(bitrate * std::clamp(ratio, 0.25, 1.0));
+		}
+	}
+	OBSDataAutoRelease fullRate = obs_data_create();
+	obs_data_set_string(fullRate, "rate_control", "CBR");
+	obs_data_set_string(fullRate, "profile", profile);
+	obs_data_set_int(fullRate, "bitrate", bitrate);
+	applyEncoderPreset(fullRate, encoderId);
+	// CBR pads a still screen with filler, no reason to spend full rate on it
+	OBSDataAutoRelease staticRate = obs_data_create();
+	obs_data_apply(staticRate, fullRate);
+	obs_data_set_int(staticRate, "bitrate", bitrate / STATIC_BITRATE_DIVISOR);
+
+	// Scene flips switch between the two from the video thread from now on
+	const std::lock_guard<std::mutex> lock(sceneRateMtx_);
+	sceneEncoder_ = encoder;
+	fullRateSettings_ = fullRate;
+	staticRateSettings_ = staticRate;
+	obs_encoder_update(encoder, sceneStatic_ ? staticRate : fullRate);
+}
+
+void VidCore::applyEncoderPreset(obs_data_t* settings, const std::string& encoderId) {
+	// Each encoder names its speed/quality knob differently
+	std::string level = getPresetConfig(preset_).encoderPreset;
+	bool speed = level == "speed";
+	bool quality = level == "quality";
+
+	if (encoderId == "obs_x264") {
+		obs_data_set_string(settings, "preset", speed ? "superfast" : quality ? "fast" : "veryfast");
+	}
+	else if (encoderId.find("nvenc") != std::string::npos) {
+		obs_data_set_string(settings, "preset2", speed ? "p2" : quality ? "p6" : "p4");
+		obs_data_set_string(settings, "preset", speed ? "hp" : quality ? "mq" : "hq"); // Legacy key
+	}
+	else if (encoderId.find("_amf") != std::string::npos) {
+		obs_data_set_string(settings, "preset", level.c_str());
+	}
+	else if (encoderId.find("obs_qsv11") == 0) {
+		obs_data_set_string(settings, "target_usage", speed ? "TU7" : quality ? "TU1" : "TU4");
+	}
+}
+
+void VidCore::waitForOutputsStopped() {
+	// obs_output_stop is asynchronous, obs_reset_video fails while anything is still active
+	for (int i = 0; i < 200; i++) {
+		bool active = (replayBuffer_ && obs_output_active(replayBuffer_))
+			|| (fileOutput_ && obs_output_active(fileOutput_));
+		if (!active) return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	printf("CK::VID Outputs still active after stop!\n");
+}
+
+/////////////////////////////////////////////////////
+/////////////////////////////////////////////////////
+
+bool VidCore::init(std::shared_ptr<AccountManager> acm, const std::vector<std::string>& adapters) {
+	if (!acm) {
+		return false;
+	}
+	acm_ = acm;
+	availableAdapters_ = adapters;
+
+	auto phaseStart = std::chrono::steady_clock::now();
+	auto phaseDone = [&phaseStart](const char* phase) {
+		auto now = std::chrono::steady_clock::now();
+		printf("CK::VID [INIT] %s took %.1fms\n", phase,
+			std::chrono::duration<double, std::milli>(now - phaseStart).count());
+		phaseStart = now;
+	};
+
+	scheduler_.start();
+	initPipeline();
+
+	// libobs module loading isn't thread safe, so this part stays serial
+	if (!loadOBS()) {
+		return false;
+	}
+	phaseDone("libobs & modules");
+	addSources();
+	phaseDone("sources");
+	addOutputs();
+	startEncoders();
+	phaseDone("outputs & encoders");
+	watchScene(true);
+	initMetrics();
+	recoverRecordings();
+	// Games change resolution & go borderless under a running capture
+	resizeTimer_ = scheduler_.scheduleEvery(RESIZE_POLL_MS, [this]() { pollSourceSize(); });
+
+	// Nothing to hot-plug with synthetic sources
+	if (!syntheticSources_) {
+		// Runs on the scheduler thread, which must not wait out a reconfiguration holding vidMtx_.
+		// The empty command republishes like any other, listeners hear of it after that
+		devices_.start(&scheduler_, [this]() {
+			queueCommand([]() {}, [this]() {
+				const std::lock_guard<std::mutex> lock(listenerMtx_);
+				if (devicesChanged_) devicesChanged_();
+			});
+		});
+	}
+
+	publishState();
+	// Commands queued before init are picked up from here.
+	// Capture mode decides which cached list is shown as displays, republish after each
+	commands_.start([this]() { publishState(); });
+	return true;
+}
+
+bool VidCore::queueCommand(std::function<void()> cmd, std::function<void()> done) {
+	return commands_.queue(std::move(cmd), std::move(done));
+}
+
+bool VidCore::runCommand(std::function<void()> cmd) {
+	return commands_.run(std::move(cmd));
+}
+
+std::shared_ptr<const VidCore::State> VidCore::getState() {
+	return state_.get();
+}
+
+void VidCore::publishState() {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+
+	auto next = std::make_shared<State>(*state_.get());
+	enumerateDevices(*next);
+	next->preset = preset_;
+	next->replaySeconds = replaySeconds_;
+	next->uploadTrimSeconds = uploadTrimSeconds_;
+	next->encoder = encoderString_;
+	next->captureWindowMode = captureWindowMode_;
+	next->captureRegion = region_;
+	if (disp_) {
+		next->sourceWidth = obs_source_get_width(disp_);
+		next->sourceHeight = obs_source_get_height(disp_);
+	}
+	next->replayActive = isReplayBufferActive_;
+	next->liveActive = isLiveActive_;
+	next->autoHighlights = autoHighlights_;
+	next->encoderRecoveries = watchdog_.recoveries;
+	if (replayBuffer_) {
+		// ovi_ is only valid once libobs is up
+		next->adapter = ovi_.adapter;
+		next->outputWidth = ovi_.output_width;
+		next->outputHeight = ovi_.output_height;
+	}
+	state_.publish(std::move(next));
+}
+
+bool VidCore::overrideAdapter(int idx) {
+	if (idx == ovi_.adapter) return false;
+
+	// Stop outputs
+	stopReplay();
+	saveLive();
+	waitForOutputsStopped();
+	// Release outputs
+	replayBuffer_ = nullptr;
+	fileOutput_ = nullptr;
+	// Release sources
+	disp_ = nullptr;
+	sourceMic_ = nullptr;
+	sourceAud_ = nullptr;
+
+	ovi_.adapter = idx;
+
+	// Reset video, resetVideo detaches the scene watcher around it
+	bool ok = resetVideo(ovi_.base_width, ovi_.base_height);
+	if (!ok) {
+		printf("CK::VID Failed to override graphics card!!!\n");
+	}
+	
+	// Re-add sources
+	addSources();
+	// Re-add outputs
+	addOutputs();
+	// Restart encoders
+	startEncoders();
+	
+	// Restart replay buffer
+	recordReplay();
+
+	return ok;
+}
+
+void VidCore::forceSoftwareEncoder() {
+	// Stop the outputs
+	stopReplay();
+	saveLive();
+	waitForOutputsStopped();
+	// Release the outputs
+	replayBuffer_ = nullptr;
+	fileOutput_ = nullptr;
+	// Release sources
+	disp_ = nullptr;
+	sourceMic_ = nullptr;
+	sourceAud_ = nullptr;
+
+	// Force
+	forceSoftware_ = true;
+	encoderString_ = "obs_x264";
+
+	// Re-add sources
+	addSources();
+	// Re-add outputs
+	addOutputs();
+	// Restart encoders
+	startEncoders();
+	
+	// Restart replay buffer
+	recordReplay();
+}
+
+bool VidCore::setQualityPreset(QualityPreset preset) {
+	if (preset == preset_) return false;
+
+	if (!replayBuffer_) {
+		// Not initialized yet, picked up by the first resetVideo
+		preset_ = preset;
+		return true;
+	}
+
+	bool wasRecording = isReplayBufferActive_;
+
+	// Stop outputs
+	stopReplay();
+	saveLive();
+	waitForOutputsStopped();
+
+	preset_ = preset;
+
+	// Scale filter, resolution and fps
+	bool ok = resetVideo(ovi_.base_width, ovi_.base_height);
+	// Encoder preset and bitrate
+	startEncoders();
+
+	if (wasRecording) {
+		recordReplay();
+	}
+
+	printf("CK::VID [PRESET] switched to %s\n", getPresetConfig(preset_).name);
+	return ok;
+}
+
+void VidCore::benchmarkCaptureRegion(int seconds) {
+	CaptureRegion original;
+	CaptureRegion full;
+	CaptureRegion half;
+	uint32_t canvasWidth = 0;
+	uint32_t canvasHeight = 0;
+	runCommand([&]() {
+		original = region_;
+		half.width = disp_ ? obs_source_get_width(disp_) / 2 : 0;
+		half.height = disp_ ? obs_source_get_height(disp_) : 0;
+		canvasWidth = ovi_.base_width;
+		canvasHeight = ovi_.base_height;
+	});
+
+	// The half region gets a canvas of its own size
+	const char* names[] = { "full", "half" };
+	double frameMs[2] = {};
+	double kbps[2] = {};
+	for (int i = 0; i < 2; i++) {
+		runCommand([&]() { setCaptureRegion(i == 0 ? full : half); });
+		// Let the frame time average & the encoder's rate control settle
+		std::this_thread::sleep_for(std::chrono::seconds(2));
+
+		uint64_t bytesStart = 0;
+		uint64_t bytesEnd = 0;
+		runCommand([&]() { bytesStart = replayBuffer_ ? obs_output_get_total_bytes(replayBuffer_) : 0; });
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		runCommand([&]() {
+			bytesEnd = replayBuffer_ ? obs_output_get_total_bytes(replayBuffer_) : 0;
+			frameMs[i] = obs_get_average_frame_time_ns() / 1000000.0;
+			kbps[i] = (bytesEnd - bytesStart) * 8.0 / (seconds * 1000.0);
+			printf("CK::VID [BENCH] region=%s canvas=%ux%u output=%ux%u render=%.3fms bitrate=%.0fkbps\n",
+				names[i], ovi_.base_width, ovi_.base_height, ovi_.output_width, ovi_.output_height, frameMs[i], kbps[i]);
+		});
+	}
+	if (frameMs[0] > 0 && kbps[0] > 0) {
+		printf("CK::VID [BENCH] half region saves %.1f%% render time & %.1f%% bitrate\n",
+			(1.0 - frameMs[1] / frameMs[0]) * 100.0, (1.0 - kbps[1] / kbps[0]) * 100.0);
+	}
+
+	runCommand([&]() {
+		setCaptureRegion(original);
+		if (ovi_.base_width != canvasWidth || ovi_.base_height != canvasHeight) {
+			resizeCanvas(canvasWidth, canvasHeight);
+		}
+	});
+}
+
+VidCore::QualityPreset VidCore::getQualityPreset() {
+	return getState()->preset;
+}
+
+void VidCore::setReplayLength(int seconds) {
+	seconds = std::clamp(seconds, 10, 600);
+	if (seconds == replaySeconds_) return;
+	replaySeconds_ = seconds;
+
+	if (!replayBuffer_) return; // Picked up by configureBuffer
+
+	// The ring is sized on start, restart to apply
+	if (isReplayBufferActive_) {
+		stopReplay();
+		waitForOutputsStopped();
+		recordReplay();
+	}
+}
+
+int VidCore::getReplayLength() {
+	return getState()->replaySeconds;
+}
+
+// Fixed at construction, safe to read from any thread
+std::vector<int> VidCore::getReplayWindows() {
+	return replayWindows_;
+}
+
+void VidCore::benchmarkPresets(int secondsPerPreset) {
+	// Renders each preset for a while and reports the average frame time.
+	// Switches go through the command queue, only the waiting happens on the caller's thread
+	QualityPreset original = getState()->preset;
+	QualityPreset presets[] = { PERFORMANCE, BALANCED, QUALITY };
+
+	for (QualityPreset p : presets) {
+		runCommand([this, p]() { if (p != preset_) setQualityPreset(p); });
+		// Let the frame time average settle
+		std::this_thread::sleep_for(std::chrono::seconds(secondsPerPreset));
+
+		std::shared_ptr<const State> state = getState();
+		PresetConfig cfg = getPresetConfig(p);
+		double frameMs = obs_get_average_frame_time_ns() / 1000000.0;
+		double budgetMs = 1000.0 / cfg.fps;
+		printf("CK::VID [BENCH] preset=%s scale=%d output=%dx%d fps=%u render=%.3fms (%.1f%% of frame budget)\n",
+			cfg.name, cfg.scaleType, state->outputWidth, state->outputHeight, cfg.fps, frameMs, frameMs / budgetMs * 100.0);
+	}
+
+	runCommand([this, original]() { setQualityPreset(original); });
+}
+
+void VidCore::benchmarkStateReads(int seconds) {
+	// UI-style reads from this thread, first idle then while a video reset runs on the command queue
+	typedef std::chrono::steady_clock Clock;
+	auto sample = [this](LatencyHistogram& hist, uint64_t& maxNs, std::function<bool()> keepGoing) {
+		while (keepGoing()) {
+			auto begin = Clock::now();
+			std::shared_ptr<const State> state = getState();
+			uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+			hist.record(ns);
+			maxNs = std::max(maxNs, ns);
+		}
+	};
+
+	LatencyHistogram idle, busy;
+	uint64_t idleMax = 0, busyMax = 0;
+	auto idleUntil = Clock::now() + std::chrono::seconds(seconds);
+	sample(idle, idleMax, [&]() { return Clock::now() < idleUntil; });
+
+	// Away from the current preset and back, two full obs_reset_video runs
+	QualityPreset original = getState()->preset;
+	QualityPreset other = original == BALANCED ? PERFORMANCE : BALANCED;
+	auto finished = std::make_shared<std::atomic<bool>>(false);
+	auto reconfigStart = Clock::now();
+	queueCommand([this, original, other]() {
+		setQualityPreset(other);
+		setQualityPreset(original);
+	}, [finished]() { *finished = true; });
+	sample(busy, busyMax, [&]() { return !*finished; });
+	double reconfigMs = std::chrono::duration<double, std::milli>(Clock::now() - reconfigStart).count();
+
+	printf("CK::VID [BENCH] state reads idle: n=%llu p50=%.3fms p99=%.3fms max=%.3fms\n",
+		(unsigned long long)idle.count(), idle.percentileMs(0.5), idle.percentileMs(0.99), idleMax / 1000000.0);
+	printf("CK::VID [BENCH] state reads during %.0fms reconfiguration: n=%llu p50=%.3fms p99=%.3fms max=%.3fms\n",
+		reconfigMs, (unsigned long long)busy.count(), busy.percentileMs(0.5), busy.percentileMs(0.99), busyMax / 1000000.0);
+}
+
+void VidCore::refreshEncoder() {
+	// Account policy changed, pick again and only rebuild on a different encoder
+	std::string previous = encoderString_;
+	detectVideoEncoder();
+	if (previous == encoderString_ || !replayBuffer_) return;
+
+	bool wasRecording = isReplayBufferActive_;
+
+	stopReplay();
+	saveLive();
+	waitForOutputsStopped();
+
+	startEncoders();
+
+	if (wasRecording) {
+		recordReplay();
+	}
+}
+
+void VidCore::watchScene(bool watch) {
+	if (watch == sceneWatching_) return;
+
+	if (watch) {
+		// libobs scales & converts on the GPU, only a small NV12 frame comes back
+		struct video_scale_info info = {};
+		info.format = VIDEO_FORMAT_NV12;
+		info.width = ChangeDetector::WIDTH;
+		info.height = ChangeDetector::HEIGHT;
+		info.range = VIDEO_RANGE_PARTIAL;
+		info.colorspace = VIDEO_CS_709;
+		changes_.reset();
+		unchangedFrames_ = 0;
+		obs_add_raw_video_callback(&info, onRawVideo, this);
+	}
+	else {
+		// Waits out a callback in flight, the detector is ours again after this
+		obs_remove_raw_video_callback(onRawVideo, this);
+	}
+	sceneWatching_ = watch;
+}
+
+void VidCore::handleSceneFrame(const uint8_t* luma, uint32_t linesize) {
+	sceneFrames_++;
+
+	if (changes_.feed(luma, linesize)) {
+		unchangedFrames_ = 0;
+		if (sceneStatic_.exchange(false)) {
+			applySceneBitrate();
+		}
+		return;
+	}
+
+	if (sceneStatic_) {
+		sceneStaticFrames_++;
+	}
+	else if (++unchangedFrames_ >= staticEnterFrames_) {
+		sceneStatic_ = true;
+		applySceneBitrate();
+	}
+}
+
+// Straight from the video thread, the settings were built when the encoder was configured.
+// Never waits on vidMtx_ or the command queue, motion gets its full rate back on the next frame
+void VidCore::applySceneBitrate() {
+	const std::lock_guard<std::mutex> lock(sceneRateMtx_);
+	if (!sceneEncoder_) return;
+
+	// Reads the flag under the lock, so a flip & a reconfiguration settle on the latest state
+	bool staticScene = sceneStatic_;
+	obs_encoder_update(sceneEncoder_, staticScene ? staticRateSettings_ : fullRateSettings_);
+	printf("CK::VID [SCENE] %s\n", staticScene ? "static, bitrate lowered" : "motion, full bitrate");
+}
+
+void VidCore::logSceneStats() {
+	uint64_t frames = sceneFrames_;
+	uint64_t staticFrames = sceneStaticFrames_;
+	if (frames == 0) return;
+
+	// Rough, assumes CBR actually spent the full rate on those frames
+	PresetConfig cfg = getPresetConfig(preset_);
+	double staticSeconds = (double)staticFrames / cfg.fps;
+	double savedMB = cfg.bitrate * (1.0 - 1.0 / STATIC_BITRATE_DIVISOR) * staticSeconds / 8.0 / 1000.0;
+	printf("CK::VID [SCENE] %llu frames, %.1f%% static (%.0fs), ~%.1fMB not encoded\n",
+		(unsigned long long)frames, 100.0 * staticFrames / frames, staticSeconds, savedMB);
+}
+
+void VidCore::setAutoHighlights(bool enabled) {
+	// Stale baselines would compare against whatever played before it was switched off
+	if (enabled && !autoHighlights_) {
+		desktopHighlights_.reset();
+		micHighlights_.reset();
+	}
+	autoHighlights_ = enabled;
+}
+
+bool VidCore::getAutoHighlights() {
+	return getState()->autoHighlights;
+}
+
+void VidCore::setHighlightThreshold(float db) {
+	desktopHighlights_.setThreshold(db);
+	micHighlights_.setThreshold(db);
+}
+
+void VidCore::handleHighlightAudio(bool mic, const struct audio_data* audio, bool muted) {
+	if (!autoHighlights_ || muted) return;
+
+	HighlightDetector& detector = mic ? micHighlights_ : desktopHighlights_;
+	if (!detector.feed((const float* const*)audio->data, (int)audio_output_get_channels(obs_get_audio()), audio->frames)) return;
+
+	uint64_t now = scheduler_.nowMs();
+	uint64_t last = lastHighlightMs_;
+	if (last != 0 && now - last < HIGHLIGHT_COOLDOWN_MS) return;
+	// Desktop & mic can fire together, only one of them gets the save
+	if (!lastHighlightMs_.compare_exchange_strong(last, now)) return;
+
+	printf("CK::VID [HIGHLIGHT] %s audio spike, saving replay\n", mic ? "Mic" : "Desktop");
+	scheduler_.schedule(HIGHLIGHT_TAIL_MS, [this]() {
+		queueCommand([this]() { saveReplay(); });
+	});
+}
+
+bool VidCore::benchmarkHighlights(const std::string& wavPath) {
+	return HighlightDetector::benchmark(wavPath);
+}
+
+void VidCore::benchmarkSceneDetection(int frames) {
+	ChangeDetector::benchmark(frames);
+	logSceneStats();
+}
+
+void VidCore::benchmarkCodecs(int frames) {
+	// Best available encoder per codec, ranking is already best-first
+	std::vector<std::string> codecs;
+	std::vector<std::string> encoders;
+	for (const std::string& e : encoderRanking_) {
+		// First use for the lazily loaded ones, getCodec needs them registered
+		modules_.requireFor(e);
+		std::string codec = getCodec(e);
+		if (std::find(codecs.begin(), codecs.end(), codec) == codecs.end()) {
+			codecs.push_back(codec);
+			encoders.push_back(e);
+		}
+	}
+
+	// The replay encoder would share the hardware with the one under test, keep it off meanwhile
+	bool wasRecording = getState()->replayActive;
+	if (wasRecording) {
+		runCommand([this]() { stopReplay(); });
+	}
+
+	// Same clip & the same bitrate for every encoder, so the codecs differ in the quality they get
+	// out of it. The per-codec scaling the replay buffer applies would only echo its own table
+	PresetConfig cfg = getPresetConfig(getState()->preset);
+	std::shared_ptr<const State> state = getState();
+	int width = state->outputWidth > 0 ? state->outputWidth : 1920;
+	int height = state->outputHeight > 0 ? state->outputHeight : 1080;
+	for (size_t i = 0; i < encoders.size(); i++) {
+		std::string ffmpegEncoder = encode::ffmpegEncoderFor(encoders[i]);
+		if (ffmpegEncoder.empty()) {
+			printf("CK::VID [BENCH] No standalone encoder for %s!\n", encoders[i].c_str());
+			continue;
+		}
+		encode::BenchResult r;
+		if (!encode::benchmark(ffmpegEncoder, width, height, cfg.fps, frames, cfg.bitrate, r)) {
+			printf("CK::VID [BENCH] Unable to encode with %s!\n", ffmpegEncoder.c_str());
+			continue;
+		}
+		double seconds = (double)r.frames / cfg.fps;
+		printf("CK::VID [BENCH] codec=%s encoder=%s (%s) frames=%d %dx%d bytes=%llu kbps=%.0f psnr=%.2fdB encode=%.1fms (%.2fms/frame, %.1fx realtime) cpu=%.1fms\n",
+			codecs[i].c_str(), encoders[i].c_str(), ffmpegEncoder.c_str(), r.frames, width & ~1, height & ~1,
+			(unsigned long long)r.bytes, r.bytes * 8.0 / 1000.0 / seconds, r.psnr, r.wallMs, r.wallMs / r.frames,
+			seconds * 1000.0 / std::max(r.wallMs, 0.001), r.cpuMs);
+	}
+
+	if (wasRecording) {
+		runCommand([this]() { recordReplay(); });
+	}
+}
+
+propListInt VidCore::getAdapters() {
+	return getState()->adapters;
+}
+
+propListStr VidCore::getDisplayOpts() {
+	return getState()->displays;
+}
+
+propListStr VidCore::getSpeakerOpts() {
+	return getState()->speakers;
+}
+
+propListStr VidCore::getMicOpts() {
+	return getState()->mics;
+}
+
+// Called with vidMtx_ held, only copies what the registry already enumerated
+void VidCore::enumerateDevices(State& state) {
+	state.adapters.clear();
+	int i = 0;
+	for (auto& name : availableAdapters_) {
+		state.adapters.push_back(std::make_pair(name, i++));
+	}
+
+	DeviceRegistry::Lists lists = devices_.get();
+	state.displays = captureWindowMode_ ? lists.windows : lists.monitors;
+	state.speakers = lists.speakers;
+	state.mics = lists.mics;
+}
+
+void VidCore::setDevicesChangedCallback(std::function<void()> cb) {
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	devicesChanged_ = cb;
+}
+
+// Device switches are debounced, scrolling through a list only applies the last pick
+void VidCore::updateDisplay(const char* id) {
+	std::string device = id;
+	scheduler_.debounce("display", DEVICE_DEBOUNCE_MS, [this, device]() {
+		queueCommand([this, device]() {
+			const std::lock_guard<std::mutex> lock(vidMtx_);
+
+			const char* name = obs_source_get_name(disp_);
+			int isDisplayCapture = std::strcmp(name, "Display Capture") == 0;
+
+			OBSDataAutoRelease settings = obs_source_get_settings(disp_);
+			obs_data_set_string(settings, isDisplayCapture ? "monitor_id" : "window", device.c_str());
+			obs_source_update(disp_, settings);
+			// The new size is picked up by pollSourceSize once the source reports it
+		});
+	});
+}
+
+void VidCore::updateSpeaker(const char* id){
+	std::string device = id;
+	scheduler_.debounce("speaker", DEVICE_DEBOUNCE_MS, [this, device]() {
+		queueCommand([this, device]() {
+			const std::lock_guard<std::mutex> lock(vidMtx_);
+
+			OBSDataAutoRelease settings = obs_source_get_settings(sourceAud_);
+			obs_data_set_string(settings, "device_id", device.c_str());
+			obs_source_update(sourceAud_, settings);
+		});
+	});
+}
+
+void VidCore::updateMic(const char* id){
+	std::string device = id;
+	scheduler_.debounce("mic", DEVICE_DEBOUNCE_MS, [this, device]() {
+		queueCommand([this, device]() {
+			const std::lock_guard<std::mutex> lock(vidMtx_);
+
+			OBSDataAutoRelease settings = obs_source_get_settings(sourceMic_);
+			obs_data_set_string(settings, "device_id", device.c_str());
+			obs_source_update(sourceMic_, settings);
+		});
+	});
+}
+
+void VidCore::toggleSpeakerAudio(bool mute) {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+	if (!mute) {
+		obs_source_set_volume(sourceAud_, 1.0);
+	} else {
+		obs_source_set_volume(sourceAud_, 0.0);
+	}
+}
+
+void VidCore::toggleMicAudio(bool mute) {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+	if (!mute) {
+		obs_source_set_volume(sourceMic_, 1.0);
+	} else {
+		obs_source_set_volume(sourceMic_, 0.0);
+	}
+}
+
+bool VidCore::captureWindow() {
+	return switchCapture(true);
+}
+
+bool VidCore::captureMonitor() {
+	return switchCapture(false);
+}
+
+bool VidCore::switchCapture(bool windowMode) {
+	CaptureRegion canvas;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+
+		if (disp_ && captureWindowMode_ == windowMode) {
+			printf("CK::VID Already capturing %s\n", windowMode ? "window" : "monitor");
+			return true;
+		}
+		createDisplay(windowMode);
+		canvas = clampedRegion();
+
+		// Nothing to stop yet while the outputs are being (re)built
+		if (!replayBuffer_) {
+			return resetVideo(canvas.width, canvas.height);
+		}
+	}
+
+	// The new source has its own size, the outputs stop around the reset & come back after
+	bool ok = resizeCanvas(canvas.width, canvas.height);
+	printf("CK::VID Capturing %s, canvas %dx%d%s\n", windowMode ? "window" : "monitor",
+		canvas.width, canvas.height, ok ? "" : " FAILED");
+	return ok;
+}
+
+// Caller holds vidMtx_ & resets the canvas to the new source afterwards
+void VidCore::createDisplay(bool windowMode) {
+	captureWindowMode_ = windowMode;
+	if (syntheticSources_) {
+		addSyntheticDisplay(windowMode);
+		return;
+	}
+
+	if (windowMode) {
+		modules_.requireFor("window_capture");
+		disp_ = obs_source_create("window_capture", "Window Capture", NULL, nullptr);
+		attachDisplay();
+		initializeWindowCapture();
+	}
+	else {
+		modules_.requireFor("monitor_capture");
+		disp_ = obs_source_create("monitor_capture", "Display Capture", NULL, nullptr);
+		attachDisplay();
+		initializeDisplayCapture();
+	}
+	waitForDimensions(disp_, SOURCE_SIZE_TIMEOUT_MS);
+}
+
+void VidCore::addSyntheticDisplay(bool windowMode) {
+	// Monitor & window get different sizes so a switch exercises a real video reset
+	int width = windowMode ? SYNTHETIC_WIDTH * 2 / 3 : SYNTHETIC_WIDTH;
+	int height = windowMode ? SYNTHETIC_HEIGHT * 2 / 3 : SYNTHETIC_HEIGHT;
+
+	OBSDataAutoRelease settings = obs_data_create();
+	obs_data_set_int(settings, "width", width);
+	obs_data_set_int(settings, "height", height);
+	obs_data_set_int(settings, "color", windowMode ? 0xFF3060C0 : 0xFFC06030);
+	modules_.requireFor("color_source_v3");
+	disp_ = obs_source_create("color_source_v3", windowMode ? "Window Capture" : "Display Capture", settings, nullptr);
+	attachDisplay();
+}
+
+void VidCore::attachDisplay() {
+	if (!scene_) {
+		scene_ = obs_scene_create("Capture");
+	}
+	// Channels get cleared when sources are rebuilt
+	obs_set_output_source(1, obs_scene_get_source(scene_));
+
+	if (displayItem_) obs_sceneitem_remove(displayItem_);
+	displayItem_ = obs_scene_add(scene_, disp_);
+}
+
+// The region clamped to the source as it is now, or the whole source
+VidCore::CaptureRegion VidCore::clampedRegion() {
+	int sourceWidth = disp_ ? (int)obs_source_get_width(disp_) : 0;
+	int sourceHeight = disp_ ? (int)obs_source_get_height(disp_) : 0;
+	CaptureRegion full = { 0, 0, sourceWidth, sourceHeight };
+	if (region_.width <= 0 || region_.height <= 0 || sourceWidth < 2 || sourceHeight < 2) return full;
+
+	CaptureRegion r = region_;
+	r.x = std::clamp(r.x, 0, sourceWidth - 2);
+	r.y = std::clamp(r.y, 0, sourceHeight - 2);
+	// Even sizes, the canvas takes them as they are
+	r.width = std::max(2, std::min(r.width, sourceWidth - r.x) & ~1);
+	r.height = std::max(2, std::min(r.height, sourceHeight - r.y) & ~1);
+	return r;
+}
+
+void VidCore::applyRegion() {
+	if (!displayItem_) return;
+
+	CaptureRegion r = clampedRegion();
+	trackedWidth_ = obs_source_get_width(disp_);
+	trackedHeight_ = obs_source_get_height(disp_);
+	struct obs_sceneitem_crop crop;
+	crop.left = r.x;
+	crop.top = r.y;
+	crop.right = std::max(0, (int)obs_source_get_width(disp_) - r.x - r.width);
+	crop.bottom = std::max(0, (int)obs_source_get_height(disp_) - r.y - r.height);
+
+	// Scaled into the canvas & centered, other shapes get bars instead of a video reset
+	struct vec2 pos;
+	struct vec2 bounds;
+	vec2_set(&pos, 0.0f, 0.0f);
+	vec2_set(&bounds, (float)ovi_.base_width, (float)ovi_.base_height);
+
+	obs_sceneitem_defer_update_begin(displayItem_);
+	obs_sceneitem_set_crop(displayItem_, &crop);
+	obs_sceneitem_set_pos(displayItem_, &pos);
+	obs_sceneitem_set_alignment(displayItem_, OBS_ALIGN_LEFT | OBS_ALIGN_TOP);
+	obs_sceneitem_set_bounds_type(displayItem_, OBS_BOUNDS_SCALE_INNER);
+	obs_sceneitem_set_bounds_alignment(displayItem_, 0); // Centered
+	obs_sceneitem_set_bounds(displayItem_, &bounds);
+	obs_sceneitem_defer_update_end(displayItem_);
+}
+
+bool VidCore::fitsCanvas(const CaptureRegion& region, double tolerance) {
+	if (region.width <= 0 || region.height <= 0 || !ovi_.base_width || !ovi_.base_height) return false;
+	double shape = (double)region.width / region.height;
+	double current = (double)ovi_.base_width / ovi_.base_height;
+	return std::abs(shape - current) <= current * tolerance;
+}
+
+// libobs won't reset video under active outputs, they come back up right after
+bool VidCore::resizeCanvas(int width, int height) {
+	bool wasRecording = isReplayBufferActive_;
+
+	// Stop outputs
+	stopReplay();
+	saveLive();
+	waitForOutputsStopped();
+
+	bool ok = resetVideo(width, height);
+	startEncoders();
+
+	if (wasRecording) {
+		recordReplay();
+	}
+	return ok;
+}
+
+void VidCore::pollSourceSize() {
+	std::unique_lock<std::mutex> lock(vidMtx_, std::try_to_lock);
+	if (!lock.owns_lock() || !disp_) return;
+
+	uint32_t width = obs_source_get_width(disp_);
+	uint32_t height = obs_source_get_height(disp_);
+	// Minimized windows report 0x0, keep the last real size
+	if (!width || !height) return;
+	if (width == trackedWidth_ && height == trackedHeight_) return;
+
+	trackedWidth_ = width;
+	trackedHeight_ = height;
+	scheduler_.debounce("source-resize", RESIZE_SETTLE_MS, [this]() {
+		queueCommand([this]() { applySourceResize(); });
+	});
+}
+
+// Runs once per settled size. The same shape is rescaled into the canvas with the outputs running,
+// a new shape gets a canvas of its own rather than encoding bars for the rest of the session
+void VidCore::applySourceResize() {
+	CaptureRegion canvas;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+		if (!disp_) return;
+		canvas = clampedRegion();
+		if (canvas.width <= 0 || canvas.height <= 0) return;
+
+		if (fitsCanvas(canvas, RESIZE_ASPECT_TOLERANCE)) {
+			applyRegion();
+			printf("CK::VID [RESIZE] source %ux%u scaled into the %ux%u canvas\n",
+				trackedWidth_, trackedHeight_, ovi_.base_width, ovi_.base_height);
+			return;
+		}
+	}
+
+	// Cycles the outputs around the video reset
+	bool ok = resizeCanvas(canvas.width, canvas.height);
+	printf("CK::VID [RESIZE] source %ux%u changed shape, canvas reset to %dx%d%s\n",
+		trackedWidth_, trackedHeight_, canvas.width, canvas.height, ok ? "" : " FAILED");
+}
+
+bool VidCore::setCaptureRegion(const CaptureRegion& region) {
+	CaptureRegion r;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+		CaptureRegion before = clampedRegion();
+		region_ = region;
+		// Not initialized yet, the first capture sizes the canvas to it
+		if (!replayBuffer_) return true;
+
+		// Same size, only the crop moves, the outputs keep running
+		r = clampedRegion();
+		bool sameSize = r.width == before.width && r.height == before.height;
+		if (sameSize || (r.width == (int)ovi_.base_width && r.height == (int)ovi_.base_height)) {
+			applyRegion();
+			printf("CK::VID [REGION] %dx%d+%d+%d in the %ux%u canvas\n",
+				r.width, r.height, r.x, r.y, ovi_.base_width, ovi_.base_height);
+			return true;
+		}
+	}
+
+	// A new size gets a canvas of its own, a smaller crop renders & encodes fewer pixels
+	bool ok = resizeCanvas(r.width, r.height);
+	printf("CK::VID [REGION] %dx%d+%d+%d, canvas reset%s\n", r.width, r.height, r.x, r.y, ok ? "" : " FAILED");
+	return ok;
+}
+
+bool VidCore::fitCanvas() {
+	CaptureRegion canvas;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+		if (!replayBuffer_ || !disp_) return false;
+		canvas = clampedRegion();
+		if (canvas.width <= 0 || canvas.height <= 0) return false;
+		if (canvas.width == (int)ovi_.base_width && canvas.height == (int)ovi_.base_height) return true;
+	}
+
+	// The encoder bitrate follows the pixels
+	bool ok = resizeCanvas(canvas.width, canvas.height);
+	printf("CK::VID [REGION] canvas reset to %dx%d%s\n", canvas.width, canvas.height, ok ? "" : " FAILED");
+	return ok;
+}
+
+void VidCore::initializeDisplayCapture() {
+	// Select the first monitor available
+	propListStr monitors = devices_.get().monitors;
+	std::string devId = monitors.empty() ? firstListItem("monitor_capture", "monitor_id") : monitors[0].second;
+
+	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
+	obs_data_set_int(settings, "method", 0); // AUTO
+	obs_data_set_string(settings, "monitor_id", devId.c_str());
+	obs_source_update(disp_, settings);
+}
+
+void VidCore::initializeWindowCapture() {
+	// Select the first window available
+	propListStr windows = devices_.get().windows;
+	std::string devId = windows.empty() ? firstListItem("window_capture", "window") : windows[0].second;
+
+	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
+	obs_data_set_int(settings, "method", 2); // WGC
+	obs_data_set_string(settings, "window", devId.c_str());
+	obs_data_set_bool(settings, "client_area", false);
+	obs_source_update(disp_, settings);
+}
+
+bool VidCore::recordReplay() {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+	if (isReplayBufferActive_) { return false; } // Already Started
+
+	configureBuffer();
+
+	bool started = obs_output_start(replayBuffer_);
+	// Encoder init failures only surface here, walk down to H.264
+	while (!started && fallbackEncoder()) {
+		startEncoders();
+		started = obs_output_start(replayBuffer_);
+	}
+	if (!started) {
+		printf("CK::VID Unable to start replay buffer!\n");
+		return false;
+	}
+
+	isReplayBufferActive_ = true;
+	watchdog_.lastProgressMs = 0;
+	return true;
+}
+
+void VidCore::stopReplay() {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+
+	if (!isReplayBufferActive_) { return; }
+
+	obs_output_stop(replayBuffer_);
+	isReplayBufferActive_ = false;
+}
+
+void VidCore::saveReplay(int seconds, uint64_t pressNs) {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+
+	if (!isReplayBufferActive_) { return; } // Replay Buffer Inactive
+
+	calldata_t cd = { 0 };
+	calldata_set_int(&cd, "seconds", seconds > 0 ? seconds : replaySeconds_);
+	calldata_set_int(&cd, "press_ns", (long long)pressNs);
+	calldata_set_int(&cd, "end_offset_ms", hotkeySaveOffsetMs_);
+	proc_handler_t* ph =
+		obs_output_get_proc_handler(replayBuffer_);
+	proc_handler_call(ph, "save", &cd);
+	calldata_free(&cd);
+
+	acm_->playSaveReplay();
+}
+
+void VidCore::toggleRecordLive() {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+
+	if (isLiveActive_) {
+		saveLive();
+	}
+	else {
+		recordLive();
+	}
+}
+
+bool VidCore::recordLive() {
+	if (isLiveActive_) { return false; } // Already Started
+
+	configureLive();
+	mp4::markPartial(lastRecordingLive_);
+
+	if (!obs_output_start(fileOutput_)) {
+		printf("CK::VID Unable to start live recording!\n");
+		mp4::clearPartial(lastRecordingLive_);
+		return false;
+	}
+
+	// 30s Max
+	uint64_t session = ++liveSession_;
+	liveCapTimer_ = scheduler_.schedule(LIVE_MAX_MS, [this, session]() {
+		queueCommand([this, session]() {
+			const std::lock_guard<std::mutex> lock(vidMtx_);
+			// A stop & restart queued ahead of this makes it stale
+			if (!isLiveActive_ || liveSession_ != session) return;
+			saveLive();
+		});
+	});
+
+	isLiveActive_ = true;
+	acm_->playStartLive();
+	return true;
+}
+
+void VidCore::saveLive() {
+	if (!isLiveActive_) { return; } // Not recording
+
+	scheduler_.cancel(liveCapTimer_);
+	liveCapTimer_ = Scheduler::INVALID_TIMER;
+	obs_output_stop(fileOutput_);
+
+	isLiveActive_ = false;
+	acm_->playStopLive();
+}
+
+void VidCore::handleReplaySaved(const std::string& filePath) {
+	{
+		const std::lock_guard<std::mutex> lock(listenerMtx_);
+		if (replaySaved_) replaySaved_(filePath);
+	}
+	if (health_.replaySaves) health_.replaySaves->add();
+	uploadVideo(filePath);
+}
+
+void VidCore::handleHotkeySaved(uint64_t pressNs, int64_t endErrorUsec) {
+	uint64_t elapsedNs = os_gettime_ns() - pressNs;
+	double elapsed = elapsedNs / 1000000.0;
+	printf("CK::VID [HOTKEY] press to saved replay %.1fms, clip end %+.1fms from target\n", elapsed, endErrorUsec / 1000.0);
+	if (health_.hotkeySaveTime) health_.hotkeySaveTime->record(elapsedNs);
+
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	lastHotkeySave_.pressToSavedMs = elapsed;
+	lastHotkeySave_.endErrorMs = endErrorUsec / 1000.0;
+}
+
+VidCore::HotkeySave VidCore::getLastHotkeySave() {
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	return lastHotkeySave_;
+}
+
+void VidCore::setReplaySavedCallback(std::function<void(const std::string&)> cb) {
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	replaySaved_ = cb;
+}
+
+VidCore::FrameStats VidCore::getFrameStats() {
+	FrameStats stats = {};
+	stats.totalFrames = obs_get_total_frames();
+	stats.laggedFrames = obs_get_lagged_frames();
+	video_t* video = obs_get_video();
+	if (video) {
+		stats.skippedFrames = video_output_get_skipped_frames(video);
+	}
+	if (replayBuffer_) {
+		stats.droppedFrames = obs_output_get_frames_dropped(replayBuffer_);
+	}
+	stats.staticFrames = sceneStaticFrames_;
+	return stats;
+}
+
+void VidCore::setGraphicsModule(const std::string& module) {
+	if (replayBuffer_) return; // Already booted
+	graphicsModule_ = module;
+}
+
+void VidCore::setMetricsPort(int port) {
+	if (replayBuffer_) return;
+	metricsPort_ = port;
+}
+
+std::string VidCore::getMetricsSummary() {
+	return metrics_.renderSummary();
+}
+
+void VidCore::initMetrics() {
+	HealthMetrics& m = health_;
+	m.renderFrames = metrics_.counter("ck_render_frames_total", "Frames rendered by libobs");
+	m.laggedFrames = metrics_.counter("ck_render_lagged_frames_total", "Frames that missed their render slot");
+	m.encodedFrames = metrics_.counter("ck_encode_frames_total", "Frames handed to the video encoders");
+	m.skippedFrames = metrics_.counter("ck_encode_skipped_frames_total", "Frames skipped because encoding fell behind");
+	m.droppedFrames = metrics_.counter("ck_output_dropped_frames_total", "Frames dropped by the replay output");
+	m.outputBytes = metrics_.counter("ck_output_bytes_total", "Encoded bytes received by the replay output");
+	m.replaySaves = metrics_.counter("ck_replay_saves_total", "Replays written to disk");
+	m.recoveredRecordings = metrics_.counter("ck_recovered_recordings_total", "Interrupted live recordings made playable at startup");
+	m.recoveries = metrics_.counter("ck_watchdog_recoveries_total", "Replay buffer restarts after an encoder stall or failure");
+	m.recoveryFailures = metrics_.counter("ck_watchdog_recovery_failures_total", "Restarts that ran out of encoders or time");
+	m.frameTime = metrics_.gauge("ck_render_frame_time_seconds", "Average libobs frame render time");
+	m.bitrateKbps = metrics_.gauge("ck_output_bitrate_kbps", "Replay output bitrate over the last sample");
+	m.congestion = metrics_.gauge("ck_output_congestion", "Replay output congestion, 0 to 1");
+	m.bufferMemory = metrics_.gauge("ck_replay_buffer_bytes", "Replay history held", "tier=\"memory\"");
+	m.bufferDisk = metrics_.gauge("ck_replay_buffer_bytes", "Replay history held", "tier=\"disk\"");
+	m.bufferFill = metrics_.gauge("ck_replay_buffer_fill_ratio", "Replay history held against the configured length");
+	m.staticScene = metrics_.gauge("ck_scene_static", "1 while the static-scene bitrate is in effect");
+	m.frameTimeSamples = metrics_.histogram("ck_render_frame_time_sample_seconds", "Average frame time, one sample per second");
+	m.recoveryTime = metrics_.histogram("ck_watchdog_recovery_seconds", "Failure detected to the first packet from the rebuilt encoder");
+	m.hotkeySaveTime = metrics_.histogram("ck_hotkey_save_seconds", "Hotkey press to the saved replay file");
+	pipeline_.registerMetrics(metrics_);
+	WriteBehindFile::registerMetrics(metrics_);
+
+	metricsTimer_ = scheduler_.scheduleEvery(METRICS_SAMPLE_MS, [this]() { sampleMetrics(); });
+	watchdogTimer_ = scheduler_.scheduleEvery(WATCHDOG_SAMPLE_MS, [this]() { watchdogTick(); });
+	if (metricsPort_ > 0) {
+		metricsServer_.start(&metrics_, (uint16_t)metricsPort_);
+	}
+}
+
+void VidCore::sampleMetrics() {
+	HealthMetrics& m = health_;
+
+	m.renderFrames->addSample(obs_get_total_frames(), m.lastRender);
+	m.laggedFrames->addSample(obs_get_lagged_frames(), m.lastLagged);
+	video_t* video = obs_get_video();
+	if (video) {
+		m.encodedFrames->addSample(video_output_get_total_frames(video), m.lastEncoded);
+		m.skippedFrames->addSample(video_output_get_skipped_frames(video), m.lastSkipped);
+	}
+	uint64_t frameNs = obs_get_average_frame_time_ns();
+	m.frameTime->set(frameNs / 1e9);
+	m.frameTimeSamples->record(frameNs);
+	m.staticScene->set(sceneStatic_ ? 1.0 : 0.0);
+
+	// Outputs get swapped during a reconfiguration, skip this sample rather than wait it out
+	std::unique_lock<std::mutex> lock(vidMtx_, std::try_to_lock);
+	if (!lock.owns_lock() || !replayBuffer_) return;
+
+	uint64_t now = scheduler_.nowMs();
+	uint64_t prevBytes = m.lastBytes;
+	uint64_t bytes = obs_output_get_total_bytes(replayBuffer_);
+	m.outputBytes->addSample(bytes, m.lastBytes);
+	if (m.lastSampleMs && now > m.lastSampleMs && bytes >= prevBytes) {
+		// bytes * 8 / ms is kbit/s
+		m.bitrateKbps->set((bytes - prevBytes) * 8.0 / (now - m.lastSampleMs));
+	}
+	m.lastSampleMs = now;
+	m.droppedFrames->addSample((uint64_t)std::max(0, obs_output_get_frames_dropped(replayBuffer_)), m.lastDropped);
+	m.congestion->set(obs_output_get_congestion(replayBuffer_));
+
+	calldata_t cd = { 0 };
+	proc_handler_t* ph = obs_output_get_proc_handler(replayBuffer_);
+	if (proc_handler_call(ph, "get_stats", &cd)) {
+		long long maxMs = calldata_int(&cd, "max_ms");
+		m.bufferMemory->set((double)calldata_int(&cd, "memory_bytes"));
+		m.bufferDisk->set((double)calldata_int(&cd, "disk_bytes"));
+		m.bufferFill->set(maxMs > 0 ? std::min(1.0, (double)calldata_int(&cd, "span_ms") / maxMs) : 0.0);
+	}
+	calldata_free(&cd);
+}
+
+/////////////////////////////////////////////////////
+// ENCODER WATCHDOG
+/////////////////////////////////////////////////////
+
+// Caller holds vidMtx_
+uint64_t VidCore::replayVideoPackets() {
+	calldata_t cd = { 0 };
+	proc_handler_t* ph = obs_output_get_proc_handler(replayBuffer_);
+	uint64_t packets = 0;
+	if (proc_handler_call(ph, "get_stats", &cd)) {
+		packets = (uint64_t)calldata_int(&cd, "video_packets");
+	}
+	calldata_free(&cd);
+	return packets;
+}
+
+void VidCore::watchdogTick() {
+	// Reconfigurations hold the lock, they re-arm the watchdog when they start the output
+	std::unique_lock<std::mutex> lock(vidMtx_, std::try_to_lock);
+	if (!lock.owns_lock() || !replayBuffer_) return;
+	if (!isReplayBufferActive_ || recoveryPending_) {
+		watchdog_.lastProgressMs = 0;
+		return;
+	}
+
+	uint64_t packets = replayVideoPackets();
+	uint64_t now = scheduler_.nowMs();
+	if (!watchdog_.lastProgressMs) {
+		watchdog_.lastPackets = packets;
+		watchdog_.lastProgressMs = now;
+		return;
+	}
+
+	if (packets != watchdog_.lastPackets) {
+		watchdog_.lastPackets = packets;
+		watchdog_.lastProgressMs = now;
+		if (watchdog_.recovering) {
+			watchdog_.recovering = false;
+			uint64_t elapsed = now - recoveryStartMs_;
+			if (health_.recoveryTime) health_.recoveryTime->record(elapsed * 1000000);
+			printf("CK::VID Replay buffer recovered in %llums on %s\n",
+				(unsigned long long)elapsed, encoderString_.c_str());
+		}
+		return;
+	}
+
+	if (now - watchdog_.lastProgressMs >= WATCHDOG_STALL_MS) {
+		triggerRecovery("stalled");
+	}
+}
+
+void VidCore::handleReplayStopped(int code) {
+	if (code == OBS_OUTPUT_SUCCESS) return;
+	printf("CK::VID Replay buffer stopped with code %d\n", code);
+	triggerRecovery("failed");
+}
+
+void VidCore::triggerRecovery(const char* reason) {
+	if (recoveryPending_.exchange(true)) return; // One rebuild at a time
+	recoveryStartMs_ = scheduler_.nowMs();
+	printf("CK::VID Replay buffer %s, rebuilding encoders\n", reason);
+	queueCommand([this]() { recoverOutputs(); });
+}
+
+void VidCore::recoverOutputs() {
+	uint64_t begin = recoveryStartMs_;
+	bool repeat;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+		// Stopped by the user in the meantime, there is nothing to bring back
+		if (!replayBuffer_ || !isReplayBufferActive_) {
+			recoveryPending_ = false;
+			return;
+		}
+		repeat = watchdog_.lastRecoveryMs && begin - watchdog_.lastRecoveryMs < RECOVERY_REPEAT_MS;
+		watchdog_.lastRecoveryMs = begin;
+
+		// A live recording shares the video encoder, keep what it has so far
+		saveLive();
+		obs_output_force_stop(replayBuffer_);
+		isReplayBufferActive_ = false;
+	}
+	waitForOutputsStopped();
+
+	bool started = false;
+	{
+		const std::lock_guard<std::mutex> lock(vidMtx_);
+		// The same encoder usually comes back after a driver reset, failing again this soon means it won't
+		if (repeat) fallbackEncoder();
+		while (true) {
+			startEncoders();
+			configureBuffer();
+			started = obs_output_start(replayBuffer_);
+			if (started || scheduler_.nowMs() - begin > RECOVERY_BUDGET_MS) break;
+			if (!fallbackEncoder()) break;
+		}
+
+		isReplayBufferActive_ = started;
+		watchdog_.lastPackets = replayVideoPackets();
+		watchdog_.lastProgressMs = scheduler_.nowMs();
+		watchdog_.recovering = started;
+		if (started) watchdog_.recoveries++;
+	}
+
+	if (started) {
+		if (health_.recoveries) health_.recoveries->add();
+	}
+	else {
+		if (health_.recoveryFailures) health_.recoveryFailures->add();
+		printf("CK::VID Unable to recover replay buffer after %llums\n",
+			(unsigned long long)(scheduler_.nowMs() - begin));
+	}
+	recoveryPending_ = false;
+}
+
+// The same stop a failed encode raises, so the stop signal drives the real rebuild & fallback
+bool VidCore::injectEncoderFailure() {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+	if (!isReplayBufferActive_ || recoveryPending_) return false;
+
+	printf("CK::VID Injecting encoder failure on %s\n", encoderString_.c_str());
+	obs_output_signal_stop(replayBuffer_, OBS_OUTPUT_ENCODE_ERROR);
+	return true;
+}
+
+void VidCore::setSyntheticSources(bool synthetic) {
+	if (replayBuffer_) return;
+	syntheticSources_ = synthetic;
+}
+
+void VidCore::resizeSyntheticDisplay(int width, int height) {
+	const std::lock_guard<std::mutex> lock(vidMtx_);
+	if (!syntheticSources_ || !disp_) return;
+
+	OBSDataAutoRelease settings = obs_source_get_settings(disp_);
+	obs_data_set_int(settings, "width", width);
+	obs_data_set_int(settings, "height", height);
+	obs_source_update(disp_, settings);
+}
+
+std::string VidCore::getLastLive() {
+	return lastRecordingLive_;
+}
+
+std::string VidCore::getLastReplay() {
+	calldata_t cd = { 0 };
+	proc_handler_t* ph =
+		obs_output_get_proc_handler(replayBuffer_);
+
+	proc_handler_call(ph, "get_last_replay", &cd);
+	const char* path = calldata_string(&cd, "path");
+	std::string strPath = std::string(path);
+	calldata_free(&cd);
+	return strPath;
+}
+
+// Live recordings cut off by a crash, made playable and sent through the pipeline like any other
+void VidCore::recoverRecordings() {
+	auto begin = std::chrono::steady_clock::now();
+	RecoveryStats stats = {};
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(acm_->getVideoDir(), ec)) {
+		std::string marker = entry.path().string();
+		const std::string suffix = ".partial";
+		if (marker.size() <= suffix.size() || marker.compare(marker.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+
+		std::string filePath = marker.substr(0, marker.size() - suffix.size());
+		stats.found++;
+		if (mp4::recoverFragmented(filePath)) {
+			stats.recovered++;
+			uploadVideo(filePath);
+		}
+		// Unrecoverable files stay where they are, only the marker goes
+		mp4::clearPartial(filePath);
+	}
+
+	stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	if (health_.recoveredRecordings) health_.recoveredRecordings->add(stats.recovered);
+	if (stats.found) {
+		printf("CK::VID Recovered %d of %d interrupted recordings in %.1fms\n", stats.recovered, stats.found, stats.ms);
+	}
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	recoveryStats_ = stats;
+}
+
+VidCore::RecoveryStats VidCore::getRecoveryStats() {
+	const std::lock_guard<std::mutex> lock(listenerMtx_);
+	return recoveryStats_;
+}
+
+void VidCore::uploadVideo(std::string filePath) {
+	pipeline_.enqueue(filePath);
+}
+
+// Trimmed copies & thumbnails only exist to be uploaded, the saved file stays.
+// Called on every path a job leaves the pipeline after FINALIZE, uploaded or not
+static void deleteUploadFiles(const PostSavePipeline::Job& job) {
+	if (job.uploadPath != job.filePath) {
+		DeleteFileA(job.uploadPath.c_str());
+	}
+	if (!job.thumbPath.empty()) {
+		DeleteFileA(job.thumbPath.c_str());
+		DeleteFileA(job.spritePath.c_str());
+	}
+}
+
+void VidCore::initPipeline() {
+	typedef PostSavePipeline::Job Job;
+
+	// File is complete on disk, cut down to what gets uploaded
+	pipeline_.setStage(PostSavePipeline::FINALIZE, 1, 32, [this](Job& job) {
+		WIN32_FILE_ATTRIBUTE_DATA attrs = {};
+		if (!GetFileAttributesExA(job.filePath.c_str(), GetFileExInfoStandard, &attrs)
+			|| (attrs.nFileSizeHigh == 0 && attrs.nFileSizeLow == 0)) {
+			printf("CK::VID Saved file missing or empty: %s\n", job.filePath.c_str());
+			return false;
+		}
+
+		int trim = uploadTrimSeconds_;
+		if (trim > 0) {
+			// Only the tail goes up, keep the full file locally
+			std::string trimmed = trimClip(job.filePath, trim);
+			if (!trimmed.empty()) {
+				job.uploadPath = trimmed;
+			}
+		}
+		return true;
+	});
+
+	// Moov first so playback can start before the whole file is fetched, upload the original on failure
+	pipeline_.setStage(PostSavePipeline::FASTSTART, 1, 8, [](Job& job) {
+		mp4::faststart(job.uploadPath);
+		return true;
+	});
+
+	// Server falls back to its own thumbnail job when this fails
+	pipeline_.setStage(PostSavePipeline::THUMBNAIL, 1, 8, [](Job& job) {
+		thumb::Result res;
+		if (thumb::generate(job.uploadPath, res)) {
+			job.thumbPath = res.posterPath;
+			job.spritePath = res.spritePath;
+		}
+		return true;
+	});
+
+	// Network bound, a couple in flight
+	pipeline_.setStage(PostSavePipeline::UPLOAD, 2, 8, [this](Job& job) {
+		// Nothing to retry without an account
+		if (!acm_->isLoggedIn()) {
+			deleteUploadFiles(job);
+			return false;
+		}
+
+		std::string url;
+		if (!acm_->stageUpload(true, job.stageId, url) || !acm_->uploadStaged(url, job.uploadPath)) {
+			// Back off on the scheduler instead of holding an upload worker
+			if (++job.uploadAttempts < UPLOAD_ATTEMPTS) {
+				uint64_t delayMs = UPLOAD_RETRY_MS << (job.uploadAttempts - 1);
+				printf("CK::VID Upload failed, retrying %s in %llus\n", job.uploadPath.c_str(), (unsigned long long)(delayMs / 1000));
+				scheduler_.schedule(delayMs, [this, job]() {
+					if (!pipeline_.resubmit(PostSavePipeline::UPLOAD, job)) {
+						deleteUploadFiles(job);
+					}
+				});
+			}
+			else {
+				deleteUploadFiles(job);
+			}
+			return false;
+		}
+		if (!job.thumbPath.empty()) {
+			job.thumbsUploaded = acm_->uploadThumbnails(job.stageId, job.thumbPath, job.spritePath);
+		}
+		return true;
+	});
+
+	pipeline_.setStage(PostSavePipeline::NOTIFY, 1, 8, [this](Job& job) {
+		bool ok = acm_->notifyUploaded(job.stageId, job.thumbsUploaded);
+		deleteUploadFiles(job);
+		return ok;
+	});
+
+	pipeline_.start();
+}
+
+std::string VidCore::trimClip(const std::string& filePath, int lastSeconds) {
+	// Saves within the same second share a timestamp, the sequence keeps their trims apart
+	static std::atomic<uint32_t> trimSeq(0);
+	std::string outPath = acm_->getVideoDir() + "CKTRIM_" + webapi::getTimestamp() + "_" + std::to_string(trimSeq++) + ".mp4";
+	if (!clip::trim(filePath, outPath, lastSeconds)) {
+		printf("CK::VID Failed to trim %s\n", filePath.c_str());
+		return "";
+	}
+	return outPath;
+}
+
+std::string VidCore::concatClips(const std::vector<std::string>& filePaths) {
+	static std::atomic<uint32_t> concatSeq(0);
+	std::string outPath = acm_->getVideoDir() + "CKCAT_" + webapi::getTimestamp() + "_" + std::to_string(concatSeq++) + ".mp4";
+	if (!clip::concat(filePaths, outPath)) {
+		printf("CK::VID Failed to join clips\n");
+		return "";
+	}
+	return outPath;
+}
+
+void VidCore::setUploadTrim(int seconds) {
+	uploadTrimSeconds_ = std::max(0, seconds);
+}
+
+int VidCore::getUploadTrim() {
+	return getState()->uploadTrimSeconds;
+}
+
+void VidCore::setHotkeySaveOffset(int ms) {
+	hotkeySaveOffsetMs_ = std::max(-HOTKEY_OFFSET_MAX_MS, std::min(ms, HOTKEY_OFFSET_MAX_MS));
+}
+
+int VidCore::getHotkeySaveOffset() {
+	return hotkeySaveOffsetMs_;
+}
+
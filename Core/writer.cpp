@@ -0,0 +1,358 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "writer.h"
+#include "threads.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+LatencyHistogram WriteBehindFile::writeLatency_;
+LatencyHistogram WriteBehindFile::flushLatency_;
+
+static uint8_t* alignedAlloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return (uint8_t*)_aligned_malloc(size, alignment);
+#else
+	void* p = nullptr;
+	return posix_memalign(&p, alignment, size) == 0 ? (uint8_t*)p : nullptr;
+#endif
+}
+
+static void alignedFree(uint8_t* p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+static uint64_t nowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+WriteBehindFile::WriteBehindFile() {
+#ifdef _WIN32
+	file_ = INVALID_HANDLE_VALUE;
+#else
+	fd_ = -1;
+#endif
+	closing_ = false;
+	failed_ = false;
+	current_ = -1;
+	pos_ = 0;
+	end_ = 0;
+}
+
+WriteBehindFile::~WriteBehindFile() {
+	close();
+}
+
+bool WriteBehindFile::isOpen() {
+#ifdef _WIN32
+	return file_ != INVALID_HANDLE_VALUE;
+#else
+	return fd_ >= 0;
+#endif
+}
+
+bool WriteBehindFile::open(const std::string& path, uint64_t expectedSize) {
+	close();
+
+#ifdef _WIN32
+	file_ = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+	fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	if (!isOpen()) {
+		printf("CK::WRITER Failed to create %s\n", path.c_str());
+		return false;
+	}
+	path_ = path;
+
+	// Reserve the clusters up front, the file's size only grows as data lands
+	if (expectedSize > 0) {
+#ifdef _WIN32
+		FILE_ALLOCATION_INFO alloc;
+		alloc.AllocationSize.QuadPart = (LONGLONG)expectedSize;
+		bool reserved = SetFileInformationByHandle(file_, FileAllocationInfo, &alloc, sizeof(alloc)) != 0;
+#elif defined(__linux__)
+		bool reserved = fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, (off_t)expectedSize) == 0;
+#else
+		bool reserved = posix_fallocate(fd_, 0, (off_t)expectedSize) == 0;
+#endif
+		if (!reserved) {
+			printf("CK::WRITER Unable to preallocate %llu bytes for %s, writing without\n",
+				(unsigned long long)expectedSize, path.c_str());
+		}
+	}
+
+	buffers_.clear();
+	free_.clear();
+	pending_.clear();
+	for (int i = 0; i < BUFFER_COUNT; i++) {
+		Buffer b = { alignedAlloc(BUFFER_SIZE, ALIGNMENT), 0, 0 };
+		if (!b.data) {
+			printf("CK::WRITER Out of memory for write buffers!\n");
+			close();
+			return false;
+		}
+		buffers_.push_back(b);
+		free_.push_back(i);
+	}
+
+	closing_ = false;
+	failed_ = false;
+	current_ = -1;
+	pos_ = 0;
+	end_ = 0;
+	io_ = std::thread(&WriteBehindFile::ioLoop, this);
+	return true;
+}
+
+bool WriteBehindFile::write(const uint8_t* data, size_t size) {
+	uint64_t begin = nowNs();
+
+	while (size > 0) {
+		if (current_ < 0) {
+			// Wait for the I/O thread to hand a buffer back
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return !free_.empty() || failed_; });
+			if (failed_) return false;
+			current_ = free_.front();
+			free_.pop_front();
+			buffers_[current_].used = 0;
+			buffers_[current_].offset = pos_;
+		}
+
+		Buffer& b = buffers_[current_];
+		size_t n = std::min(size, BUFFER_SIZE - b.used);
+		memcpy(b.data + b.used, data, n);
+		b.used += n;
+		data += n;
+		size -= n;
+		pos_ += n;
+		end_ = std::max(end_, pos_);
+
+		if (b.used == BUFFER_SIZE) queueCurrent();
+	}
+
+	writeLatency_.record(nowNs() - begin);
+	return true;
+}
+
+void WriteBehindFile::seek(uint64_t offset) {
+	if (offset == pos_) return;
+	if (current_ >= 0) {
+		if (buffers_[current_].used > 0) {
+			queueCurrent();
+		}
+		else {
+			buffers_[current_].offset = offset;
+		}
+	}
+	pos_ = offset;
+}
+
+void WriteBehindFile::queueCurrent() {
+	if (current_ < 0) return;
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		pending_.push_back(current_);
+	}
+	current_ = -1;
+	cv_.notify_all();
+}
+
+// Buffers go out in the order they were queued, a header patched after a seek back lands last
+void WriteBehindFile::ioLoop() {
+	// Left at normal priority, a replay save waits on it
+	threads::apply(threads::NORMAL, "ck-writer");
+	while (true) {
+		int idx;
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this]() { return !pending_.empty() || closing_; });
+			if (pending_.empty()) return; // Closing & drained
+			idx = pending_.front();
+			pending_.pop_front();
+		}
+
+		Buffer& b = buffers_[idx];
+		uint64_t begin = nowNs();
+		bool ok = writeAt(b.data, b.used, b.offset);
+		flushLatency_.record(nowNs() - begin);
+
+		{
+			const std::lock_guard<std::mutex> lock(mtx_);
+			if (!ok) failed_ = true;
+			free_.push_back(idx);
+		}
+		cv_.notify_all();
+	}
+}
+
+bool WriteBehindFile::writeAt(const uint8_t* data, size_t size, uint64_t offset) {
+#ifdef _WIN32
+	while (size > 0) {
+		OVERLAPPED ov = {};
+		ov.Offset = (DWORD)offset;
+		ov.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD written = 0;
+		if (!WriteFile(file_, data, (DWORD)size, &written, &ov) || written == 0) {
+			printf("CK::WRITER Write failed on %s: %lu\n", path_.c_str(), GetLastError());
+			return false;
+		}
+		data += written;
+		size -= written;
+		offset += written;
+	}
+#else
+	while (size > 0) {
+		ssize_t written = pwrite(fd_, data, size, (off_t)offset);
+		if (written <= 0) {
+			printf("CK::WRITER Write failed on %s\n", path_.c_str());
+			return false;
+		}
+		data += written;
+		size -= (size_t)written;
+		offset += (uint64_t)written;
+	}
+#endif
+	return true;
+}
+
+bool WriteBehindFile::close() {
+	if (!isOpen()) return !failed_;
+
+	queueCurrent();
+	{
+		const std::lock_guard<std::mutex> lock(mtx_);
+		closing_ = true;
+	}
+	cv_.notify_all();
+	if (io_.joinable()) {
+		io_.join();
+	}
+
+	// Hand back whatever the preallocation reserved past the end
+#ifdef _WIN32
+	FILE_END_OF_FILE_INFO eof;
+	eof.EndOfFile.QuadPart = (LONGLONG)end_;
+	SetFileInformationByHandle(file_, FileEndOfFileInfo, &eof, sizeof(eof));
+#else
+	if (ftruncate(fd_, (off_t)end_) != 0) {
+		printf("CK::WRITER Unable to trim %s\n", path_.c_str());
+	}
+#endif
+	closeHandle();
+
+	for (Buffer& b : buffers_) {
+		alignedFree(b.data);
+	}
+	buffers_.clear();
+	free_.clear();
+	return !failed_;
+}
+
+void WriteBehindFile::closeHandle() {
+#ifdef _WIN32
+	if (file_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+#endif
+}
+
+/////////////////////////////////////////////////////
+// METRICS & BENCHMARK
+/////////////////////////////////////////////////////
+
+void WriteBehindFile::registerMetrics(MetricsRegistry& registry) {
+	registry.addHistogram("ck_writer_write_seconds", "Time a muxer write spent in the write-behind file", "", &writeLatency_);
+	registry.addHistogram("ck_writer_flush_seconds", "Time a write-behind buffer took to reach the disk", "", &flushLatency_);
+}
+
+void WriteBehindFile::benchmark(const std::string& dir, int megabytes) {
+	// The mp4 muxer hands over its 32KB AVIO buffer at a time
+	const size_t CHUNK = 32 * 1024;
+	const uint64_t total = (uint64_t)megabytes * 1024 * 1024;
+	std::vector<uint8_t> chunk(CHUNK);
+	for (size_t i = 0; i < CHUNK; i++) chunk[i] = (uint8_t)(i * 31);
+
+	// Direct: the caller waits on every write, like the muxer does today
+	{
+		std::string path = dir + "/CKBENCH_direct.bin";
+		LatencyHistogram latency;
+		auto begin = std::chrono::steady_clock::now();
+		FILE* f = fopen(path.c_str(), "wb");
+		if (!f) {
+			printf("CK::WRITER [BENCH] Unable to create %s\n", path.c_str());
+			return;
+		}
+		setvbuf(f, nullptr, _IONBF, 0);
+		for (uint64_t written = 0; written < total; written += CHUNK) {
+			uint64_t start = nowNs();
+			fwrite(chunk.data(), 1, CHUNK, f);
+			latency.record(nowNs() - start);
+		}
+		fclose(f);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		printf("CK::WRITER [BENCH] direct: %d MB in %.0fms (%.1f MB/s), write p50=%.3fms p99=%.3fms\n",
+			megabytes, ms, megabytes / (ms / 1000.0), latency.percentileMs(0.5), latency.percentileMs(0.99));
+		std::remove(path.c_str());
+	}
+
+	// Write-behind, preallocated, same chunks
+	{
+		std::string path = dir + "/CKBENCH_behind.bin";
+		LatencyHistogram latency;
+		uint64_t flushesBefore = flushLatency_.count();
+		auto begin = std::chrono::steady_clock::now();
+		WriteBehindFile file;
+		if (!file.open(path, total)) return;
+		for (uint64_t written = 0; written < total; written += CHUNK) {
+			uint64_t start = nowNs();
+			file.write(chunk.data(), CHUNK);
+			latency.record(nowNs() - start);
+		}
+		auto writesDone = std::chrono::steady_clock::now();
+		file.close();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		double writeMs = std::chrono::duration<double, std::milli>(writesDone - begin).count();
+		printf("CK::WRITER [BENCH] write-behind: %d MB in %.0fms (%.1f MB/s, caller done after %.0fms), write p50=%.3fms p99=%.3fms, %llu flushes p99=%.1fms\n",
+			megabytes, ms, megabytes / (ms / 1000.0), writeMs, latency.percentileMs(0.5), latency.percentileMs(0.99),
+			(unsigned long long)(flushLatency_.count() - flushesBefore), flushLatency_.percentileMs(0.99));
+		std::remove(path.c_str());
+	}
+}
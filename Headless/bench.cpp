@@ -0,0 +1,54 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+// Benchmarks for the parts that don't need libobs, builds anywhere the tests do (Tests/CMakeLists.txt)
+// Usage: ConkorsBench --writer dir [megabytes]
+//          direct vs write-behind file output, point dir at the disk to measure
+//          (a cgroup io.max wbps limit or dm-delay device stands in for a busy HDD)
+//        ConkorsBench --faststart dir [megabytes]
+//          moov-at-end recording moved to faststart, by copy & in place, bytes/s
+//        ConkorsBench --threads [seconds]
+//          foreground CPU work against background threads with & without the thread policy.
+//          Raising priority on Linux needs CAP_SYS_NICE, lowering doesn't
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "writer.h"
+#include "mp4.h"
+#include "threads.h"
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 3 && std::string(argv[1]) == "--writer") {
+		WriteBehindFile::benchmark(argv[2], argc >= 4 ? atoi(argv[3]) : 512);
+		return 0;
+	}
+	if (argc >= 3 && std::string(argv[1]) == "--faststart") {
+		return mp4::benchmark(argv[2], argc >= 4 ? atoi(argv[3]) : 256) ? 0 : 1;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "--threads") {
+		threads::benchmark(argc >= 3 ? atoi(argv[2]) : 5);
+		return 0;
+	}
+
+	printf("Usage: %s --writer dir [megabytes] | --faststart dir [megabytes] | --threads [seconds]\n", argv[0]);
+	return 2;
+}
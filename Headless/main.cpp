@@ -0,0 +1,415 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+// Headless capture/encode benchmark, no Qt window or real capture devices.
+// Windows only like the rest of VidCore, --graphics libobs-opengl.dll swaps the renderer
+// Usage: ConkorsHeadless [--graphics module] [--script file] [--out file] [--keep]
+// The file writer & thread policy benchmarks are in ConkorsBench (bench.cpp), it builds without libobs
+//
+// Script lines (# comments):
+//   start            boot the replay buffer
+//   wait S           idle S seconds
+//   save N I         save N replays, I seconds apart, stamped & aligned like hotkey presses
+//   switch           flip between the monitor & window test sources
+//   region X Y W H   crop the capture to a region, 0 0 0 0 for the whole source, the canvas follows its size
+//   fit              reset the canvas to the region's size after a source resize
+//   resize W H       resize the test source, rescaled after it settles, a new shape resets the canvas
+//   live             start/stop a live recording
+//   crash            kill the process on the spot, the next run reports what it recovered
+//   stall [N]        fail the encoder N times in a row, each one has to rebuild the replay buffer.
+//                    A repeat failure falls back to the next encoder, so N >= 2 has to change it
+//   stop             stop the replay buffer
+//   bench NAME [N]   run a VidCore benchmark, results go to the log:
+//                      presets [seconds per preset]
+//                      codecs [frames]
+//                      reads [seconds]   UI state reads, idle & during video resets
+//                      scene [frames]    scene change detector on synthetic frames
+//                      region [seconds]  full source against a half region
+//                      clips [count]     trim & concat on the newest replay this run saved
+//                      highlights [wav]  highlight detector on a recording, synthetic audio without one
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <Windows.h>
+
+#include <nlohmann/json.hpp>
+
+#include "account.h"
+#include "vid.h"
+#include "clip.h"
+#include <util/platform.h>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+static const char* DEFAULT_SCRIPT =
+	"start\n"
+	"wait 10\n"
+	"save 3 5\n"
+	"switch\n"
+	"wait 5\n"
+	"save 2 5\n"
+	"stop\n";
+
+static const int SAVE_TIMEOUT_S = 30;
+static const int RECOVERY_TIMEOUT_S = 30;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// User + kernel time for the whole process
+static double cpuSeconds() {
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 1e7;
+}
+
+static json frameStats(const VidCore::FrameStats& stats) {
+	return {
+		{ "total", stats.totalFrames },
+		{ "lagged", stats.laggedFrames },
+		{ "skipped", stats.skippedFrames },
+		{ "dropped", stats.droppedFrames },
+		{ "static", stats.staticFrames }
+	};
+}
+
+/////////////////////
+// Saved replay tracking
+
+class SaveWaiter {
+public:
+	void onSaved(const std::string& path) {
+		{
+			const std::lock_guard<std::mutex> lock(mtx_);
+			paths_.push_back(path);
+		}
+		cv_.notify_all();
+	}
+
+	// Blocks until the saved count passes `count`, false on timeout
+	bool waitFor(size_t count, int timeoutSeconds) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		return cv_.wait_for(lock, std::chrono::seconds(timeoutSeconds), [&]() { return paths_.size() > count; });
+	}
+
+	size_t count() {
+		const std::lock_guard<std::mutex> lock(mtx_);
+		return paths_.size();
+	}
+
+	std::vector<std::string> paths() {
+		const std::lock_guard<std::mutex> lock(mtx_);
+		return paths_;
+	}
+
+private:
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::vector<std::string> paths_;
+};
+
+/////////////////////
+// Scenario
+
+static bool runScript(const std::string& script, VidCore& vc, SaveWaiter& saves, json& steps) {
+	std::istringstream lines(script);
+	std::string line;
+	int lineNo = 0;
+
+	while (std::getline(lines, line)) {
+		lineNo++;
+		std::istringstream words(line);
+		std::string op;
+		if (!(words >> op) || op[0] == '#') continue;
+
+		json step = { { "line", lineNo }, { "op", op } };
+		Clock::time_point start = Clock::now();
+		double cpuStart = cpuSeconds();
+		VidCore::FrameStats before = vc.getFrameStats();
+
+		// Everything that changes VidCore goes through its command queue, like the UI
+		if (op == "start") {
+			bool ok = false;
+			vc.runCommand([&]() { ok = vc.recordReplay(); });
+			step["ok"] = ok;
+		}
+		else if (op == "stop") {
+			step["ok"] = vc.runCommand([&]() { vc.stopReplay(); });
+		}
+		else if (op == "switch") {
+			// Outputs stop around the reset, the step fails if the reset or the restart did
+			bool wasActive = vc.getState()->replayActive;
+			bool ok = false;
+			vc.runCommand([&]() {
+				ok = vc.getState()->captureWindowMode ? vc.captureMonitor() : vc.captureWindow();
+			});
+			step["ok"] = ok && vc.getState()->replayActive == wasActive;
+		}
+		else if (op == "region") {
+			VidCore::CaptureRegion region;
+			words >> region.x >> region.y >> region.width >> region.height;
+			bool ok = false;
+			vc.runCommand([&]() { ok = vc.setCaptureRegion(region); });
+			step["ok"] = ok;
+		}
+		else if (op == "fit") {
+			bool ok = false;
+			vc.runCommand([&]() { ok = vc.fitCanvas(); });
+			step["ok"] = ok && vc.getState()->replayActive;
+		}
+		else if (op == "resize") {
+			int width = 0;
+			int height = 0;
+			words >> width >> height;
+			vc.resizeSyntheticDisplay(width, height);
+			step["ok"] = width > 0 && height > 0;
+		}
+		else if (op == "live") {
+			step["ok"] = vc.runCommand([&]() { vc.toggleRecordLive(); });
+		}
+		else if (op == "crash") {
+			// No destructors, no output stop, like a power cut as far as the recording is concerned
+			printf("CK::HEADLESS Crashing on line %d\n", lineNo);
+			fflush(stdout);
+			TerminateProcess(GetCurrentProcess(), 3);
+		}
+		else if (op == "stall") {
+			int failures = 0;
+			if (!(words >> failures)) failures = 1;
+			std::string encoderBefore = vc.getState()->encoder;
+			bool recovered = true;
+			for (int i = 0; i < failures && recovered; i++) {
+				int recoveries = vc.getState()->encoderRecoveries;
+				recovered = vc.injectEncoderFailure();
+				Clock::time_point deadline = Clock::now() + std::chrono::seconds(RECOVERY_TIMEOUT_S);
+				while (recovered && vc.getState()->encoderRecoveries == recoveries && Clock::now() < deadline) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				}
+				recovered = recovered && vc.getState()->encoderRecoveries > recoveries;
+			}
+			std::string encoderAfter = vc.getState()->encoder;
+			step["recoverMs"] = msSince(start);
+			step["encoderBefore"] = encoderBefore;
+			step["encoderAfter"] = encoderAfter;
+			// Software H.264 has nothing left to fall back to
+			bool fellBack = encoderAfter != encoderBefore || encoderBefore == "obs_x264";
+			step["ok"] = recovered && vc.getState()->replayActive && (failures < 2 || fellBack);
+		}
+		else if (op == "bench") {
+			std::string name;
+			words >> name;
+			if (name == "presets") {
+				int seconds = 0;
+				if (!(words >> seconds)) seconds = 5;
+				vc.benchmarkPresets(seconds);
+				step["ok"] = true;
+			}
+			else if (name == "reads") {
+				int seconds = 0;
+				if (!(words >> seconds)) seconds = 5;
+				vc.benchmarkStateReads(seconds);
+				step["ok"] = true;
+			}
+			else if (name == "codecs") {
+				int frames = 0;
+				if (!(words >> frames)) frames = 600;
+				vc.benchmarkCodecs(frames);
+				step["ok"] = true;
+			}
+			else if (name == "scene") {
+				int frames = 0;
+				if (!(words >> frames)) frames = 3600;
+				vc.benchmarkSceneDetection(frames);
+				step["ok"] = true;
+			}
+			else if (name == "region") {
+				int seconds = 0;
+				if (!(words >> seconds)) seconds = 5;
+				vc.benchmarkCaptureRegion(seconds);
+				step["ok"] = true;
+			}
+			else if (name == "clips") {
+				int count = 0;
+				if (!(words >> count) || count < 1) count = 5;
+				std::vector<std::string> saved = saves.paths();
+				if (saved.empty()) {
+					printf("CK::HEADLESS bench clips on line %d needs a save first\n", lineNo);
+					step["ok"] = false;
+				}
+				else {
+					step["ok"] = clip::benchmark(saved.back(), count);
+				}
+			}
+			else if (name == "highlights") {
+				std::string wavPath;
+				words >> wavPath;
+				step["ok"] = vc.benchmarkHighlights(wavPath);
+			}
+			else {
+				printf("CK::HEADLESS Unknown benchmark on line %d: %s\n", lineNo, name.c_str());
+				step["ok"] = false;
+			}
+		}
+		else if (op == "wait") {
+			double seconds = 0;
+			words >> seconds;
+			std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+			step["ok"] = true;
+		}
+		else if (op == "save") {
+			int count = 1;
+			double interval = 0;
+			words >> count >> interval;
+
+			json latencies = json::array();
+			json endErrors = json::array();
+			bool ok = true;
+			for (int i = 0; i < count; i++) {
+				if (i > 0) std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+
+				size_t saved = saves.count();
+				Clock::time_point saveStart = Clock::now();
+				// Stamped like a hotkey press, the clip should end on this frame
+				uint64_t pressNs = os_gettime_ns();
+				vc.queueCommand([&vc, pressNs]() { vc.saveReplay(0, pressNs); });
+				if (!saves.waitFor(saved, SAVE_TIMEOUT_S)) {
+					printf("CK::HEADLESS Save %d timed out\n", i);
+					ok = false;
+					break;
+				}
+				latencies.push_back(msSince(saveStart));
+				endErrors.push_back(vc.getLastHotkeySave().endErrorMs);
+			}
+			step["saveLatencyMs"] = latencies;
+			step["endErrorMs"] = endErrors;
+			step["ok"] = ok;
+		}
+		else {
+			printf("CK::HEADLESS Unknown op on line %d: %s\n", lineNo, op.c_str());
+			return false;
+		}
+
+		VidCore::FrameStats after = vc.getFrameStats();
+		step["ms"] = msSince(start);
+		step["cpuSeconds"] = cpuSeconds() - cpuStart;
+		step["framesLagged"] = after.laggedFrames - before.laggedFrames;
+		step["framesSkipped"] = after.skippedFrames - before.skippedFrames;
+		step["framesDropped"] = after.droppedFrames - before.droppedFrames;
+		step["framesStatic"] = after.staticFrames - before.staticFrames;
+		printf("CK::HEADLESS %s: %.1fms\n", op.c_str(), step["ms"].get<double>());
+		steps.push_back(step);
+
+		if (!step["ok"].get<bool>()) return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string graphics;
+	std::string scriptPath;
+	std::string outPath;
+	bool keep = false;
+
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--graphics" && i + 1 < argc) graphics = argv[++i];
+		else if (arg == "--script" && i + 1 < argc) scriptPath = argv[++i];
+		else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+		else if (arg == "--keep") keep = true;
+		else {
+			printf("Usage: %s [--graphics module] [--script file] [--out file] [--keep]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::string script = DEFAULT_SCRIPT;
+	if (!scriptPath.empty()) {
+		std::ifstream in(scriptPath);
+		if (!in) {
+			printf("CK::HEADLESS Unable to read script: %s\n", scriptPath.c_str());
+			return 2;
+		}
+		std::stringstream buf;
+		buf << in.rdbuf();
+		script = buf.str();
+	}
+
+	json report;
+	Clock::time_point processStart = Clock::now();
+
+	// INIT BACKEND
+	// Not logged in, so the post-save pipeline never uploads
+	std::shared_ptr<AccountManager> accMgr = std::make_shared<AccountManager>();
+	std::shared_ptr<VidCore> vc = std::make_shared<VidCore>();
+	SaveWaiter saves;
+	if (!graphics.empty()) vc->setGraphicsModule(graphics);
+	vc->setSyntheticSources(true);
+	vc->setReplaySavedCallback([&saves](const std::string& path) { saves.onSaved(path); });
+
+	if (!vc->init(accMgr, {})) {
+		printf("CK::HEADLESS Failed to init VidCore\n");
+		return 1;
+	}
+	report["startupMs"] = msSince(processStart);
+	report["encoder"] = vc->getState()->encoder;
+	VidCore::RecoveryStats recovery = vc->getRecoveryStats();
+	report["recovery"] = { { "found", recovery.found }, { "recovered", recovery.recovered }, { "ms", recovery.ms } };
+
+	json steps = json::array();
+	bool ok = runScript(script, *vc, saves, steps);
+	report["steps"] = steps;
+	report["ok"] = ok;
+	report["frames"] = frameStats(vc->getFrameStats());
+	report["totalMs"] = msSince(processStart);
+	report["cpuSeconds"] = cpuSeconds();
+
+	vc->setReplaySavedCallback(nullptr);
+	if (!keep) {
+		for (const std::string& path : saves.paths()) {
+			std::remove(path.c_str());
+		}
+	}
+
+	std::string out = report.dump(2);
+	if (outPath.empty()) {
+		printf("%s\n", out.c_str());
+	}
+	else {
+		std::ofstream file(outPath);
+		file << out << "\n";
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "commands.h"
+#include "test.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stand-in for VidCore: fields only the command thread touches, published after every command
+struct Owner {
+	int version = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<std::string> devices;
+};
+
+struct State {
+	int version = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<std::string> devices;
+};
+
+static void publish(const Owner& owner, Snapshot<State>& state) {
+	auto next = std::make_shared<State>(*state.get());
+	next->version = owner.version;
+	next->width = owner.width;
+	next->height = owner.height;
+	next->devices = owner.devices;
+	state.publish(std::move(next));
+}
+
+// Every snapshot a reader sees has to be one the command thread published whole
+static bool consistent(const State& s) {
+	return s.height == s.width * 2 && (int)s.devices.size() == s.version % 16;
+}
+
+static void testReadsDuringCommands() {
+	Owner owner;
+	Snapshot<State> state;
+	CommandQueue commands;
+	commands.start([&]() { publish(owner, state); });
+
+	std::atomic<bool> done(false);
+	std::atomic<int> torn(0);
+	std::atomic<int> backwards(0);
+	std::atomic<uint64_t> reads(0);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; r++) {
+		readers.emplace_back([&]() {
+			int last = 0;
+			while (!done) {
+				std::shared_ptr<const State> s = state.get();
+				if (!consistent(*s)) torn++;
+				if (s->version < last) backwards++;
+				last = s->version;
+				reads++;
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	// Two producers, like the UI thread & the scheduler
+	const int PER_PRODUCER = 2000;
+	std::atomic<int> ran(0);
+	auto produce = [&]() {
+		for (int i = 0; i < PER_PRODUCER; i++) {
+			commands.queue([&]() {
+				owner.version++;
+				owner.width = owner.version * 3;
+				owner.height = owner.width * 2;
+				owner.devices.assign(owner.version % 16, "dev");
+				ran++;
+			});
+			if (i % 64 == 0) std::this_thread::yield();
+		}
+	};
+	std::thread a(produce);
+	std::thread b(produce);
+	a.join();
+	b.join();
+
+	// Waits for everything queued before it
+	CHECK(commands.run([]() {}));
+	CHECK(ran == 2 * PER_PRODUCER);
+	CHECK(state.get()->version == 2 * PER_PRODUCER);
+
+	done = true;
+	for (auto& t : readers) t.join();
+	commands.stop();
+
+	CHECK(torn == 0);
+	CHECK(backwards == 0);
+	CHECK(reads > 0);
+}
+
+static void testOrderAndDone() {
+	CommandQueue commands;
+	std::vector<int> order;
+	// Queued before start, runs once started
+	for (int i = 0; i < 100; i++) {
+		commands.queue([&order, i]() { order.push_back(i); });
+	}
+	int published = 0;
+	commands.start([&]() { published++; });
+
+	std::vector<int> seen;
+	CHECK(commands.run([&]() { seen = order; }));
+	CHECK(seen.size() == 100);
+	for (int i = 0; i < (int)seen.size(); i++) {
+		CHECK(seen[i] == i);
+	}
+	CHECK(published == 101);
+
+	// done runs after the state was published for that command
+	int publishedAtDone = -1;
+	std::atomic<bool> finished(false);
+	commands.queue([]() {}, [&]() { publishedAtDone = published; finished = true; });
+	commands.run([]() {});
+	CHECK(finished && publishedAtDone == 102);
+
+	// From inside a command run() can't wait on itself
+	bool inner = false;
+	CHECK(commands.run([&]() { commands.run([&]() { inner = true; }); }));
+	CHECK(inner);
+	commands.stop();
+}
+
+static void testStop() {
+	CommandQueue commands;
+	commands.start(nullptr);
+
+	// A run() stuck behind a slow command gets false when stop() drops it
+	std::atomic<bool> release(false);
+	commands.queue([&]() { while (!release) std::this_thread::yield(); });
+	std::atomic<int> result(-1);
+	std::thread waiter([&]() { result = commands.run([]() {}) ? 1 : 0; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::thread stopper([&]() { commands.stop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	release = true;
+	stopper.join();
+	waiter.join();
+	CHECK(result == 0);
+
+	CHECK(!commands.queue([]() {}));
+	CHECK(!commands.run([]() {}));
+}
+
+int main() {
+	testOrderAndDone();
+	testReadsDuringCommands();
+	testStop();
+	return TEST_RESULT();
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "hotkeys.h"
+#include "test.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+static const uint32_t CODE_D = 'D';
+static const uint32_t CODE_1 = '1';
+static const uint32_t CODE_F9 = VK_F9;
+static const uint32_t CODE_F12 = VK_F12;
+#else
+#include <linux/input.h>
+static const uint32_t CODE_D = KEY_D;
+static const uint32_t CODE_1 = KEY_1;
+static const uint32_t CODE_F9 = KEY_F9;
+static const uint32_t CODE_F12 = KEY_F12;
+#endif
+
+static void testQueueOrder() {
+	// One slot always stays free, 7 fit in 8
+	SpscQueue<int, 8> queue;
+	CHECK(queue.empty());
+	for (int i = 0; i < 7; i++) {
+		CHECK(queue.push(i));
+	}
+	CHECK(!queue.push(7));
+
+	int v = -1;
+	for (int i = 0; i < 7; i++) {
+		CHECK(queue.pop(v) && v == i);
+	}
+	CHECK(!queue.pop(v));
+	CHECK(queue.empty());
+
+	// Head & tail wrap many times over
+	int next = 0;
+	int expected = 0;
+	for (int round = 0; round < 100; round++) {
+		for (int i = 0; i < round % 7 + 1; i++) {
+			CHECK(queue.push(next++));
+		}
+		while (queue.pop(v)) {
+			CHECK(v == expected);
+			expected++;
+		}
+	}
+	CHECK(expected == next);
+}
+
+static void testQueueAcrossThreads() {
+	// Every item comes out once & in order, a full queue only makes the producer retry
+	const int COUNT = 200000;
+	SpscQueue<int, 64> queue;
+	std::thread producer([&queue]() {
+		for (int i = 0; i < COUNT; i++) {
+			while (!queue.push(i)) std::this_thread::yield();
+		}
+	});
+
+	int expected = 0;
+	bool ordered = true;
+	while (expected < COUNT) {
+		int v;
+		if (!queue.pop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (v != expected) ordered = false;
+		expected++;
+	}
+	producer.join();
+	CHECK(ordered);
+	CHECK(queue.empty());
+}
+
+static void testParseKeys() {
+	uint32_t mods;
+	uint32_t code;
+
+	CHECK(HotkeyService::parseKeys("Alt+D", mods, code));
+	CHECK(mods == HotkeyService::ALT && code == CODE_D);
+
+	CHECK(HotkeyService::parseKeys("Ctrl+Shift+F9", mods, code));
+	CHECK(mods == (HotkeyService::CTRL | HotkeyService::SHIFT) && code == CODE_F9);
+
+	// Case & spaces don't matter, Control & Super are aliases
+	CHECK(HotkeyService::parseKeys(" control + win + 1 ", mods, code));
+	CHECK(mods == (HotkeyService::CTRL | HotkeyService::SUPER) && code == CODE_1);
+	CHECK(HotkeyService::parseKeys("super+alt+f12", mods, code));
+	CHECK(mods == (HotkeyService::SUPER | HotkeyService::ALT) && code == CODE_F12);
+
+	// No modifier is fine
+	CHECK(HotkeyService::parseKeys("F9", mods, code));
+	CHECK(mods == 0 && code == CODE_F9);
+
+	// The key goes last & there is only one
+	CHECK(!HotkeyService::parseKeys("D+Alt", mods, code));
+	CHECK(!HotkeyService::parseKeys("Alt+D+E", mods, code));
+	// Modifiers alone, empty parts & unknown names
+	CHECK(!HotkeyService::parseKeys("Ctrl+Shift", mods, code));
+	CHECK(!HotkeyService::parseKeys("", mods, code));
+	CHECK(!HotkeyService::parseKeys("Alt++D", mods, code));
+	CHECK(!HotkeyService::parseKeys("Alt+", mods, code));
+	CHECK(!HotkeyService::parseKeys("Alt+Tab", mods, code));
+	CHECK(!HotkeyService::parseKeys("F0", mods, code));
+	CHECK(!HotkeyService::parseKeys("F13", mods, code));
+}
+
+int main() {
+	testQueueOrder();
+	testQueueAcrossThreads();
+	testParseKeys();
+	return TEST_RESULT();
+}
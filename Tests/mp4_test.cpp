@@ -0,0 +1,259 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4.h"
+#include "test.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static void putU32(Bytes& b, uint32_t v) {
+	for (int s = 24; s >= 0; s -= 8) b.push_back((uint8_t)(v >> s));
+}
+
+static void putU64(Bytes& b, uint64_t v) {
+	putU32(b, (uint32_t)(v >> 32));
+	putU32(b, (uint32_t)v);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static Bytes box(const char* type, const Bytes& payload) {
+	Bytes b;
+	putU32(b, (uint32_t)(8 + payload.size()));
+	b.insert(b.end(), type, type + 4);
+	b.insert(b.end(), payload.begin(), payload.end());
+	return b;
+}
+
+static Bytes concat(std::initializer_list<Bytes> parts) {
+	Bytes b;
+	for (const Bytes& p : parts) b.insert(b.end(), p.begin(), p.end());
+	return b;
+}
+
+// Chunk offset table, full box version/flags then the entries
+static Bytes offsets(const char* type, const std::vector<uint64_t>& entries) {
+	Bytes p;
+	putU32(p, 0);
+	putU32(p, (uint32_t)entries.size());
+	for (uint64_t e : entries) {
+		if (strcmp(type, "co64") == 0) putU64(p, e);
+		else putU32(p, (uint32_t)e);
+	}
+	return box(type, p);
+}
+
+static Bytes track(const Bytes& table) {
+	Bytes stsd = box("stsd", Bytes(8, 0));
+	return box("trak", concat({ box("tkhd", Bytes(12, 1)),
+		box("mdia", box("minf", box("stbl", concat({ stsd, table })))) }));
+}
+
+static Bytes readFile(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const Bytes& data) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)data.data(), data.size());
+}
+
+// Every stco/co64 entry in the file, in order, found by scanning for the table types
+static std::vector<uint64_t> chunkOffsets(const Bytes& file) {
+	std::vector<uint64_t> result;
+	for (size_t i = 4; i + 12 <= file.size(); i++) {
+		bool stco = memcmp(&file[i], "stco", 4) == 0;
+		bool co64 = memcmp(&file[i], "co64", 4) == 0;
+		if (!stco && !co64) continue;
+		uint32_t count = getU32(&file[i + 8]);
+		for (uint32_t n = 0; n < count; n++) {
+			const uint8_t* p = &file[i + 12 + n * (co64 ? 8 : 4)];
+			result.push_back(co64 ? ((uint64_t)getU32(p) << 32) | getU32(p + 4) : getU32(p));
+		}
+	}
+	return result;
+}
+
+static const size_t CHUNK = 64;
+
+// ftyp, [free], mdat with four recognisable chunks, moov last as a plain muxer writes it
+static Bytes moovAtEnd(size_t freeSize, std::vector<uint64_t>& chunkStarts) {
+	Bytes ftyp = box("ftyp", Bytes{ 'i', 's', 'o', 'm', 0, 0, 2, 0 });
+	Bytes free;
+	if (freeSize) free = box("free", Bytes(freeSize - 8, 0));
+
+	Bytes payload;
+	for (int c = 0; c < 4; c++) {
+		for (size_t i = 0; i < CHUNK; i++) payload.push_back((uint8_t)(c * 50 + i));
+	}
+	Bytes mdat = box("mdat", payload);
+
+	uint64_t dataStart = ftyp.size() + free.size() + 8;
+	chunkStarts.clear();
+	for (int c = 0; c < 4; c++) chunkStarts.push_back(dataStart + c * CHUNK);
+
+	// Video chunks in a 32 bit table, audio in a 64 bit one
+	Bytes moov = box("moov", concat({ box("mvhd", Bytes(20, 0)),
+		track(offsets("stco", { chunkStarts[0], chunkStarts[2] })),
+		track(offsets("co64", { chunkStarts[1], chunkStarts[3] })) }));
+	return concat({ ftyp, free, mdat, moov });
+}
+
+// Each rewritten offset must still land on the same chunk bytes
+static void checkChunks(const Bytes& before, const std::vector<uint64_t>& oldOffsets, const Bytes& after) {
+	std::vector<uint64_t> newOffsets = chunkOffsets(after);
+	CHECK(newOffsets.size() == oldOffsets.size());
+	for (size_t i = 0; i < oldOffsets.size() && i < newOffsets.size(); i++) {
+		CHECK(newOffsets[i] + CHUNK <= after.size());
+		if (newOffsets[i] + CHUNK > after.size()) continue;
+		CHECK(memcmp(&before[oldOffsets[i]], &after[newOffsets[i]], CHUNK) == 0);
+	}
+}
+
+static size_t boxIndex(const std::vector<mp4::Box>& boxes, const char* type) {
+	for (size_t i = 0; i < boxes.size(); i++) {
+		if (strcmp(boxes[i].type, type) == 0) return i;
+	}
+	return boxes.size();
+}
+
+static void testCopy(const std::string& path) {
+	std::vector<uint64_t> starts;
+	Bytes before = moovAtEnd(0, starts);
+	writeFile(path, before);
+	std::vector<uint64_t> oldOffsets = chunkOffsets(before);
+	CHECK(!mp4::isFaststart(path));
+
+	CHECK(mp4::faststart(path));
+	CHECK(mp4::isFaststart(path));
+
+	Bytes after = readFile(path);
+	CHECK(after.size() == before.size());
+	std::vector<mp4::Box> boxes = mp4::readBoxes(path);
+	CHECK(boxIndex(boxes, "moov") < boxIndex(boxes, "mdat"));
+
+	// mdat moved down by exactly the moov size, every table followed it
+	uint64_t moovSize = boxes[boxIndex(boxes, "moov")].size;
+	std::vector<uint64_t> newOffsets = chunkOffsets(after);
+	for (size_t i = 0; i < oldOffsets.size() && i < newOffsets.size(); i++) {
+		CHECK(newOffsets[i] == oldOffsets[i] + moovSize);
+	}
+	checkChunks(before, oldOffsets, after);
+	CHECK(!std::filesystem::exists(path + ".faststart"));
+}
+
+static void testInPlace(const std::string& path) {
+	// A free slot ahead of mdat big enough for moov plus a padding box
+	std::vector<uint64_t> starts;
+	Bytes probe = moovAtEnd(0, starts);
+	size_t moovSize = probe.size() - (16 + 8 + 4 * CHUNK);
+	Bytes before = moovAtEnd(moovSize + 32, starts);
+	writeFile(path, before);
+	std::vector<uint64_t> oldOffsets = chunkOffsets(before);
+
+	CHECK(mp4::faststart(path));
+	Bytes after = readFile(path);
+	// Old moov cut off the end, mdat stayed put
+	CHECK(after.size() == before.size() - moovSize);
+	std::vector<mp4::Box> boxes = mp4::readBoxes(path);
+	CHECK(boxIndex(boxes, "moov") < boxIndex(boxes, "mdat"));
+	CHECK(boxIndex(boxes, "free") < boxes.size());
+	CHECK(chunkOffsets(after) == oldOffsets);
+	checkChunks(before, oldOffsets, after);
+}
+
+static void testAlreadyFaststart(const std::string& path) {
+	std::vector<uint64_t> starts;
+	Bytes before = moovAtEnd(0, starts);
+	writeFile(path, before);
+	CHECK(mp4::faststart(path));
+	Bytes once = readFile(path);
+	// Second run leaves the file alone
+	CHECK(mp4::faststart(path));
+	CHECK(readFile(path) == once);
+}
+
+#ifdef CK_FFMPEG
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Every packet's stream, timestamps, size & checksum as libavformat demuxes them
+static std::string packetDigest(const std::string& path) {
+	std::string cmd = std::string("\"") + CK_FFMPEG + "\" -v error -i \"" + path + "\" -map 0 -c copy -f framemd5 -";
+	std::string out;
+	FILE* p = popen(cmd.c_str(), "r");
+	if (!p) return out;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), p)) > 0) out.append(buf, n);
+	return pclose(p) == 0 ? out : std::string();
+}
+#endif
+
+// Tests/fixtures/moov_at_end.mp4, written by FFmpeg's mp4 muxer with its defaults:
+// 2s of 160x90 H.264 with B-frames and mono AAC, moov after mdat
+static void testMuxedFixture(const std::string& path) {
+	Bytes before = readFile(std::string(CK_FIXTURES) + "/moov_at_end.mp4");
+	CHECK(!before.empty());
+	writeFile(path, before);
+	std::vector<uint64_t> oldOffsets = chunkOffsets(before);
+	CHECK(!oldOffsets.empty());
+	CHECK(!mp4::isFaststart(path));
+
+	CHECK(mp4::faststart(path));
+	CHECK(mp4::isFaststart(path));
+	Bytes after = readFile(path);
+	CHECK(after.size() == before.size());
+	std::vector<mp4::Box> boxes = mp4::readBoxes(path);
+	CHECK(boxIndex(boxes, "moov") < boxIndex(boxes, "mdat"));
+	checkChunks(before, oldOffsets, after);
+
+#ifdef CK_FFMPEG
+	// Same packets at the same timestamps, read back through the tables faststart rewrote
+	std::string original = packetDigest(std::string(CK_FIXTURES) + "/moov_at_end.mp4");
+	CHECK(original.find("0,") != std::string::npos);
+	CHECK(packetDigest(path) == original);
+#else
+	printf("mp4_test: no ffmpeg found at configure time, muxed fixture not demuxed\n");
+#endif
+}
+
+int main() {
+	std::string path = (std::filesystem::temp_directory_path() / "ck_mp4_test.mp4").string();
+	testCopy(path);
+	testInPlace(path);
+	testAlreadyFaststart(path);
+	testMuxedFixture(path);
+	std::remove(path.c_str());
+	return TEST_RESULT();
+}
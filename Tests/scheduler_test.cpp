@@ -0,0 +1,190 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "scheduler.h"
+#include "test.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Never started, so time only moves when the test ticks it
+
+static void advance(Scheduler& s, uint64_t& now, uint64_t toMs, uint64_t stepMs) {
+	while (now < toMs) {
+		now = std::min(now + stepMs, toMs);
+		s.tick(now);
+	}
+}
+
+static void testOrdering() {
+	Scheduler s(10, 64);
+	std::vector<std::string> ran;
+	s.schedule(30, [&]() { ran.push_back("c"); });
+	s.schedule(10, [&]() { ran.push_back("a"); });
+	s.schedule(20, [&]() { ran.push_back("b1"); });
+	s.schedule(20, [&]() { ran.push_back("b2"); });
+	s.schedule(0, [&]() { ran.push_back("now"); });
+
+	// Nothing runs inside the call that scheduled it
+	CHECK(ran.empty());
+
+	uint64_t now = 0;
+	s.tick(0);
+	CHECK(ran == std::vector<std::string>({ "now" }));
+	advance(s, now, 19, 1);
+	CHECK(ran == std::vector<std::string>({ "now", "a" }));
+	advance(s, now, 40, 1);
+	CHECK(ran == std::vector<std::string>({ "now", "a", "b1", "b2", "c" }));
+
+	// One big step still runs them earliest first
+	ran.clear();
+	s.schedule(35, [&]() { ran.push_back("y"); });
+	s.schedule(15, [&]() { ran.push_back("x"); });
+	s.tick(now + 100);
+	CHECK(ran == std::vector<std::string>({ "x", "y" }));
+}
+
+static void testNeverEarly() {
+	Scheduler s(10, 64);
+	uint64_t firedAt = 0;
+	uint64_t now = 0;
+	s.tick(3);
+	now = 3;
+	// Due at 28, which is inside the 20-30 slot
+	s.schedule(25, [&]() { firedAt = now; });
+	advance(s, now, 27, 1);
+	CHECK(firedAt == 0);
+	advance(s, now, 40, 1);
+	CHECK(firedAt == 28 || firedAt == 30);
+}
+
+static void testWheelWrap() {
+	// 8 slots of 10ms, one turn is 80ms
+	Scheduler s(10, 8);
+	uint64_t now = 0;
+	std::vector<uint64_t> fired(4, 0);
+	s.schedule(75, [&]() { fired[0] = now; });
+	s.schedule(85, [&]() { fired[1] = now; });
+	s.schedule(500, [&]() { fired[2] = now; });
+	s.schedule(640, [&]() { fired[3] = now; }); // Exactly eight turns, same slot as 0
+
+	advance(s, now, 1000, 10);
+	CHECK(fired[0] == 80);
+	CHECK(fired[1] == 90);
+	CHECK(fired[2] == 500);
+	CHECK(fired[3] == 640);
+
+	// A jump of several turns lands each timer once
+	int count = 0;
+	s.schedule(130, [&]() { count++; });
+	s.schedule(10, [&]() { count++; });
+	s.tick(now + 1000);
+	CHECK(count == 2);
+}
+
+static void testCancel() {
+	Scheduler s(10, 16);
+	uint64_t now = 0;
+	int a = 0, b = 0, c = 0;
+	Scheduler::TimerId ida = s.schedule(50, [&]() { a++; });
+	Scheduler::TimerId idb = s.schedule(50, [&]() { b++; });
+	CHECK(s.cancel(ida));
+	CHECK(!s.cancel(ida));
+	CHECK(!s.cancel(Scheduler::INVALID_TIMER));
+
+	// Reuses the cancelled timer's storage, the stale id must not reach it
+	Scheduler::TimerId idc = s.schedule(50, [&]() { c++; });
+	CHECK(idc != ida);
+	CHECK(!s.cancel(ida));
+
+	advance(s, now, 100, 10);
+	CHECK(a == 0 && b == 1 && c == 1);
+	// Already fired
+	CHECK(!s.cancel(idb));
+
+	// Cancelling a repeating timer from its own task stops it
+	int ticks = 0;
+	Scheduler::TimerId every = Scheduler::INVALID_TIMER;
+	every = s.scheduleEvery(20, [&]() { if (++ticks == 3) s.cancel(every); });
+	advance(s, now, 400, 10);
+	CHECK(ticks == 3);
+}
+
+static void testDebounce() {
+	Scheduler s(10, 16);
+	uint64_t now = 0;
+	std::vector<int> ran;
+	s.debounce("save", 50, [&]() { ran.push_back(1); });
+	advance(s, now, 30, 10);
+	s.debounce("save", 50, [&]() { ran.push_back(2); });
+	advance(s, now, 60, 10);
+	s.debounce("save", 50, [&]() { ran.push_back(3); });
+	// Other keys are independent
+	s.debounce("other", 20, [&]() { ran.push_back(9); });
+
+	advance(s, now, 100, 10);
+	CHECK(ran == std::vector<int>({ 9 }));
+	advance(s, now, 110, 10);
+	CHECK(ran == std::vector<int>({ 9, 3 }));
+	advance(s, now, 300, 10);
+	CHECK(ran == std::vector<int>({ 9, 3 }));
+
+	// Fires again once the previous one ran
+	s.debounce("save", 50, [&]() { ran.push_back(4); });
+	advance(s, now, 400, 10);
+	CHECK(ran == std::vector<int>({ 9, 3, 4 }));
+}
+
+static void testEveryDoesNotDrift() {
+	Scheduler s(10, 32);
+	uint64_t now = 0;
+	std::vector<uint64_t> fired;
+	s.scheduleEvery(100, [&]() { fired.push_back(now); });
+
+	// Uneven ticks that never land on a period boundary, like a loaded scheduler thread
+	const uint64_t steps[] = { 7, 13, 9, 17, 11 };
+	for (int i = 0; now < 10050; i++) {
+		now += steps[i % 5];
+		s.tick(now);
+	}
+
+	// Period k is due at k*100 and runs on the first tick after it, late ticks don't push later periods back
+	CHECK(fired.size() == 100);
+	for (size_t k = 0; k < fired.size(); k++) {
+		uint64_t due = (k + 1) * 100;
+		CHECK(fired[k] >= due && fired[k] < due + 17);
+	}
+
+	// A stall longer than several periods runs the task once, not once per missed period
+	size_t before = fired.size();
+	now += 450;
+	s.tick(now);
+	CHECK(fired.size() == before + 1);
+}
+
+int main() {
+	testOrdering();
+	testNeverEarly();
+	testWheelWrap();
+	testCancel();
+	testDebounce();
+	testEveryDoesNotDrift();
+	return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "spill.h"
+#include "test.h"
+
+#include <cstdint>
+#include <vector>
+
+// Mirror of the index, so overlaps and order can be checked slot by slot
+struct Entry {
+	size_t offset;
+	size_t size;
+};
+
+static bool overlaps(const Entry& a, const Entry& b) {
+	return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+static void reserve(SpillIndex& index, std::vector<Entry>& live, size_t size) {
+	size_t offset = 0;
+	size_t evicted = 0;
+	CHECK(index.reserve(size, offset, evicted));
+	CHECK(evicted <= live.size());
+	live.erase(live.begin(), live.begin() + std::min(evicted, live.size()));
+	live.push_back({ offset, size });
+
+	// Nothing still indexed may share a byte with another slot, the newest one included
+	size_t used = 0;
+	for (size_t i = 0; i < live.size(); i++) {
+		CHECK(live[i].offset + live[i].size <= index.capacity());
+		for (size_t j = i + 1; j < live.size(); j++) {
+			CHECK(!overlaps(live[i], live[j]));
+		}
+		used += live[i].size;
+	}
+	CHECK(index.count() == live.size());
+	CHECK(index.usedBytes() == used);
+}
+
+// The tail slot past the old head doesn't reach the new slot, but it's still the oldest
+static void testStrandedTail() {
+	SpillIndex index;
+	index.reset(100);
+	std::vector<Entry> live;
+	for (size_t size : { 30, 30, 20, 15, 30, 40 }) {
+		reserve(index, live, size);
+	}
+	// [80,95) [0,30) [30,70), head at 70
+	CHECK(live.size() == 3 && live[0].offset == 80);
+
+	// Wraps, [80,95) is stranded and both slots before the old head are overwritten
+	reserve(index, live, 40);
+	CHECK(live.size() == 1 && live[0].offset == 0);
+}
+
+static void testWrapsRepeatedly() {
+	SpillIndex index;
+	index.reset(64 * 1024);
+	std::vector<Entry> live;
+	// GOP-like sizes: mostly small, some keyframe bursts near a quarter of the file
+	uint32_t seed = 12345;
+	for (int i = 0; i < 5000; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		size_t size = 512 + (seed >> 8) % 4096;
+		if (i % 37 == 0) size = 12 * 1024 + (seed >> 20);
+		reserve(index, live, size);
+	}
+	CHECK(index.laps() >= 2);
+}
+
+static void testEvictsInOrder() {
+	SpillIndex index;
+	index.reset(100);
+	std::vector<Entry> live;
+	size_t offset = 0;
+	size_t evicted = 0;
+
+	CHECK(!index.reserve(101, offset, evicted));
+	reserve(index, live, 100);
+	// A full file is replaced as a whole
+	reserve(index, live, 100);
+	CHECK(live.size() == 1 && live[0].offset == 0);
+
+	index.popFront();
+	CHECK(index.count() == 0 && index.usedBytes() == 0);
+}
+
+int main() {
+	testStrandedTail();
+	testWrapsRepeatedly();
+	testEvictsInOrder();
+	return TEST_RESULT();
+}
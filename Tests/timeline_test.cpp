@@ -0,0 +1,138 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "timeline.h"
+#include "test.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+struct Packet {
+	int stream;
+	int64_t dts;
+	int64_t pts;
+	int64_t duration;
+};
+
+// 2s of 30fps video in 1/90000 with one B-frame of reorder, so DTS starts a frame before PTS,
+// and 48kHz AAC in 1/48000 that runs `audioTailUsec` past the video
+static std::vector<Packet> makeClip(int64_t startUsec, int64_t audioTailUsec) {
+	std::vector<Packet> packets;
+	int64_t videoStart = startUsec * 90000 / 1000000;
+	int64_t audioStart = startUsec * 48000 / 1000000;
+	for (int i = 0; i < 60; i++) {
+		int64_t pts = videoStart + (i % 2 == 0 ? i + 1 : i - 1) * 3003;
+		if (i == 0) pts = videoStart;
+		packets.push_back({ 0, videoStart + (i - 1) * 3003, pts, 3003 });
+	}
+	int64_t audioFrames = (2000000 + audioTailUsec) * 48000 / 1000000 / 1024;
+	for (int64_t i = 0; i < audioFrames; i++) {
+		packets.push_back({ 1, audioStart + i * 1024, audioStart + i * 1024, 1024 });
+	}
+	return packets;
+}
+
+static int64_t firstDtsUsec(ClipTimeline& t, const std::vector<Packet>& packets) {
+	int64_t first = INT64_MAX;
+	for (const Packet& p : packets) first = std::min(first, t.toUsec(p.stream, p.dts));
+	return first;
+}
+
+static void testJoinRises() {
+	ClipTimeline t({ { 1, 90000 }, { 1, 48000 } });
+	// Replay saves don't start at zero, the second clip starts earlier than the first ended
+	std::vector<std::vector<Packet>> clips = { makeClip(5000000, 0), makeClip(1000000, 0) };
+	std::vector<int64_t> lastDts(2, INT64_MIN);
+	std::vector<int64_t> clipEnd;
+	int64_t firstOut = INT64_MAX;
+	for (auto& clip : clips) {
+		t.beginClip(firstDtsUsec(t, clip));
+		int64_t clipStart = INT64_MAX;
+		for (Packet& p : clip) {
+			t.place(p.stream, p.dts, p.pts, p.duration);
+			CHECK(p.dts > lastDts[p.stream]);
+			CHECK(p.pts >= p.dts);
+			lastDts[p.stream] = p.dts;
+			clipStart = std::min(clipStart, t.toUsec(p.stream, p.dts));
+		}
+		if (clipEnd.empty()) firstOut = clipStart;
+		else CHECK(clipStart == clipEnd.back());
+		clipEnd.push_back(t.endUsec());
+	}
+	// The first clip is pulled back to zero, its earliest DTS is where the timeline begins
+	CHECK(firstOut == 0);
+	// Each clip adds its own length, give or take the usec the offset rounds off in ticks
+	CHECK(std::llabs(clipEnd[1] - clipEnd[0] - clipEnd[0]) <= 1);
+}
+
+static void testUnevenEnds() {
+	ClipTimeline t({ { 1, 90000 }, { 1, 48000 } });
+	std::vector<Packet> first = makeClip(0, 500000);
+	t.beginClip(firstDtsUsec(t, first));
+	int64_t audioEnd = 0;
+	for (Packet& p : first) {
+		t.place(p.stream, p.dts, p.pts, p.duration);
+		if (p.stream == 1) audioEnd = t.toUsec(1, p.pts + p.duration);
+	}
+	// Audio runs longer, the next clip starts after it so the video leaves a gap rather than overlapping
+	CHECK(t.endUsec() == audioEnd);
+	std::vector<Packet> second = makeClip(0, 0);
+	t.beginClip(firstDtsUsec(t, second));
+	for (Packet& p : second) {
+		t.place(p.stream, p.dts, p.pts, p.duration);
+		CHECK(t.toUsec(p.stream, p.dts) >= audioEnd);
+	}
+}
+
+static void testCollisionBumps() {
+	ClipTimeline t({ { 1, 1000 } });
+	t.beginClip(0);
+	int64_t dts = 10, pts = 10;
+	t.place(0, dts, pts, 0);
+	CHECK(dts == 10);
+	// Same DTS again, and one that goes backwards, both land on the next tick
+	dts = 10; pts = 10;
+	t.place(0, dts, pts, 0);
+	CHECK(dts == 11);
+	CHECK(pts == 11);
+	dts = 5; pts = 20;
+	t.place(0, dts, pts, 0);
+	CHECK(dts == 12);
+	CHECK(pts == 20);
+}
+
+static void testRoundTrip() {
+	ClipTimeline t({ { 1, 90000 }, { 1, 48000 }, { 1001, 30000 } });
+	for (int stream = 0; stream < 3; stream++) {
+		for (int64_t ticks : { (int64_t)-3003, (int64_t)0, (int64_t)1, (int64_t)1024, (int64_t)123456789 }) {
+			CHECK(t.toTicks(stream, t.toUsec(stream, ticks)) == ticks);
+		}
+	}
+	CHECK(t.toUsec(0, 90000) == 1000000);
+	CHECK(t.toUsec(1, -1024) == -21333);
+}
+
+int main() {
+	testJoinRises();
+	testUnevenEnds();
+	testCollisionBumps();
+	testRoundTrip();
+	return TEST_RESULT();
+}
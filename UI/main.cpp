@@ -1,180 +1,264 @@
-/******************************************************************************
-	CONKORS COMPANION
-	www.conkors.com
-	Copyright (C) Conkors LLC
-
-	This program is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 2 of the License, or
-	(at your option) any later version.
-
-	This program is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-******************************************************************************/
-
-#define _CRT_SECURE_NO_WARNINGS
-#include "stdafx.h"
-
-#include <string>
-#include <thread>
-#include <algorithm>
-#include <dxgi.h>
-
-#include "webapi.h"
-#include "account.h"
-#include "vid.h"
-#include "img.h"
-
-#include "ConkorsCompanion.h"
-#include <QtWidgets/QApplication>
-
-static inline std::vector<std::string> queryAdapters()
-{
-	std::vector<std::string> adapters;
-
-	IDXGIFactory* dxgiFactory = nullptr;
-	HRESULT hr = CreateDXGIFactory(IID_PPV_ARGS(&dxgiFactory));
-
-	if (FAILED(hr)) {
-		throw "FAILED TO ENUMERATE VIDEO CARDS!";
-		return adapters;
-	}
-
-	// Enumerate DXGI adapters
-	IDXGIAdapter* adapter = nullptr;
-	for (UINT i = 0; dxgiFactory->EnumAdapters(i, &adapter) != DXGI_ERROR_NOT_FOUND; ++i) {
-		DXGI_ADAPTER_DESC adapterDesc;
-		hr = adapter->GetDesc(&adapterDesc);
-		if (adapterDesc.VendorId == 0x1414 && adapterDesc.DeviceId == 0x8c)
-			continue;
-		if (SUCCEEDED(hr)) {
-			std::wstring ws(adapterDesc.Description);
-			std::string adapterName(ws.begin(), ws.end());
-			adapters.push_back(adapterName);
-		}
-	}
-	dxgiFactory->Release();
-
-	return adapters;
-}
-
-static void handleMultipleInstances(const std::string& authArg) {
-	// Another instance is already running
-	// If we received an auth token, lets pipe that over and then silently exit
-	if (!authArg.empty()) {
-		HANDLE hPipe = CreateFileA("\\\\.\\pipe\\ConkorsCompanion", GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
-		if (hPipe != INVALID_HANDLE_VALUE) {
-			// Send the authentication token to the running instance
-			WriteFile(hPipe, authArg.data(), authArg.size(), NULL, NULL);
-			CloseHandle(hPipe);
-		}
-		else {
-			printf("CK::MULTI Failed to pipe auth token!!\n");
-		}
-	}
-	else {
-		// Otherwise show an error and quit
-		MessageBoxA(NULL, "Another instance of the Companion is already running.", "Application Already Running", MB_ICONINFORMATION | MB_OK);
-	}
-}
-
-int main(int argc, char *argv[])
-{
-	AllocConsole();
-	AttachConsole(GetCurrentProcessId());
-
-#ifdef _DEBUG
-	// REDIRECT COMMON STREAMS TO CONSOLE
-	FILE* fileStream;
-	freopen_s(&fileStream, "CONIN$", "r", stdin);
-	freopen_s(&fileStream, "CONOUT$", "w", stdout);
-	freopen_s(&fileStream, "CONOUT$", "w", stderr);
-#else
-	freopen("log.txt", "w", stdout);
-	setvbuf(stdout, NULL, _IONBF, 0);
-
-	// HIDE CONSOLE WINDOW
-	HWND hwndConsole = GetConsoleWindow();
-	ShowWindow(hwndConsole, SW_HIDE);
-#endif
-	// NEEDED FOR DUPLICATOR DISPLAY CAPTURE?
-	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
-
-	// AUTH PASSED IN VIA URI
-	std::string authArg;
-	if (argc == 2) {
-		authArg = std::string(argv[1]);
-	}
-
-	// CHECK MULTIPLE INSTANCES
-	HANDLE hMutex = CreateMutexA(NULL, FALSE, "ConkorsCompanion");
-	if (GetLastError() == ERROR_ALREADY_EXISTS) {
-		handleMultipleInstances(authArg);
-		return 0;
-	}
-
-	// INIT BACKEND
-	std::shared_ptr<AccountManager> accMgr = std::make_shared<AccountManager>();
-	std::shared_ptr<VidCore> vc = std::make_shared<VidCore>();
-	std::shared_ptr<ImgCore> ic = std::make_shared<ImgCore>();
-	vc->init(accMgr, queryAdapters());
-	ic->init(accMgr);
-
-	// HOTKEYS
-	std::thread([&]() {
-		bool screenshot = false;
-		bool live = false;
-		bool replay = false;
-
-		while (1) {
-			// Screenshot: ALT + A
-			if (GetAsyncKeyState(VK_MENU) & 0x8000 && (GetAsyncKeyState('A') & 1) && !screenshot) {
-				screenshot = true;
-				printf("CK::KEY SCREENSHOT!\n");
-				ic->save();
-			}
-			else if (GetAsyncKeyState('A') == 0) {
-				screenshot = false;
-			}
-
-			// Record Live: ALT + W
-			if (GetAsyncKeyState(VK_MENU) & 0x8000 && (GetAsyncKeyState('W') & 1) && !live) {
-				live = true;
-				printf("CK::KEY LIVE!\n");
-				vc->toggleRecordLive();
-			}
-			else if (GetAsyncKeyState('W') == 0) {
-				live = false;
-			}
-
-			// Save Replay ALT + D
-			if (GetAsyncKeyState(VK_MENU) & 0x8000 && (GetAsyncKeyState('D') & 1) && !replay) {
-				replay = true;
-				printf("CK::KEY REPLAY!\n");
-				vc->saveReplay();
-			}
-			else if (GetAsyncKeyState('D') == 0) {
-				replay = false;
-			}
-		}
-	}).detach();
-
-	// START REPLAY BUFFER
-	vc->recordReplay();
-
-	// SETTINGS
-	QSettings::setDefaultFormat(QSettings::IniFormat);
-	QApplication::setOrganizationName("Conkors");
-	QApplication::setApplicationName("Companion");
-
-  QApplication a(argc, argv);
-	ConkorsCompanion w(accMgr, vc, ic, authArg);
-  w.show();
-
-  return a.exec();
-}
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "stdafx.h"
+
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <dxgi.h>
+
+#include "webapi.h"
+#include "account.h"
+#include "vid.h"
+#include "img.h"
+#include "startup.h"
+#include "threads.h"
+#include "hotkeys.h"
+
+#include "ConkorsCompanion.h"
+#include <QtWidgets/QApplication>
+
+static inline std::vector<std::string> queryAdapters()
+{
+	std::vector<std::string> adapters;
+
+	IDXGIFactory* dxgiFactory = nullptr;
+	HRESULT hr = CreateDXGIFactory(IID_PPV_ARGS(&dxgiFactory));
+
+	if (FAILED(hr)) {
+		throw "FAILED TO ENUMERATE VIDEO CARDS!";
+		return adapters;
+	}
+
+	// Enumerate DXGI adapters
+	IDXGIAdapter* adapter = nullptr;
+	for (UINT i = 0; dxgiFactory->EnumAdapters(i, &adapter) != DXGI_ERROR_NOT_FOUND; ++i) {
+		DXGI_ADAPTER_DESC adapterDesc;
+		hr = adapter->GetDesc(&adapterDesc);
+		if (adapterDesc.VendorId == 0x1414 && adapterDesc.DeviceId == 0x8c)
+			continue;
+		if (SUCCEEDED(hr)) {
+			std::wstring ws(adapterDesc.Description);
+			std::string adapterName(ws.begin(), ws.end());
+			adapters.push_back(adapterName);
+		}
+	}
+	dxgiFactory->Release();
+
+	return adapters;
+}
+
+static void handleMultipleInstances(const std::string& authArg) {
+	// Another instance is already running
+	// If we received an auth token, lets pipe that over and then silently exit
+	if (!authArg.empty()) {
+		HANDLE hPipe = CreateFileA("\\\\.\\pipe\\ConkorsCompanion", GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+		if (hPipe != INVALID_HANDLE_VALUE) {
+			// Send the authentication token to the running instance
+			WriteFile(hPipe, authArg.data(), authArg.size(), NULL, NULL);
+			CloseHandle(hPipe);
+		}
+		else {
+			printf("CK::MULTI Failed to pipe auth token!!\n");
+		}
+	}
+	else {
+		// Otherwise show an error and quit
+		MessageBoxA(NULL, "Another instance of the Companion is already running.", "Application Already Running", MB_ICONINFORMATION | MB_OK);
+	}
+}
+
+// Bindings from the settings file, e.g. [Hotkeys] SaveReplay=Ctrl+Shift+F9
+static std::vector<HotkeyService::Binding> loadHotkeys(const std::vector<int>& windows) {
+	QSettings settings;
+	settings.beginGroup("Hotkeys");
+	std::vector<HotkeyService::Binding> bindings = {
+		{ HotkeyService::SCREENSHOT, 0, settings.value("Screenshot", "Alt+A").toString().toStdString() },
+		{ HotkeyService::TOGGLE_LIVE, 0, settings.value("ToggleLive", "Alt+W").toString().toStdString() },
+		{ HotkeyService::SAVE_REPLAY, 0, settings.value("SaveReplay", "Alt+D").toString().toStdString() },
+	};
+	// Extra replay windows: Alt+1/2/3 unless rebound
+	for (size_t i = 0; i < windows.size() && i < 9; i++) {
+		QString key = QString("SaveWindow%1").arg(i + 1);
+		QString fallback = QString("Alt+%1").arg(i + 1);
+		bindings.push_back({ HotkeyService::SAVE_WINDOW, (int)i, settings.value(key, fallback).toString().toStdString() });
+	}
+	return bindings;
+}
+
+static void startHotkeys(HotkeyService& hotkeys, std::shared_ptr<VidCore> vc, std::shared_ptr<ImgCore> ic) {
+	std::vector<int> windows = vc->getReplayWindows();
+	hotkeys.setBindings(loadHotkeys(windows));
+	hotkeys.setHandler([vc, ic](const HotkeyService::Event& ev) {
+		switch (ev.action) {
+		case HotkeyService::SCREENSHOT:
+			printf("CK::KEY SCREENSHOT!\n");
+			ic->save();
+			break;
+		case HotkeyService::TOGGLE_LIVE:
+			printf("CK::KEY LIVE!\n");
+			vc->queueCommand([vc]() { vc->toggleRecordLive(); });
+			break;
+		case HotkeyService::SAVE_REPLAY:
+			printf("CK::KEY REPLAY!\n");
+			vc->queueCommand([vc, ev]() { vc->saveReplay(0, ev.pressNs); });
+			break;
+		case HotkeyService::SAVE_WINDOW: {
+			int seconds = vc->getReplayWindows()[ev.arg];
+			printf("CK::KEY REPLAY %ds!\n", seconds);
+			vc->queueCommand([vc, seconds, ev]() { vc->saveReplay(seconds, ev.pressNs); });
+			break;
+		}
+		}
+	});
+	if (!hotkeys.start()) {
+		printf("CK::KEY No hotkeys registered!\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	AllocConsole();
+	AttachConsole(GetCurrentProcessId());
+
+#ifdef _DEBUG
+	// REDIRECT COMMON STREAMS TO CONSOLE
+	FILE* fileStream;
+	freopen_s(&fileStream, "CONIN$", "r", stdin);
+	freopen_s(&fileStream, "CONOUT$", "w", stdout);
+	freopen_s(&fileStream, "CONOUT$", "w", stderr);
+#else
+	freopen("log.txt", "w", stdout);
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	// HIDE CONSOLE WINDOW
+	HWND hwndConsole = GetConsoleWindow();
+	ShowWindow(hwndConsole, SW_HIDE);
+#endif
+	// NEEDED FOR DUPLICATOR DISPLAY CAPTURE?
+	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+
+	// AUTH PASSED IN VIA URI
+	std::string authArg;
+	if (argc == 2) {
+		authArg = std::string(argv[1]);
+	}
+
+	// CHECK MULTIPLE INSTANCES
+	HANDLE hMutex = CreateMutexA(NULL, FALSE, "ConkorsCompanion");
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		handleMultipleInstances(authArg);
+		return 0;
+	}
+
+	// SETTINGS
+	QSettings::setDefaultFormat(QSettings::IniFormat);
+	QApplication::setOrganizationName("Conkors");
+	QApplication::setApplicationName("Companion");
+
+	// BACKEND OBJECTS, init happens in the startup graph below
+	std::shared_ptr<AccountManager> accMgr = std::make_shared<AccountManager>();
+	std::shared_ptr<VidCore> vc = std::make_shared<VidCore>();
+	std::shared_ptr<ImgCore> ic = std::make_shared<ImgCore>();
+	QSettings settings;
+	vc->setQualityPreset((VidCore::QualityPreset)settings.value("QualityPreset", VidCore::BALANCED).toInt());
+	vc->setReplayLength(settings.value("ReplaySeconds", 30).toInt());
+	vc->setUploadTrim(settings.value("UploadTrimSeconds", 0).toInt());
+	vc->setHighlightThreshold(settings.value("HighlightThresholdDb", 10.0).toFloat());
+	vc->setAutoHighlights(settings.value("AutoHighlights", false).toBool());
+	vc->setMetricsPort(settings.value("MetricsPort", 9477).toInt());
+	vc->setHotkeySaveOffset(settings.value("HotkeySaveOffsetMs", 0).toInt());
+	QRect region = settings.value("CaptureRegion").toRect();
+	if (region.isValid()) {
+		VidCore::CaptureRegion roi;
+		roi.x = region.x();
+		roi.y = region.y();
+		roi.width = region.width();
+		roi.height = region.height();
+		vc->setCaptureRegion(roi);
+	}
+	// Core masks such as 0xF0, read before any of our threads start
+	const std::pair<const char*, threads::Role> affinityKeys[] = {
+		{ "GraphicsAffinity", threads::GRAPHICS },
+		{ "EncodeAffinity", threads::ENCODE },
+		{ "BackgroundAffinity", threads::BACKGROUND },
+	};
+	for (const auto& key : affinityKeys) {
+		threads::setAffinity(key.second, settings.value(key.first, "0").toString().toULongLong(nullptr, 0));
+	}
+
+	// UI FIRST, VidCore fills it in once it's up
+	QApplication a(argc, argv);
+	ConkorsCompanion w(accMgr, vc, ic, authArg);
+	w.show();
+
+	// INIT BACKEND
+	std::vector<std::string> adapters;
+	HotkeyService hotkeys;
+	Startup startup;
+	startup.add("adapters", {}, [&adapters]() {
+		try {
+			adapters = queryAdapters();
+		}
+		catch (const char* err) {
+			printf("CK::START %s\n", err);
+		}
+		return true;
+	});
+	startup.add("video", { "adapters" }, [&]() {
+		if (!vc->init(accMgr, adapters)) return false;
+		// START REPLAY BUFFER
+		vc->queueCommand([vc]() { vc->recordReplay(); });
+		QMetaObject::invokeMethod(&w, [&w]() { w.onBackendReady(); }, Qt::QueuedConnection);
+		return true;
+	});
+	// The overlay window has to belong to the UI thread, its messages are pumped there.
+	// Settled once, by the UI thread or by main when the event loop ends before the init ran
+	auto imagesResult = std::make_shared<std::promise<bool>>();
+	auto imagesSettled = std::make_shared<std::atomic<bool>>(false);
+	auto settleImages = [imagesResult, imagesSettled](bool ok) {
+		if (!imagesSettled->exchange(true)) imagesResult->set_value(ok);
+	};
+	std::future<bool> imagesReady = imagesResult->get_future();
+	startup.add("images", {}, [&]() {
+		QMetaObject::invokeMethod(&a, [&, imagesSettled, settleImages]() {
+			if (imagesSettled->load()) return;
+			settleImages(ic->init(accMgr));
+		}, Qt::QueuedConnection);
+		return imagesReady.get();
+	});
+	startup.add("hotkeys", { "video", "images" }, [&]() {
+		startHotkeys(hotkeys, vc, ic);
+		return true;
+	});
+	startup.run([&startup](bool) {
+		startup.logReport();
+	});
+
+	int ret = a.exec();
+	// Quit before the queued image init ran, it never will now
+	settleImages(false);
+	startup.wait();
+	return ret;
+}
@@ -1,59 +1,59 @@
-/******************************************************************************
-	CONKORS COMPANION
-	www.conkors.com
-	Copyright (C) Conkors LLC
-
-	This program is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 2 of the License, or
-	(at your option) any later version.
-
-	This program is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-******************************************************************************/
-
-#pragma once
-
-#include <QtWidgets/QWidget>
-#include <QObject>
-#include <QThread>
-#include <QSoundEffect>
-
-class AudioFx : public QObject
-{
-    Q_OBJECT
-public:
-    AudioFx();
-    ~AudioFx();
-
-    void playUploaded();
-    void playStartedLive();
-    void playStoppedLive();
-    void playSavedReplay();
-
-signals:
-    void notifyUploaded();
-    void notifyStartedLive();
-    void notifyStoppedLive();
-    void notifySavedReplay();
-
-private slots:
-    void playUploadedInternal();
-    void playStartedLiveInternal();
-    void playStoppedLiveInternal();
-    void playSavedReplayInternal();
-    void cleanup();
-
-private:
-    QSoundEffect uploaded;
-    QSoundEffect startedLive;
-    QSoundEffect stoppedLive;
-    QSoundEffect savedReplay;
-
-    std::unique_ptr<QThread> m_thread;
-};
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <QtWidgets/QWidget>
+#include <QObject>
+#include <QThread>
+#include <QSoundEffect>
+
+class AudioFx : public QObject
+{
+    Q_OBJECT
+public:
+    AudioFx();
+    ~AudioFx();
+
+    void playUploaded();
+    void playStartedLive();
+    void playStoppedLive();
+    void playSavedReplay();
+
+signals:
+    void notifyUploaded();
+    void notifyStartedLive();
+    void notifyStoppedLive();
+    void notifySavedReplay();
+
+private slots:
+    void playUploadedInternal();
+    void playStartedLiveInternal();
+    void playStoppedLiveInternal();
+    void playSavedReplayInternal();
+    void cleanup();
+
+private:
+    QSoundEffect uploaded;
+    QSoundEffect startedLive;
+    QSoundEffect stoppedLive;
+    QSoundEffect savedReplay;
+
+    std::unique_ptr<QThread> m_thread;
+};
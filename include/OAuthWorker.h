@@ -1,47 +1,47 @@
-/******************************************************************************
-	CONKORS COMPANION
-	www.conkors.com
-	Copyright (C) Conkors LLC
-
-	This program is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 2 of the License, or
-	(at your option) any later version.
-
-	This program is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-******************************************************************************/
-
-#pragma once
-
-#include <QtWidgets/QWidget>
-#include <QObject>
-#include <QThread>
-
-class OAuthWorker : public QObject
-{
-    Q_OBJECT
-public:
-    OAuthWorker();
-    ~OAuthWorker();
-
-    void listenForToken();
-
-public slots:
-    void doWork();
-
-signals:
-    void start();
-    void tokenReceived(const QString& authToken);
-
-private slots:
-    void cleanup();
-
-private:
-    std::unique_ptr<QThread> m_thread;
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <QtWidgets/QWidget>
+#include <QObject>
+#include <QThread>
+
+class OAuthWorker : public QObject
+{
+    Q_OBJECT
+public:
+    OAuthWorker();
+    ~OAuthWorker();
+
+    void listenForToken();
+
+public slots:
+    void doWork();
+
+signals:
+    void start();
+    void tokenReceived(const QString& authToken);
+
+private slots:
+    void cleanup();
+
+private:
+    std::unique_ptr<QThread> m_thread;
 };
\ No newline at end of file
@@ -0,0 +1,38 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Lossless clip editing on finished MP4s, packets are copied and never decoded
+namespace clip {
+
+// Keeps the last `lastSeconds` of input, starting on the nearest keyframe at or before the cut
+bool trim(const std::string& input, const std::string& output, double lastSeconds);
+
+// Joins clips back to back on one rising timeline, all inputs must share codec parameters
+bool concat(const std::vector<std::string>& inputs, const std::string& output);
+
+// Trims the last 10s off input `count` times, then joins `count` of those, time & MB/s for both.
+// The outputs go next to input & are deleted after
+bool benchmark(const std::string& input, int count);
+
+}
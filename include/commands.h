@@ -0,0 +1,75 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// One worker running reconfigurations in submission order, the only thread that mutates its owner
+class CommandQueue {
+public:
+	using Command = std::function<void()>;
+
+	explicit CommandQueue();
+	~CommandQueue();
+
+	// afterEach runs on the worker after every command, before that command's done
+	void start(Command afterEach);
+	// Drops whatever is still queued, queue() fails from here on
+	void stop();
+
+	// Accepted before start() too, they run once it's called. False once stopped
+	bool queue(Command cmd, Command done = nullptr);
+	// Queues cmd & waits for it, runs it inline when called from a command.
+	// False if it was dropped instead of run
+	bool run(Command cmd);
+
+	bool onWorker();
+
+private:
+	std::thread thread_;
+	std::thread::id threadId_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::deque<std::pair<Command, Command>> commands_;
+	Command afterEach_;
+	bool running_;
+	bool closed_;
+
+	void loop();
+};
+
+// Immutable value readers can grab without waiting on the writer, replaced whole on publish
+template <typename T>
+class Snapshot {
+public:
+	explicit Snapshot() : value_(std::make_shared<const T>()) {}
+
+	std::shared_ptr<const T> get() const { return std::atomic_load(&value_); }
+	void publish(std::shared_ptr<const T> value) { std::atomic_store(&value_, std::move(value)); }
+
+private:
+	std::shared_ptr<const T> value_; // std::atomic_load/store only
+};
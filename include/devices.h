@@ -0,0 +1,73 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#include "scheduler.h"
+
+using propListStr = std::vector<std::pair<std::string, std::string>>;
+using propListInt = std::vector<std::pair<std::string, int>>;
+
+struct IMMDeviceEnumerator;
+class AudioEndpointListener;
+
+// Capture device lists enumerated in the background and cached.
+// Audio follows endpoint notifications, displays & windows have none so they are polled and diffed.
+class DeviceRegistry {
+public:
+	struct Lists {
+		propListStr monitors;
+		propListStr windows;
+		propListStr speakers;
+		propListStr mics;
+	};
+
+	explicit DeviceRegistry();
+	~DeviceRegistry();
+
+	// All enumeration runs on the scheduler's thread, onChange too, and only when a list differs
+	void start(Scheduler* scheduler, std::function<void()> onChange);
+	void stop();
+
+	Lists get();
+
+private:
+	Scheduler* scheduler_;
+	std::function<void()> onChange_;
+
+	std::mutex mtx_;
+	Lists lists_;
+	Scheduler::TimerId pollTimer_;
+
+	IMMDeviceEnumerator* enumerator_;
+	AudioEndpointListener* listener_;
+
+	void registerEndpoints();
+	void refreshAudio();
+	void refreshVideo();
+	// True if the cached list changed
+	bool store(propListStr Lists::* field, propListStr items);
+
+	static propListStr enumerate(const char* sourceId, const char* prop);
+};
@@ -0,0 +1,43 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Standalone encodes of a fixed synthetic clip, so codecs & encoders can be compared run to run
+namespace encode {
+
+struct BenchResult {
+	int frames;
+	uint64_t bytes;  // Bitstream only, no container
+	double wallMs;   // Inside the encoder calls, hardware encoders mostly show up here
+	double cpuMs;    // Calling thread's CPU time inside the encoder calls
+	double psnr;     // Luma PSNR in dB of the decoded clip against the source, 0 when it couldn't be decoded
+};
+
+// FFmpeg encoder behind a libobs encoder id, empty when there is none
+std::string ffmpegEncoderFor(const std::string& obsEncoderId);
+
+// Encodes `frames` frames of the reference pattern at a constant bitrate on the calling thread,
+// then decodes them to measure quality. Frame generation & decoding are left out of the timings
+bool benchmark(const std::string& ffmpegEncoder, int width, int height, int fps, int frames, int bitrateKbps, BenchResult& result);
+
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <complex>
+
+// Flags sudden loud, broadband moments in one audio source: short-window loudness against a
+// slow running level, plus spectral flux against its own running spread.
+class HighlightDetector {
+public:
+	static const int HOP = 1024; // ~21ms at 48kHz
+
+	explicit HighlightDetector();
+
+	// dB the current hop has to jump over the running level, lower is more sensitive
+	void setThreshold(float db);
+	float getThreshold();
+	void reset();
+
+	// Planar float audio, the first two channels are mixed down. True if a finished hop was an event
+	bool feed(const float* const* planes, int channels, uint32_t frames);
+
+	// Runs a 48kHz fixture through feed() and logs CPU share of one core & the events found.
+	// Empty path synthesizes a noise bed with loud bursts every 10s, otherwise a PCM16/float WAV.
+	// False if the WAV couldn't be read
+	static bool benchmark(const std::string& wavPath);
+
+private:
+	std::atomic<float> thresholdDb_;
+
+	std::vector<float> hop_;
+	int filled_;
+	std::vector<float> window_;
+	std::vector<std::complex<float>> twiddles_;
+	std::vector<uint16_t> bitrev_;
+	std::vector<std::complex<float>> spectrum_;
+	std::vector<float> magnitude_;
+	std::vector<float> prevMagnitude_;
+
+	// Running baselines
+	uint32_t hops_;
+	float levelDb_;
+	float fluxMean_;
+	float fluxVar_;
+
+	bool processHop();
+	void fft();
+};
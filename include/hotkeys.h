@@ -0,0 +1,144 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single producer, single consumer ring, push & pop never lock or wait
+template <typename T, size_t N>
+class SpscQueue {
+public:
+	SpscQueue() {
+		head_ = 0;
+		tail_ = 0;
+	}
+
+	// False when full
+	bool push(const T& item) {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % N;
+		if (next == head_.load(std::memory_order_acquire)) return false;
+		items_[tail] = item;
+		tail_.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& item) {
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire)) return false;
+		item = items_[head];
+		head_.store((head + 1) % N, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+
+private:
+	T items_[N];
+	alignas(64) std::atomic<size_t> head_; // Consumer side
+	alignas(64) std::atomic<size_t> tail_; // Producer side
+};
+
+// Global hotkeys from OS key events: RegisterHotKey on Windows, evdev on Linux.
+// The listener thread only stamps & queues, actions run on a dispatch thread so a
+// slow save never holds up the next key
+class HotkeyService {
+public:
+	enum Action {
+		SCREENSHOT,
+		TOGGLE_LIVE,
+		SAVE_REPLAY,
+		SAVE_WINDOW // arg is the replay window's index
+	};
+
+	struct Binding {
+		Action action;
+		int arg;
+		std::string keys; // "Alt+D", "Ctrl+Shift+F9"
+	};
+
+	struct Event {
+		Action action;
+		int arg;
+		uint64_t pressNs; // steady_clock ns, os_gettime_ns' clock. From the key event itself where the OS has it
+	};
+
+	explicit HotkeyService();
+	~HotkeyService();
+
+	// Takes effect on the next start(), restarts a running service
+	void setBindings(const std::vector<Binding>& bindings);
+	// Dispatch thread only, set before start()
+	void setHandler(std::function<void(const Event&)> handler);
+
+	// False when no binding could be registered
+	bool start();
+	void stop();
+
+	enum Modifier {
+		ALT = 1,
+		CTRL = 2,
+		SHIFT = 4,
+		SUPER = 8
+	};
+
+	// Alt, Ctrl, Shift & Win modifiers on A-Z, 0-9 or F1-F12, code is the platform's key code
+	static bool parseKeys(const std::string& keys, uint32_t& modifiers, uint32_t& code);
+
+private:
+	struct Key {
+		uint32_t modifiers;
+		uint32_t code; // Virtual key on Windows, evdev KEY_* on Linux
+		Action action;
+		int arg;
+	};
+
+	std::vector<Binding> bindings_;
+	std::vector<Key> keys_;
+	std::function<void(const Event&)> handler_;
+
+	SpscQueue<Event, 64> queue_;
+	std::atomic<uint64_t> dropped_;
+	std::atomic<bool> running_;
+	std::thread listener_;
+	std::thread dispatcher_;
+	// Only for the dispatcher to sleep on, the queue itself is lock-free
+	std::mutex wakeMtx_;
+	std::condition_variable wakeCv_;
+
+#ifdef _WIN32
+	std::atomic<unsigned long> listenerId_;
+#else
+	int stopFd_;
+#endif
+
+	void post(const Event& ev);
+	void listenLoop(std::function<void(bool)> ready);
+	void dispatchLoop();
+};
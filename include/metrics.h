@@ -0,0 +1,138 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Log2 buckets of microseconds, lock-free to record from any worker
+class LatencyHistogram {
+public:
+	static const int BUCKETS = 28; // Last bucket holds everything above ~67s
+
+	explicit LatencyHistogram();
+
+	void record(uint64_t ns);
+	uint64_t count();
+	uint64_t sumNs();
+	uint64_t bucket(int idx);
+	// Inclusive upper bound of a bucket, in us
+	static uint64_t bucketBoundUs(int idx);
+	// Upper bound of the bucket containing the given percentile, in ms
+	double percentileMs(double p);
+
+private:
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets_;
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sumNs_;
+};
+
+// Monotonic, lock-free
+class Counter {
+public:
+	explicit Counter();
+
+	void add(uint64_t n = 1);
+	// Adds how far a sampled running total moved, a total that went backwards (libobs reset) counts from zero
+	void addSample(uint64_t total, uint64_t& lastTotal);
+	uint64_t value();
+
+private:
+	std::atomic<uint64_t> value_;
+};
+
+// Last value wins, lock-free
+class Gauge {
+public:
+	explicit Gauge();
+
+	void set(double v);
+	double value();
+
+private:
+	std::atomic<double> value_;
+};
+
+// Named metrics with optional labels. Registering takes a lock, recording never does.
+// Anything registered has to outlive the registry's readers, owned metrics live as long as the registry
+class MetricsRegistry {
+public:
+	explicit MetricsRegistry();
+
+	// labels is Prometheus label syntax without braces, e.g. stage="upload"
+	Counter* counter(const std::string& name, const std::string& help, const std::string& labels = "");
+	Gauge* gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	LatencyHistogram* histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+	// For histograms owned elsewhere, e.g. the pipeline's stage queues
+	void addHistogram(const std::string& name, const std::string& help, const std::string& labels, LatencyHistogram* hist);
+
+	// Text exposition format 0.0.4, histograms in seconds
+	std::string renderPrometheus();
+	// "name{labels} value" per line, histograms as count/p50/p99, for the settings page
+	std::string renderSummary();
+
+private:
+	enum Type {
+		COUNTER,
+		GAUGE,
+		HISTOGRAM
+	};
+
+	struct Entry {
+		std::string name;
+		std::string help;
+		std::string labels;
+		Type type;
+		Counter* counter;
+		Gauge* gauge;
+		LatencyHistogram* histogram;
+	};
+
+	std::mutex mtx_;
+	std::vector<Entry> entries_;
+	std::vector<std::unique_ptr<Counter>> counters_;
+	std::vector<std::unique_ptr<Gauge>> gauges_;
+	std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+
+	void add(const Entry& entry);
+};
+
+// Serves GET /metrics on 127.0.0.1 only, one short-lived connection at a time
+class MetricsServer {
+public:
+	explicit MetricsServer();
+	~MetricsServer();
+
+	bool start(MetricsRegistry* registry, uint16_t port);
+	void stop();
+
+private:
+	MetricsRegistry* registry_;
+	uintptr_t listener_; // SOCKET, kept out of the header
+	std::thread thread_;
+	std::atomic<bool> running_;
+
+	void loop();
+};
@@ -0,0 +1,55 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+// Opens libobs plugin modules the first time something needs them instead of all at boot.
+// libobs can't unload a module, so the saving is in never loading the ones a config doesn't use.
+class ModuleManager {
+public:
+	explicit ModuleManager();
+
+	// Opens & inits once, later calls just return the first result
+	bool require(const std::string& module);
+	// Loads whichever module registers an encoder/source/output id, true for ids built into libobs or our own
+	bool requireFor(const std::string& typeId);
+	bool isLoaded(const std::string& module);
+
+	static const char* moduleFor(const std::string& typeId);
+
+	// Load time & memory per module, plus the known ones that were never needed
+	void logReport();
+
+private:
+	struct Entry {
+		std::string name;
+		bool loaded;
+		double ms;
+		int64_t memoryBytes; // Private bytes delta across the load, other threads add noise
+	};
+
+	std::mutex mtx_;
+	std::vector<Entry> modules_;
+
+	Entry* find(const std::string& module);
+};
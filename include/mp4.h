@@ -0,0 +1,60 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Box level MP4 helpers, nothing here decodes media
+namespace mp4 {
+
+struct Box {
+	uint64_t offset;
+	uint64_t size;       // Including header
+	uint32_t headerSize; // 8, or 16 with a 64 bit size
+	char type[5];
+};
+
+// Top level boxes of a file, empty if it isn't a readable MP4
+std::vector<Box> readBoxes(const std::string& path);
+
+// True when moov already precedes the first mdat
+bool isFaststart(const std::string& path);
+
+// Moves moov ahead of mdat and patches stco/co64 offsets.
+// Rewrites in place when a free box before mdat can hold moov, otherwise
+// does a single sequential copy and replaces the file.
+bool faststart(const std::string& path);
+
+// Recordings in progress carry a <path>.partial marker, one left behind means the writer died
+std::string partialMarker(const std::string& path);
+bool markPartial(const std::string& path);
+void clearPartial(const std::string& path);
+
+// Cuts a fragmented MP4 back to its last complete moof/mdat pair so it plays.
+// False when not even one fragment made it to disk
+bool recoverFragmented(const std::string& path);
+
+// Faststart throughput on a synthetic `megabytes` recording written to dir, through the copy and
+// the in place rewrite. False if either one didn't end up faststart
+bool benchmark(const std::string& dir, int megabytes);
+
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "metrics.h"
+
+// Work that follows a finished recording, each stage on its own bounded worker pool
+class PostSavePipeline {
+public:
+	enum Stage {
+		FINALIZE = 0,
+		FASTSTART,
+		THUMBNAIL,
+		UPLOAD,
+		NOTIFY,
+		STAGE_COUNT
+	};
+
+	struct Job {
+		std::string filePath;   // As saved by libobs
+		std::string uploadPath; // What actually goes up, may be trimmed/remuxed
+		std::string thumbPath;  // Poster frame, empty if none was made
+		std::string spritePath;
+		bool thumbsUploaded;
+		int uploadAttempts;
+		std::string stageId;
+		uint64_t stageStartNs;
+		std::array<double, STAGE_COUNT> stageMs;
+	};
+
+	// Returning false drops the job
+	using StageFn = std::function<bool(Job&)>;
+
+	explicit PostSavePipeline();
+	~PostSavePipeline();
+
+	void setStage(Stage stage, int workers, size_t capacity, StageFn fn);
+	void start();
+	void stop();
+
+	// Never blocks, safe from libobs signal threads
+	bool enqueue(const std::string& filePath);
+	// Puts a job back in at a given stage, e.g. a deferred retry. Never blocks
+	bool resubmit(Stage stage, const Job& job);
+
+	void logStats();
+	// Stage wait/run histograms, the pipeline has to outlive the registry's readers
+	void registerMetrics(MetricsRegistry& registry);
+
+private:
+	struct StageQueue {
+		const char* name;
+		StageFn fn;
+		int workers;
+		size_t capacity;
+
+		std::mutex mtx;
+		std::condition_variable notEmpty;
+		std::condition_variable notFull;
+		std::deque<Job> jobs;
+		std::vector<std::thread> threads;
+
+		LatencyHistogram wait; // Queued until picked up
+		LatencyHistogram run;  // Inside the stage function
+	};
+
+	std::array<StageQueue, STAGE_COUNT> stages_;
+	std::atomic<bool> running_;
+
+	void worker(Stage stage);
+	void push(Stage stage, Job job);
+};
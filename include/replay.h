@@ -0,0 +1,156 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <obs.h>
+
+#include "spill.h"
+
+#define REPLAY_RING_OUTPUT_ID "ck_replay_ring"
+
+// One encoded packet, payload lives in the owning GOP's buffer or spill slot
+struct ReplayPacket {
+	obs_encoder_type type;
+	size_t track;
+	int64_t pts;
+	int64_t dts;
+	int32_t timebaseNum;
+	int32_t timebaseDen;
+	int64_t dtsUsec;
+	int64_t sysDtsUsec;
+	bool keyframe;
+	int priority;
+	size_t offset;
+	size_t size;
+};
+
+// A video keyframe plus everything (video & audio) received until the next one
+struct ReplayGop {
+	uint64_t seq;
+	int64_t startUsec;
+	int64_t endUsec;
+	std::vector<ReplayPacket> packets;
+	std::vector<uint8_t> data; // Empty once spilled
+	size_t diskOffset;
+	size_t diskSize;
+};
+
+// Codec parameters captured when the output starts, needed to mux without re-encoding
+struct ReplayStreamInfo {
+	std::string videoCodec;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fpsNum;
+	uint32_t fpsDen;
+	std::vector<uint8_t> videoExtra;
+	uint32_t sampleRate;
+	uint32_t channels;
+	std::vector<uint8_t> audioExtra;
+};
+
+// Preallocated memory-mapped file used as a circular byte store
+class SpillFile {
+public:
+	explicit SpillFile();
+	~SpillFile();
+
+	bool open(const std::string& path, size_t capacity);
+	void close();
+
+	uint8_t* data() { return view_; }
+	size_t capacity() { return capacity_; }
+
+private:
+	std::string path_;
+	HANDLE file_;
+	HANDLE mapping_;
+	uint8_t* view_;
+	size_t capacity_;
+};
+
+// Two tier packet history: recent GOPs in RAM, older GOPs spilled to disk
+class ReplayRing {
+public:
+	explicit ReplayRing();
+	~ReplayRing();
+
+	bool open(const std::string& spillPath, size_t spillBytes, int memorySeconds, size_t memoryBytes, int maxSeconds);
+	void close();
+	void clear();
+
+	void push(const struct encoder_packet* pkt);
+
+	// GOPs overlapping [fromUsec, now], spilled ones are read back into memory
+	std::vector<std::shared_ptr<const ReplayGop>> snapshot(int64_t fromUsec);
+	int64_t latestUsec();
+	int64_t oldestUsec();
+	// Capture time (os_gettime_ns clock, in usec) of the newest video frame, & the dts it maps to
+	int64_t latestSysUsec();
+	int64_t sysToDtsUsec(int64_t sysUsec);
+
+	size_t memoryBytes();
+	size_t diskBytes();
+
+private:
+	std::mutex mtx_;
+	SpillFile spill_;
+	bool spillEnabled_;
+
+	int64_t memoryUsec_;
+	size_t memoryLimit_;
+	int64_t maxUsec_;
+
+	uint64_t nextSeq_;
+	std::shared_ptr<ReplayGop> open_;
+	std::deque<std::shared_ptr<ReplayGop>> memory_;
+	std::deque<std::shared_ptr<ReplayGop>> disk_; // One per diskIndex_ slot, same order
+	SpillIndex diskIndex_;
+	size_t memoryBytes_;
+	int64_t videoDtsUsec_;
+	int64_t videoSysUsec_;
+
+	void reset();
+	void closeGop();
+	void enforceLimits();
+	bool spillGop(std::shared_ptr<ReplayGop> gop);
+};
+
+namespace replay {
+
+// Registers the ck_replay_ring output type, call once after obs_startup
+void registerOutput();
+
+// Writes the packets in [fromUsec, toUsec] to an MP4 without re-encoding
+bool writeMp4(const std::string& path,
+			const ReplayStreamInfo& info,
+			const std::vector<std::shared_ptr<const ReplayGop>>& gops,
+			int64_t fromUsec,
+			int64_t toUsec);
+
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Compares each frame's downscaled luma against the previous one tile by tile.
+// Screen capture is lossless so unchanged tiles match to the byte, the threshold only has to swallow scaler rounding.
+class ChangeDetector {
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 144;
+	static const int TILE = 16; // 16x9 tiles
+
+	explicit ChangeDetector(uint32_t tileThreshold = 64);
+
+	// luma is WIDTH x HEIGHT, true if any tile moved. The first frame always counts as changed
+	bool feed(const uint8_t* luma, uint32_t linesize);
+	int changedTiles() const;
+	void reset();
+
+	// Synthetic static/moving stream through feed(), logs cost per frame & how much was classified static
+	static void benchmark(int frames);
+
+private:
+	uint32_t tileThreshold_;
+	std::vector<uint8_t> prev_;
+	bool hasPrev_;
+	int changedTiles_;
+};
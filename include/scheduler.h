@@ -0,0 +1,93 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+// Hashed timer wheel run by a single thread, replaces one-off sleeping threads.
+// Ids carry a generation, so a cancelled or already fired id can never hit a newer timer.
+class Scheduler {
+public:
+	using TimerId = uint64_t;
+	using Task = std::function<void()>;
+
+	static const TimerId INVALID_TIMER = 0;
+
+	explicit Scheduler(uint32_t tickMs = 10, uint32_t slots = 512);
+	~Scheduler();
+
+	// Drives the wheel from a thread on the steady clock, without it only tick() advances time
+	void start();
+	void stop();
+
+	TimerId schedule(uint64_t delayMs, Task task);
+	TimerId scheduleEvery(uint64_t periodMs, Task task);
+	// False if the timer already fired or was cancelled
+	bool cancel(TimerId id);
+	// Only the last task scheduled under a key within delayMs runs
+	void debounce(const std::string& key, uint64_t delayMs, Task task);
+
+	// Advances to nowMs and runs what's due on the calling thread, lets a virtual clock drive it
+	void tick(uint64_t nowMs);
+	uint64_t nowMs();
+
+private:
+	struct Timer {
+		Task task;
+		uint64_t deadlineMs;
+		uint64_t periodMs; // 0 for one shot
+		uint32_t generation;
+		bool active;
+	};
+
+	struct Entry {
+		uint32_t index;
+		uint32_t generation;
+	};
+
+	uint32_t tickMs_;
+	std::vector<std::vector<Entry>> wheel_;
+	std::vector<Timer> timers_;
+	std::vector<uint32_t> freeTimers_;
+	std::unordered_map<std::string, TimerId> debounced_;
+	uint64_t currentMs_; // Time of the last tick
+	uint64_t lastTick_;
+
+	std::mutex mtx_;
+	std::condition_variable wake_;
+	std::thread thread_;
+	std::atomic<bool> running_;
+	std::chrono::steady_clock::time_point epoch_;
+
+	TimerId add(uint64_t delayMs, uint64_t periodMs, Task task);
+	TimerId addLocked(uint64_t now, uint64_t delayMs, uint64_t periodMs, Task task);
+	bool cancelLocked(TimerId id);
+	void insert(uint32_t index);
+	void release(uint32_t index);
+	void loop();
+};
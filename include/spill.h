@@ -0,0 +1,53 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+// Placement for a circular byte store: contiguous slots, written & evicted in FIFO order
+class SpillIndex {
+public:
+	explicit SpillIndex();
+
+	void reset(size_t capacity);
+
+	// Slot for size bytes after the newest one, wrapping to the start when the tail is too short.
+	// evicted is how many of the oldest slots it overwrote, they are already gone from the index
+	bool reserve(size_t size, size_t& offset, size_t& evicted);
+	void popFront();
+
+	size_t capacity() { return capacity_; }
+	size_t usedBytes() { return used_; }
+	size_t count() { return slots_.size(); }
+	// Times the head went back to the start
+	size_t laps() { return laps_; }
+
+private:
+	struct Slot {
+		size_t offset;
+		size_t size;
+	};
+	std::deque<Slot> slots_;
+	size_t capacity_;
+	size_t head_;
+	size_t used_;
+	size_t laps_;
+};
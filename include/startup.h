@@ -0,0 +1,84 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+// Runs init steps as a dependency graph, each step gets its own thread as soon as everything it needs is done.
+// A failed step skips everything downstream of it, the rest still runs.
+class Startup {
+public:
+	using Step = std::function<bool()>;
+
+	Startup();
+	~Startup();
+
+	// Steps must be added before run(), deps are step names
+	void add(const std::string& name, const std::vector<std::string>& deps, Step step);
+	// Non-blocking, false on an unknown dep or a cycle. done runs on the thread of the last step to finish
+	bool run(std::function<void(bool)> done = nullptr);
+	// Blocks until every step finished or was skipped, don't call from a step or done
+	void wait();
+	// Per-step offsets & durations relative to run()
+	void logReport();
+
+private:
+	enum State {
+		PENDING,
+		RUNNING,
+		DONE,
+		FAILED,
+		SKIPPED
+	};
+
+	struct Phase {
+		std::string name;
+		std::vector<size_t> deps;
+		std::vector<std::string> depNames;
+		Step step;
+		State state;
+		double startMs;
+		double endMs;
+	};
+
+	std::vector<Phase> phases_;
+	std::vector<std::thread> threads_;
+	std::function<void(bool)> done_;
+	size_t remaining_;
+	bool ok_;
+	bool started_;
+	bool finished_;
+
+	std::mutex mtx_;
+	std::condition_variable finishedCv_;
+	std::chrono::steady_clock::time_point epoch_;
+
+	bool resolve();
+	void launchReadyLocked();
+	void runPhase(size_t idx);
+	double elapsedMs();
+	static const char* stateName(State state);
+};
@@ -0,0 +1,49 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Scheduling policy, every thread applies its role to itself when it starts.
+// The game owns the machine: only frame production is raised, everything deferred runs idle
+namespace threads {
+
+enum Role {
+	GRAPHICS,    // libobs render thread
+	ENCODE,      // libobs video thread, raw encoders run on it
+	INTERACTIVE, // Hotkeys & sound cues, mostly asleep but late is noticeable
+	NORMAL,
+	BACKGROUND,  // Uploads, recompression, thumbnails: idle CPU & I/O priority
+	ROLE_COUNT
+};
+
+// Cores a role may run on, 0 (the default) leaves it on any core. Set before the threads start
+void setAffinity(Role role, uint64_t mask);
+
+// name may be null to keep the thread's current name
+void apply(Role role, const char* name);
+// Whether the calling thread already applied a role
+bool hasRole();
+
+// CPU-bound foreground work alone, against busy background threads at default priority,
+// and against the same threads under the BACKGROUND role
+void benchmark(int seconds);
+
+}
@@ -0,0 +1,37 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+
+// Poster frame & preview sprite made locally from a finished clip, so the server never has to decode it
+namespace thumb {
+
+struct Result {
+	std::string posterPath;
+	std::string spritePath;
+	int keyframes; // Decoded to build both images
+	double ms;
+};
+
+// Writes <clip>_poster.jpg and <clip>_sprite.jpg next to the clip, only keyframes are decoded
+bool generate(const std::string& videoPath, Result& result);
+
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Output timestamps for clips joined back to back. Each clip starts where the previous one's
+// longest stream ended, and every stream's DTS keeps rising across the joins
+class ClipTimeline {
+public:
+	// Seconds per tick of each output stream, as num/den
+	explicit ClipTimeline(const std::vector<std::pair<int, int>>& timeBases);
+
+	// Next clip, from the earliest DTS of any of its streams. B-frames put that before its first PTS
+	void beginClip(int64_t firstDtsUsec);
+	// Moves one packet, in its stream's ticks, onto the output timeline. A DTS that would not
+	// rise is bumped to the next tick, PTS never falls behind DTS
+	void place(int stream, int64_t& dts, int64_t& pts, int64_t duration);
+	// End of the longest stream so far
+	int64_t endUsec() { return endUsec_; }
+
+	int64_t toUsec(int stream, int64_t ticks);
+	int64_t toTicks(int stream, int64_t usec);
+
+private:
+	std::vector<std::pair<int, int>> timeBases_;
+	std::vector<int64_t> lastDts_;
+	int64_t offsetUsec_;
+	int64_t endUsec_;
+};
@@ -1,127 +1,427 @@
-/******************************************************************************
-	CONKORS COMPANION
-	www.conkors.com
-	Copyright (C) Conkors LLC
-
-	This program is free software: you can redistribute it and/or modify
-	it under the terms of the GNU General Public License as published by
-	the Free Software Foundation, either version 2 of the License, or
-	(at your option) any later version.
-
-	This program is distributed in the hope that it will be useful,
-	but WITHOUT ANY WARRANTY; without even the implied warranty of
-	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-	GNU General Public License for more details.
-
-	You should have received a copy of the GNU General Public License
-	along with this program.  If not, see <http://www.gnu.org/licenses/>.
-******************************************************************************/
-
-#pragma once
-
-#include <Windows.h>
-#include <algorithm>
-#include <string>
-#include <vector>
-#include <mutex>
-
-#include <obs.h>
-#include <obs.hpp>
-
-#include "account.h"
-
-using propListStr = std::vector<std::pair<std::string, std::string>>;
-using propListInt = std::vector<std::pair<std::string, int>>;
-
-class VidCore {
-public:
-	enum AdapterType {
-		UNKNOWN = 0,
-		NVIDIA,
-		AMD,
-		INTEL
-	};
-
-	explicit VidCore();
-	~VidCore();
-
-	bool init(std::shared_ptr<AccountManager> acm, const std::vector<std::string>& adapters);
-
-	void initializeDisplayCapture();
-	void initializeWindowCapture();
-
-	/// Replay Buffer
-	bool recordReplay();
-	void stopReplay();
-
-	/// Live Record
-	bool recordLive();
-	void saveLive();
-
-	std::string getLastReplay();
-	std::string getLastLive();
-	void uploadVideo(std::string filePath);
-
-	/////////////////////////////////////////////////////
-	// UI ACCESS
-	/////////////////////////////////////////////////////
-
-	bool overrideAdapter(int idx);
-	void forceSoftwareEncoder();
-
-	void captureWindow();
-	void captureMonitor();
-
-	void updateDisplay(const char* id);
-	void updateSpeaker(const char* id);
-	void updateMic(const char* id);
-
-	propListInt getAdapters();
-	propListStr getDisplayOpts();
-	propListStr getSpeakerOpts();
-	propListStr getMicOpts();
-
-	void toggleSpeakerAudio(bool mute);
-	void toggleMicAudio(bool mute);
-
-	void toggleRecordLive();
-	void saveReplay();
-
-private:
-	std::shared_ptr<AccountManager> acm_;
-
-	std::mutex vidMtx_;
-	obs_video_info ovi_;
-	std::vector<std::string> availableAdapters_;
-
-	OBSEncoder aacRecording_;
-	OBSEncoder videoRecording_;
-
-	OBSSourceAutoRelease disp_;
-	OBSSourceAutoRelease sourceMic_;
-	OBSSourceAutoRelease sourceAud_;
-
-	OBSOutputAutoRelease replayBuffer_;
-	OBSOutputAutoRelease fileOutput_;
-
-	OBSSignal replayBufferSaved_;
-	OBSSignal liveVideoSaved_;
-
-	std::string encoderString_;
-	std::string lastRecordingLive_;
-
-	bool isReplayBufferActive_; // Replay Buffer
-	bool isLiveActive_; // Live Recording
-	bool captureWindowMode_;
-
-	AdapterType getAdapterType(int idx);
-	bool resetAudio();
-	bool resetVideo(int width, int height);
-	bool loadOBS();
-	void configureBuffer();
-	void configureLive();
-	void addSources();
-	void addOutputs();
-	void detectVideoEncoder();
-	void startEncoders();
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include <obs.h>
+#include <obs.hpp>
+
+#include "account.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "devices.h"
+#include "modules.h"
+#include "scene.h"
+#include "highlight.h"
+#include "metrics.h"
+#include "commands.h"
+
+class VidCore {
+public:
+	enum AdapterType {
+		UNKNOWN = 0,
+		NVIDIA,
+		AMD,
+		INTEL
+	};
+
+	enum QualityPreset {
+		PERFORMANCE = 0,
+		BALANCED,
+		QUALITY
+	};
+
+	// Part of the captured source in source pixels, a zero size captures all of it
+	struct CaptureRegion {
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	// What the UI reads, published whole & never modified afterwards
+	struct State {
+		propListInt adapters;
+		propListStr displays;
+		propListStr speakers;
+		propListStr mics;
+		int adapter = 0;
+		QualityPreset preset = BALANCED;
+		int replaySeconds = 30;
+		int uploadTrimSeconds = 0;
+		std::string encoder;
+		uint32_t outputWidth = 0;
+		uint32_t outputHeight = 0;
+		bool captureWindowMode = false;
+		CaptureRegion captureRegion;
+		uint32_t sourceWidth = 0;
+		uint32_t sourceHeight = 0;
+		bool replayActive = false;
+		bool liveActive = false;
+		bool autoHighlights = false;
+		int encoderRecoveries = 0; // Replay buffer restarts by the watchdog
+	};
+
+	// Render/output counters since startup
+	struct FrameStats {
+		uint32_t totalFrames;
+		uint32_t laggedFrames;  // Rendering missed its slot
+		uint32_t skippedFrames; // Encoding couldn't keep up
+		int droppedFrames;      // Replay output
+		uint64_t staticFrames;  // Encoded at the reduced static-scene bitrate
+	};
+
+	// Startup scan for live recordings a crash left unfinished
+	struct RecoveryStats {
+		int found;
+		int recovered;
+		double ms;
+	};
+
+	// Latest hotkey save, from the key press to the finished file
+	struct HotkeySave {
+		double pressToSavedMs;
+		double endErrorMs; // Capture time of the clip's last frame against the target, a frame at most
+	};
+
+	explicit VidCore();
+	~VidCore();
+
+	// These only take effect before init(), the defaults boot the normal D3D11 + capture setup
+	void setGraphicsModule(const std::string& module);
+	// Test pattern sources instead of display capture & WASAPI, for headless runs
+	void setSyntheticSources(bool synthetic);
+	// Stands in for a game changing resolution, synthetic sources only
+	void resizeSyntheticDisplay(int width, int height);
+	// Prometheus endpoint on 127.0.0.1, 0 turns it off
+	void setMetricsPort(int port);
+
+	bool init(std::shared_ptr<AccountManager> acm, const std::vector<std::string>& adapters);
+
+	void initializeDisplayCapture();
+	void initializeWindowCapture();
+
+	/// Replay Buffer
+	bool recordReplay();
+	void stopReplay();
+
+	/// Live Record
+	bool recordLive();
+	void saveLive();
+
+	std::string getLastReplay();
+	std::string getLastLive();
+	// From the replay output's saved signal
+	void handleReplaySaved(const std::string& filePath);
+	// Also from the saved signal, for saves that carried a hotkey press time
+	void handleHotkeySaved(uint64_t pressNs, int64_t endErrorUsec);
+	HotkeySave getLastHotkeySave();
+	void setReplaySavedCallback(std::function<void(const std::string&)> cb);
+	FrameStats getFrameStats();
+	RecoveryStats getRecoveryStats();
+	// One metric per line, for the settings page
+	std::string getMetricsSummary();
+	// Queues the post-save pipeline, never blocks
+	void uploadVideo(std::string filePath);
+
+	// Lossless edits, return the new file path or empty on failure
+	std::string trimClip(const std::string& filePath, int lastSeconds);
+	std::string concatClips(const std::vector<std::string>& filePaths);
+	// 0 uploads full clips, otherwise only their last N seconds
+	void setUploadTrim(int seconds);
+	int getUploadTrim();
+
+	/////////////////////////////////////////////////////
+	// UI ACCESS
+	/////////////////////////////////////////////////////
+
+	// Never waits on vidMtx_, safe from the UI thread during a reconfiguration
+	std::shared_ptr<const State> getState();
+	// Runs reconfigurations off the caller's thread, one at a time in submission order.
+	// Every setter, capture switch & output start/stop/save is meant to run from here.
+	// done runs on the same thread once the resulting state is published
+	// Accepted before init() too, they run once init() is done. False once shut down
+	bool queueCommand(std::function<void()> cmd, std::function<void()> done = nullptr);
+	// Queues cmd & waits for it to finish, from a command it just runs inline
+	bool runCommand(std::function<void()> cmd);
+	void benchmarkStateReads(int seconds);
+	// Runs on a background thread whenever a device list in the state changed
+	void setDevicesChangedCallback(std::function<void()> cb);
+
+	bool overrideAdapter(int idx);
+	void forceSoftwareEncoder();
+
+	void refreshEncoder();
+	// Each codec's best encoder on the same synthetic clip, replay buffer paused meanwhile
+	void benchmarkCodecs(int frames);
+	// Detector cost on a synthetic stream, plus what the live stream has saved so far
+	void benchmarkSceneDetection(int frames);
+	// From the raw video callback, video thread only
+	void handleSceneFrame(const uint8_t* luma, uint32_t linesize);
+
+	// From the replay output's stop signal, any libobs thread
+	void handleReplayStopped(int code);
+	// Fails the replay output like a dying encoder would, headless runs only. False if it isn't running
+	bool injectEncoderFailure();
+
+	// Saves a replay on its own when game or mic audio spikes
+	void setAutoHighlights(bool enabled);
+	bool getAutoHighlights();
+	void setHighlightThreshold(float db);
+	// Empty path runs the synthetic fixture
+	bool benchmarkHighlights(const std::string& wavPath);
+	// From the audio capture callbacks, audio thread only
+	void handleHighlightAudio(bool mic, const struct audio_data* audio, bool muted);
+
+	bool setQualityPreset(QualityPreset preset);
+	QualityPreset getQualityPreset();
+
+	void setReplayLength(int seconds);
+	int getReplayLength();
+	void benchmarkPresets(int secondsPerPreset);
+
+	// Swap the capture source, outputs stop around the canvas reset & come back. False if the reset failed
+	bool captureWindow();
+	bool captureMonitor();
+	// Crops the capture. A new crop size resets the canvas to it, outputs stop around the reset.
+	// Moving a crop of the same size keeps the canvas & the outputs running
+	bool setCaptureRegion(const CaptureRegion& region);
+	// Resets the canvas to the region's size, or the whole source's, after the source was resized
+	bool fitCanvas();
+	// Full frame against the left half, frame time & bitrate
+	void benchmarkCaptureRegion(int seconds);
+
+	void updateDisplay(const char* id);
+	void updateSpeaker(const char* id);
+	void updateMic(const char* id);
+
+	propListInt getAdapters();
+	propListStr getDisplayOpts();
+	propListStr getSpeakerOpts();
+	propListStr getMicOpts();
+
+	void toggleSpeakerAudio(bool mute);
+	void toggleMicAudio(bool mute);
+
+	void toggleRecordLive();
+	// 0 saves the configured replay length, otherwise one of the extra windows.
+	// pressNs is os_gettime_ns() when the hotkey was detected, the clip then ends
+	// the hotkey offset after it instead of whenever the save gets to run
+	void saveReplay(int seconds = 0, uint64_t pressNs = 0);
+	// Milliseconds past the press, negative ends the clip before it
+	void setHotkeySaveOffset(int ms);
+	int getHotkeySaveOffset();
+	// Extra save lengths (15s, 1 min, 5 min), the ring holds the longest
+	std::vector<int> getReplayWindows();
+
+private:
+	// Everything a preset controls, applied together
+	struct PresetConfig {
+		const char* name;
+		obs_scale_type scaleType;
+		int maxWidth;
+		int maxHeight;
+		uint32_t fps;
+		const char* encoderPreset; // speed | balanced | quality
+		int bitrate; // kbps
+	};
+
+	std::shared_ptr<AccountManager> acm_;
+
+	std::mutex vidMtx_;
+	obs_video_info ovi_;
+	std::vector<std::string> availableAdapters_;
+
+	OBSEncoder aacRecording_;
+	OBSEncoder videoRecording_;
+
+	OBSSourceAutoRelease disp_;
+	OBSSourceAutoRelease sourceMic_;
+	OBSSourceAutoRelease sourceAud_;
+	// The display goes through a scene, its item carries the region's crop & scale
+	OBSSceneAutoRelease scene_;
+	obs_sceneitem_t* displayItem_;
+	CaptureRegion region_;
+	// Source size as of the last poll, resizes settle before they're applied
+	uint32_t trackedWidth_;
+	uint32_t trackedHeight_;
+	Scheduler::TimerId resizeTimer_;
+
+	OBSOutputAutoRelease replayBuffer_;
+	OBSOutputAutoRelease fileOutput_;
+
+	OBSSignal replayBufferSaved_;
+	OBSSignal liveVideoSaved_;
+
+	std::string encoderString_;
+	std::vector<std::string> encoderRanking_;
+	bool forceSoftware_;
+	QualityPreset preset_;
+	int replaySeconds_;
+	std::vector<int> replayWindows_;
+	std::atomic<int> uploadTrimSeconds_;
+	std::atomic<int> hotkeySaveOffsetMs_;
+
+	Snapshot<State> state_;
+	CommandQueue commands_; // Publishes the state after every command
+
+	PostSavePipeline pipeline_;
+	Scheduler scheduler_; // Live caps, debounced device switches, deferred retries
+	Scheduler::TimerId liveCapTimer_;
+	DeviceRegistry devices_;
+	ModuleManager modules_;
+
+	// Static-scene detection, the detector & counter belong to the video thread
+	ChangeDetector changes_;
+	int unchangedFrames_;
+	int staticEnterFrames_;
+	bool sceneWatching_;
+	std::atomic<bool> sceneStatic_;
+	std::atomic<uint64_t> sceneFrames_;
+	std::atomic<uint64_t> sceneStaticFrames_;
+	// Both rates for the current encoder, a flip applies one under this lock only
+	std::mutex sceneRateMtx_;
+	OBSEncoder sceneEncoder_;
+	OBSData fullRateSettings_;
+	OBSData staticRateSettings_;
+
+	// Audio highlights, each detector belongs to its source's callback
+	HighlightDetector desktopHighlights_;
+	HighlightDetector micHighlights_;
+	std::atomic<bool> autoHighlights_;
+	std::atomic<uint64_t> lastHighlightMs_;
+
+	// Health metrics, sampled on the scheduler thread
+	struct HealthMetrics {
+		Counter* renderFrames;
+		Counter* laggedFrames;
+		Counter* encodedFrames;
+		Counter* skippedFrames;
+		Counter* droppedFrames;
+		Counter* outputBytes;
+		Counter* replaySaves;
+		Counter* recoveredRecordings;
+		Counter* recoveries;
+		Counter* recoveryFailures;
+		Gauge* frameTime;
+		Gauge* bitrateKbps;
+		Gauge* congestion;
+		Gauge* bufferMemory;
+		Gauge* bufferDisk;
+		Gauge* bufferFill;
+		Gauge* staticScene;
+		LatencyHistogram* frameTimeSamples;
+		LatencyHistogram* recoveryTime;
+		LatencyHistogram* hotkeySaveTime;
+		// Running totals as of the last sample
+		uint64_t lastRender;
+		uint64_t lastLagged;
+		uint64_t lastEncoded;
+		uint64_t lastSkipped;
+		uint64_t lastDropped;
+		uint64_t lastBytes;
+		uint64_t lastSampleMs;
+	};
+	MetricsRegistry metrics_;
+	MetricsServer metricsServer_;
+	HealthMetrics health_;
+	int metricsPort_;
+	Scheduler::TimerId metricsTimer_;
+
+	// Encoder watchdog, fields under vidMtx_
+	struct Watchdog {
+		uint64_t lastPackets;
+		uint64_t lastProgressMs; // 0 until armed on the first sample after a start
+		uint64_t lastRecoveryMs;
+		bool recovering; // Restarted, waiting on the first packet to time it
+		int recoveries;
+	};
+	Watchdog watchdog_;
+	Scheduler::TimerId watchdogTimer_;
+	std::atomic<bool> recoveryPending_;
+	std::atomic<uint64_t> recoveryStartMs_;
+	OBSSignal replayStopped_;
+	std::mutex listenerMtx_;
+	RecoveryStats recoveryStats_;
+	HotkeySave lastHotkeySave_;
+	std::function<void()> devicesChanged_;
+	std::function<void(const std::string&)> replaySaved_;
+
+	std::string graphicsModule_;
+	bool syntheticSources_;
+	uint64_t liveSession_; // Bumped per live recording, a late cap for an old one is ignored
+	std::string lastRecordingLive_;
+
+	bool isReplayBufferActive_; // Replay Buffer
+	bool isLiveActive_; // Live Recording
+	bool captureWindowMode_;
+
+	static PresetConfig getPresetConfig(QualityPreset preset);
+	static void capToPreset(const PresetConfig& cfg, int& width, int& height);
+
+	AdapterType getAdapterType(int idx);
+	bool resetAudio();
+	bool resetVideo(int width, int height);
+	bool loadOBS();
+	void initPipeline();
+	bool switchCapture(bool windowMode);
+	void createDisplay(bool windowMode);
+	void addSyntheticDisplay(bool windowMode);
+	void attachDisplay();
+	CaptureRegion clampedRegion();
+	void applyRegion();
+	bool fitsCanvas(const CaptureRegion& region, double tolerance);
+	bool resizeCanvas(int width, int height);
+	void pollSourceSize();
+	void applySourceResize();
+	void publishState();
+	void enumerateDevices(State& state);
+	void configureBuffer();
+	void configureLive();
+	void addSources();
+	void addOutputs();
+	void detectVideoEncoder();
+	bool fallbackEncoder();
+	void startEncoders();
+	void configureVideoEncoder(obs_encoder_t* encoder, const std::string& encoderId);
+	void watchScene(bool watch);
+	void applySceneBitrate();
+	void logSceneStats();
+	void initMetrics();
+	void recoverRecordings();
+	void sampleMetrics();
+	uint64_t replayVideoPackets();
+	void watchdogTick();
+	void triggerRecovery(const char* reason);
+	void recoverOutputs();
+	void applyEncoderPreset(obs_data_t* settings, const std::string& encoderId);
+	void waitForOutputsStopped();
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+/******************************************************************************
+	CONKORS COMPANION
+	www.conkors.com
+	Copyright (C) Conkors LLC
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "metrics.h"
+
+struct AVIOContext;
+
+// Output file for the muxers. Writes land in large aligned buffers an I/O thread flushes
+// in order, the file is preallocated to the expected size and trimmed to what was written on close
+class WriteBehindFile {
+public:
+	static const size_t BUFFER_SIZE = 4 * 1024 * 1024;
+	static const int BUFFER_COUNT = 4;
+	static const size_t ALIGNMENT = 4096;
+
+	explicit WriteBehindFile();
+	~WriteBehindFile();
+
+	// expectedSize is only a hint, 0 skips preallocation
+	bool open(const std::string& path, uint64_t expectedSize);
+	// Only blocks when every buffer is still waiting on the disk
+	bool write(const uint8_t* data, size_t size);
+	// The buffer so far is queued as is, later writes go to the new position
+	void seek(uint64_t offset);
+	uint64_t position() { return pos_; }
+	uint64_t size() { return end_; }
+	bool close();
+
+	// avio_open/avio_closep over a WriteBehindFile
+	static AVIOContext* openAvio(const std::string& path, uint64_t expectedSize);
+	static bool closeAvio(AVIOContext** pb);
+
+	// Caller side time per write, and time per buffer reaching the disk, shared by every file
+	static void registerMetrics(MetricsRegistry& registry);
+	// Muxer-sized writes straight to the file against the write-behind path, in dir
+	static void benchmark(const std::string& dir, int megabytes);
+
+private:
+	struct Buffer {
+		uint8_t* data;
+		size_t used;
+		uint64_t offset;
+	};
+
+	static LatencyHistogram writeLatency_;
+	static LatencyHistogram flushLatency_;
+
+#ifdef _WIN32
+	HANDLE file_;
+#else
+	int fd_;
+#endif
+	std::string path_;
+	std::vector<Buffer> buffers_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::deque<int> free_;
+	std::deque<int> pending_;
+	std::thread io_;
+	bool closing_;
+	bool failed_;
+	int current_; // Buffer being filled, -1 when none
+	uint64_t pos_;
+	uint64_t end_;
+
+	void queueCurrent();
+	void ioLoop();
+	bool writeAt(const uint8_t* data, size_t size, uint64_t offset);
+	bool isOpen();
+	void closeHandle();
+};